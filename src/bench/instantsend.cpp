@@ -0,0 +1,87 @@
+// Copyright (c) 2018-2018 The Zixx developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "arith_uint256.h"
+#include "instantx.h"
+#include "key.h"
+#include "messagesigner.h"
+
+static const int LOCKS_TOTAL = 20;
+static const int INPUTS_PER_LOCK = 2;
+
+struct CBenchLockVote
+{
+    CTxLockVote vote;
+    CPubKey pubKeyMasternode;
+    std::string strMessage;
+    std::vector<unsigned char> vchSig;
+};
+
+// Feeds signed votes of SIGNATURES_TOTAL masternodes for LOCKS_TOTAL
+// lock requests round-robin, the way they arrive from the network,
+// until every lock is ready. One iteration processes all of the votes.
+static void InstantSendLockVotes(benchmark::State& state)
+{
+    std::vector<CKey> vecKeys(COutPointLock::SIGNATURES_TOTAL);
+    std::vector<COutPoint> vecMasternodes;
+    for (size_t i = 0; i < vecKeys.size(); i++) {
+        vecKeys[i].MakeNewKey(true);
+        vecMasternodes.push_back(COutPoint(ArithToUint256(arith_uint256(1000 + i)), 0));
+    }
+
+    std::vector<CTxLockRequest> vecRequests;
+    for (int i = 0; i < LOCKS_TOTAL; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(INPUTS_PER_LOCK);
+        for (int j = 0; j < INPUTS_PER_LOCK; j++)
+            tx.vin[j].prevout = COutPoint(ArithToUint256(arith_uint256(i + 1)), j);
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_1;
+        tx.vout[0].nValue = 1 * COIN;
+        vecRequests.push_back(CTxLockRequest(tx));
+    }
+
+    // votes are ordered masternode by masternode, every masternode votes for all locks
+    std::vector<CBenchLockVote> vecVotes;
+    for (size_t i = 0; i < vecKeys.size(); i++) {
+        for (size_t j = 0; j < vecRequests.size(); j++) {
+            BOOST_FOREACH(const CTxIn& txin, vecRequests[j].vin) {
+                CBenchLockVote benchVote;
+                benchVote.vote = CTxLockVote(vecRequests[j].GetHash(), txin.prevout, vecMasternodes[i]);
+                benchVote.pubKeyMasternode = vecKeys[i].GetPubKey();
+                benchVote.strMessage = vecRequests[j].GetHash().ToString() + txin.prevout.ToStringShort();
+                CMessageSigner::SignMessage(benchVote.strMessage, benchVote.vchSig, vecKeys[i]);
+                vecVotes.push_back(benchVote);
+            }
+        }
+    }
+
+    while (state.KeepRunning()) {
+        std::map<uint256, CTxLockCandidate> mapCandidates;
+        for (size_t i = 0; i < vecRequests.size(); i++) {
+            CTxLockCandidate txLockCandidate(vecRequests[i]);
+            BOOST_FOREACH(const CTxIn& txin, vecRequests[i].vin)
+                txLockCandidate.AddOutPointLock(txin.prevout);
+            mapCandidates.insert(std::make_pair(vecRequests[i].GetHash(), txLockCandidate));
+        }
+
+        std::set<uint256> setReady;
+        for (size_t i = 0; i < vecVotes.size(); i++) {
+            const CBenchLockVote& benchVote = vecVotes[i];
+            std::string strError;
+            if (!CMessageSigner::VerifyMessage(benchVote.pubKeyMasternode, benchVote.vchSig, benchVote.strMessage, strError))
+                continue;
+
+            uint256 txHash = benchVote.vote.GetTxHash();
+            CTxLockCandidate& txLockCandidate = mapCandidates.find(txHash)->second;
+            if (!txLockCandidate.AddVote(benchVote.vote) || setReady.count(txHash))
+                continue;
+            if (txLockCandidate.IsAllOutPointsReady())
+                setReady.insert(txHash);
+        }
+    }
+}
+
+BENCHMARK(InstantSendLockVotes);
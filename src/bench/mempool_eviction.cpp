@@ -0,0 +1,62 @@
+// Copyright (c) 2018-2018 The Zixx developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "arith_uint256.h"
+#include "policy/policy.h"
+#include "txmempool.h"
+
+static void AddTx(const CTransaction& tx, const CAmount& nFee, CTxMemPool& pool)
+{
+    int64_t nTime = 0;
+    double dPriority = 10.0;
+    unsigned int nHeight = 1;
+    bool spendsCoinbase = false;
+    unsigned int nSigOps = 1;
+    LockPoints lp;
+    pool.addUnchecked(tx.GetHash(), CTxMemPoolEntry(
+                                        tx, nFee, nTime, dPriority, nHeight, pool.HasNoInputsOf(tx),
+                                        tx.GetValueOut(), spendsCoinbase, nSigOps, lp));
+}
+
+// Adds a package of nChain transactions, each spending the previous one
+static void AddPackage(uint32_t nSeed, int nChain, CTxMemPool& pool)
+{
+    uint256 hashPrev = ArithToUint256(arith_uint256(nSeed + 1));
+    for (int i = 0; i < nChain; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(hashPrev, 0);
+        tx.vin[0].scriptSig = CScript() << OP_1;
+        tx.vout.resize(2);
+        tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        tx.vout[0].nValue = 10 * COIN;
+        tx.vout[1].scriptPubKey = CScript() << OP_2 << OP_EQUAL;
+        tx.vout[1].nValue = 1 * COIN;
+        // Spread the feerates so every trim has a different worst package
+        AddTx(tx, ((nSeed * 7919 + i * 104729) % 1000 + 1) * 100, pool);
+        hashPrev = tx.GetHash();
+    }
+}
+
+// Floods a mempool that sits at its size limit: every burst of accepted
+// transactions makes TrimToSize() evict the lowest scoring packages again.
+static void MempoolEviction(benchmark::State& state)
+{
+    CTxMemPool pool(CFeeRate(1000));
+
+    uint32_t nSeed = 0;
+    // Independent transactions mixed with parent/child chains
+    for (int i = 0; i < 1000; i++)
+        AddPackage(nSeed++, i % 4 == 0 ? 3 : 1, pool);
+    const size_t nLimit = pool.DynamicMemoryUsage() * 9 / 10;
+
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 50; i++)
+            AddPackage(nSeed++, i % 4 == 0 ? 3 : 1, pool);
+        pool.TrimToSize(nLimit);
+    }
+}
+
+BENCHMARK(MempoolEviction);
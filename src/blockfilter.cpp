@@ -0,0 +1,237 @@
+// Copyright (c) 2018-2018 The Zixx developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+
+#include "coins.h"
+#include "hash.h"
+#include "primitives/block.h"
+#include "script/script.h"
+#include "script/standard.h"
+#include "undo.h"
+
+#include <algorithm>
+#include <ios>
+
+namespace {
+
+/** Appends bits to a byte vector, most significant bit first */
+class CBitWriter
+{
+private:
+    std::vector<unsigned char>& vch;
+    unsigned char nBuffer;
+    int nOffset;
+
+public:
+    CBitWriter(std::vector<unsigned char>& vchIn) : vch(vchIn), nBuffer(0), nOffset(0) {}
+
+    //! Write the nBits (at most 64) low bits of data
+    void Write(uint64_t data, int nBits)
+    {
+        while (nBits > 0) {
+            int nBitsNow = std::min(8 - nOffset, nBits);
+            nBuffer |= ((data >> (nBits - nBitsNow)) & ((1U << nBitsNow) - 1)) << (8 - nOffset - nBitsNow);
+            nOffset += nBitsNow;
+            nBits -= nBitsNow;
+            if (nOffset == 8)
+                Flush();
+        }
+    }
+
+    //! Write out a partially filled last byte
+    void Flush()
+    {
+        if (nOffset == 0)
+            return;
+        vch.push_back(nBuffer);
+        nBuffer = 0;
+        nOffset = 0;
+    }
+};
+
+/** Reads bits written by CBitWriter */
+class CBitReader
+{
+private:
+    const std::vector<unsigned char>& vch;
+    size_t nPos;
+    unsigned char nBuffer;
+    int nOffset;
+
+public:
+    CBitReader(const std::vector<unsigned char>& vchIn) : vch(vchIn), nPos(0), nBuffer(0), nOffset(8) {}
+
+    //! Read nBits (at most 64) bits, throws when running past the end of the data
+    uint64_t Read(int nBits)
+    {
+        uint64_t data = 0;
+        while (nBits > 0) {
+            if (nOffset == 8) {
+                if (nPos >= vch.size())
+                    throw std::ios_base::failure("CBitReader::Read(): end of data");
+                nBuffer = vch[nPos++];
+                nOffset = 0;
+            }
+            int nBitsNow = std::min(8 - nOffset, nBits);
+            data = (data << nBitsNow) | ((nBuffer >> (8 - nOffset - nBitsNow)) & ((1U << nBitsNow) - 1));
+            nOffset += nBitsNow;
+            nBits -= nBitsNow;
+        }
+        return data;
+    }
+};
+
+void GolombRiceEncode(CBitWriter& writer, int nP, uint64_t x)
+{
+    // quotient in unary: q ones followed by a zero
+    uint64_t q = x >> nP;
+    while (q > 0) {
+        int nBits = q <= 64 ? (int)q : 64;
+        writer.Write(~0ULL, nBits);
+        q -= nBits;
+    }
+    writer.Write(0, 1);
+    writer.Write(x, nP);
+}
+
+uint64_t GolombRiceDecode(CBitReader& reader, int nP)
+{
+    uint64_t q = 0;
+    while (reader.Read(1) == 1)
+        ++q;
+    uint64_t r = reader.Read(nP);
+    return (q << nP) + r;
+}
+
+/** (x * n) >> 64, maps a uniform 64-bit hash into [0, n) without a division */
+uint64_t MapIntoRange(uint64_t x, uint64_t n)
+{
+#ifdef __SIZEOF_INT128__
+    return (uint64_t)(((unsigned __int128)x * (unsigned __int128)n) >> 64);
+#else
+    uint64_t x_hi = x >> 32;
+    uint64_t x_lo = x & 0xFFFFFFFF;
+    uint64_t n_hi = n >> 32;
+    uint64_t n_lo = n & 0xFFFFFFFF;
+
+    uint64_t ac = x_hi * n_hi;
+    uint64_t ad = x_hi * n_lo;
+    uint64_t bc = x_lo * n_hi;
+    uint64_t bd = x_lo * n_lo;
+
+    uint64_t mid34 = (bd >> 32) + (bc & 0xFFFFFFFF) + (ad & 0xFFFFFFFF);
+    return ac + (bc >> 32) + (ad >> 32) + (mid34 >> 32);
+#endif
+}
+
+void AddScript(CBlockFilter::ElementSet& elements, const CScript& script)
+{
+    // unspendable outputs can never pay to or be spent by a wallet
+    if (script.empty() || script[0] == OP_RETURN)
+        return;
+    elements.insert(CBlockFilter::Element(script.begin(), script.end()));
+
+    // a wallet owns bare multisig outputs of its keys without knowing the script,
+    // so their public keys are elements as well
+    if (script.back() != OP_CHECKMULTISIG)
+        return;
+    txnouttype type;
+    std::vector<std::vector<unsigned char> > vSolutions;
+    if (Solver(script, type, vSolutions) && type == TX_MULTISIG) {
+        for (size_t i = 1; i + 1 < vSolutions.size(); i++)
+            elements.insert(vSolutions[i]);
+    }
+}
+
+CBlockFilter::ElementSet GetBlockElements(const CBlock& block, const CBlockUndo& blockundo)
+{
+    CBlockFilter::ElementSet elements;
+
+    for (const CTransaction& tx : block.vtx) {
+        for (const CTxOut& txout : tx.vout)
+            AddScript(elements, txout.scriptPubKey);
+    }
+
+    for (const CTxUndo& txundo : blockundo.vtxundo) {
+        for (const Coin& coin : txundo.vprevout)
+            AddScript(elements, coin.out.scriptPubKey);
+    }
+
+    return elements;
+}
+
+} // anon namespace
+
+CBlockFilter::CBlockFilter(const uint256& hashBlockIn, const ElementSet& elements) :
+    hashBlock(hashBlockIn), nN(elements.size())
+{
+    std::vector<uint64_t> vHashes;
+    vHashes.reserve(elements.size());
+    for (const Element& element : elements)
+        vHashes.push_back(HashToRange(element));
+    std::sort(vHashes.begin(), vHashes.end());
+
+    CBitWriter writer(vchData);
+    uint64_t nLast = 0;
+    for (uint64_t nHash : vHashes) {
+        GolombRiceEncode(writer, P, nHash - nLast);
+        nLast = nHash;
+    }
+    writer.Flush();
+}
+
+CBlockFilter::CBlockFilter(const CBlock& block, const CBlockUndo& blockundo) :
+    CBlockFilter(block.GetHash(), GetBlockElements(block, blockundo))
+{
+}
+
+uint64_t CBlockFilter::HashToRange(const Element& element) const
+{
+    uint64_t nHash = CSipHasher(hashBlock.GetUint64(0), hashBlock.GetUint64(1))
+        .Write(element.data(), element.size())
+        .Finalize();
+    return MapIntoRange(nHash, nN * M);
+}
+
+bool CBlockFilter::MatchSorted(const std::vector<uint64_t>& vQueries) const
+{
+    if (nN == 0 || vQueries.empty())
+        return false;
+
+    try {
+        CBitReader reader(vchData);
+        std::vector<uint64_t>::const_iterator it = vQueries.begin();
+        uint64_t nValue = 0;
+        for (uint64_t i = 0; i < nN; i++) {
+            nValue += GolombRiceDecode(reader, P);
+            while (*it < nValue) {
+                if (++it == vQueries.end())
+                    return false;
+            }
+            if (*it == nValue)
+                return true;
+        }
+    } catch (const std::ios_base::failure&) {
+        // a truncated filter cannot rule anything out
+        return true;
+    }
+
+    return false;
+}
+
+bool CBlockFilter::Match(const Element& element) const
+{
+    return MatchSorted(std::vector<uint64_t>(1, HashToRange(element)));
+}
+
+bool CBlockFilter::MatchAny(const ElementSet& elements) const
+{
+    std::vector<uint64_t> vQueries;
+    vQueries.reserve(elements.size());
+    for (const Element& element : elements)
+        vQueries.push_back(HashToRange(element));
+    std::sort(vQueries.begin(), vQueries.end());
+    return MatchSorted(vQueries);
+}
@@ -0,0 +1,72 @@
+// Copyright (c) 2018-2018 The Zixx developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKFILTER_H
+#define BITCOIN_BLOCKFILTER_H
+
+#include "serialize.h"
+#include "uint256.h"
+
+#include <set>
+#include <stdint.h>
+#include <vector>
+
+class CBlock;
+class CBlockUndo;
+
+/**
+ * Compact filter over the scripts a block touches: the output scripts it
+ * creates and the scripts of the outputs it spends (as in BIP 158), plus the
+ * public keys of bare multisig scripts among them.
+ *
+ * Elements are hashed with SipHash keyed by the block hash into the range
+ * [0, N * M) and stored as a Golomb-Rice coded set of sorted deltas with
+ * parameter P, giving a false positive rate of about 1 / M per query.
+ * Filters are only built and read locally, they are never relayed.
+ */
+class CBlockFilter
+{
+public:
+    typedef std::vector<unsigned char> Element;
+    typedef std::set<Element> ElementSet;
+
+    //! Golomb-Rice parameter, bits of remainder per element
+    static const int P = 19;
+    //! Inverse false positive rate
+    static const uint64_t M = 784931;
+
+    CBlockFilter() : nN(0) {}
+    explicit CBlockFilter(const uint256& hashBlockIn) : hashBlock(hashBlockIn), nN(0) {}
+    CBlockFilter(const uint256& hashBlockIn, const ElementSet& elements);
+    //! Build the filter of a connected block, blockundo holds the coins its transactions spent
+    CBlockFilter(const CBlock& block, const CBlockUndo& blockundo);
+
+    const uint256& GetBlockHash() const { return hashBlock; }
+    uint64_t GetN() const { return nN; }
+    const std::vector<unsigned char>& GetEncoded() const { return vchData; }
+
+    //! True if the element may be in the set, false if it definitely is not
+    bool Match(const Element& element) const;
+    //! True if any of the elements may be in the set
+    bool MatchAny(const ElementSet& elements) const;
+
+    ADD_SERIALIZE_METHODS;
+
+    // the block hash is the key of the filter in the block tree database
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(COMPACTSIZE(nN));
+        READWRITE(vchData);
+    }
+
+private:
+    uint256 hashBlock;
+    uint64_t nN;
+    std::vector<unsigned char> vchData;
+
+    uint64_t HashToRange(const Element& element) const;
+    bool MatchSorted(const std::vector<uint64_t>& vQueries) const;
+};
+
+#endif // BITCOIN_BLOCKFILTER_H
@@ -161,6 +161,9 @@ public:
     {
     }
 
+    //! Mutex to ensure only one concurrent CCheckQueueControl
+    boost::mutex ControlMutex;
+
     bool IsIdle()
     {
         boost::unique_lock<boost::mutex> lock(mutex);
@@ -183,8 +186,10 @@ private:
 public:
     CCheckQueueControl(CCheckQueue<T>* pqueueIn) : pqueue(pqueueIn), fDone(false)
     {
-        // passed queue is supposed to be unused, or NULL
+        // passed queue is supposed to be unused, or NULL; wait for any
+        // other controller of the same queue to finish first
         if (pqueue != NULL) {
+            pqueue->ControlMutex.lock();
             bool isIdle = pqueue->IsIdle();
             assert(isIdle);
         }
@@ -209,6 +214,8 @@ public:
     {
         if (!fDone)
             Wait();
+        if (pqueue != NULL)
+            pqueue->ControlMutex.unlock();
     }
 };
 
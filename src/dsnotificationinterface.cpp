@@ -59,3 +59,13 @@ void CDSNotificationInterface::SyncTransaction(const CTransaction &tx, const CBl
     instantsend.SyncTransaction(tx, pblock);
     CPrivateSend::SyncTransaction(tx, pblock);
 }
+
+void CDSNotificationInterface::BlockConnected(const CBlock &block, const CBlockIndex *pindex)
+{
+    mnodeman.BlockConnected(block);
+}
+
+void CDSNotificationInterface::BlockDisconnected(const CBlock &block)
+{
+    mnodeman.BlockDisconnected(block);
+}
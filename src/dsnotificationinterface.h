@@ -22,6 +22,8 @@ protected:
     void NotifyHeaderTip(const CBlockIndex *pindexNew, bool fInitialDownload) override;
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
     void SyncTransaction(const CTransaction &tx, const CBlock *pblock) override;
+    void BlockConnected(const CBlock &block, const CBlockIndex *pindex) override;
+    void BlockDisconnected(const CBlock &block) override;
 
 private:
     CConnman& connman;
@@ -13,12 +13,182 @@
 #include "util.h"
 
 #include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
 
 /** 
 *   Generic Dumping and Loading
 *   ---------------------------
+*
+*   Files start with the type specific magic message and the network magic number
+*   followed by FLATDB_SNAPSHOT_MAGIC and the format version. The serialized object
+*   comes next, split into chunks of up to FLATDB_CHUNK_SIZE bytes, each stored as
+*   its size, its data and a checksum over its index and data. A chunk of size 0
+*   ends the file.
+*
+*   Older versions wrote the object as a single stream with one trailing checksum
+*   and abort on any other file under their name, so the chunked files use new
+*   names. A file in the old format is still read once when its new file is missing.
 */
 
+static const unsigned char FLATDB_SNAPSHOT_MAGIC[4] = {0xff, 's', 'n', 'p'};
+static const int FLATDB_FORMAT_VERSION = 1;
+static const unsigned int FLATDB_CHUNK_SIZE = 1 << 20;
+//! Maximum number of threads verifying chunk checksums on load
+static const int FLATDB_MAX_VERIFY_THREADS = 8;
+
+/** Checksum of one chunk, covering its position so chunks can't be reordered */
+inline uint256 FlatDBChunkHash(uint32_t nIndex, const std::vector<char>& vchChunk)
+{
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << nIndex;
+    ss.write(vchChunk.empty() ? NULL : &vchChunk[0], vchChunk.size());
+    return ss.GetHash();
+}
+
+inline void WriteFlatDBChunk(CAutoFile& fileout, const std::vector<char>& vchChunk, const uint256& hash)
+{
+    uint32_t nSize = vchChunk.size();
+    fileout << nSize;
+    fileout.write(&vchChunk[0], nSize);
+    fileout << hash;
+}
+
+/**
+ * Serialization stream splitting its data into chunks. The chunks are either written to a file
+ * together with their checksums as soon as they fill up, or collected in memory.
+ */
+class CFlatDBChunkWriter
+{
+private:
+    CAutoFile* pfileout;
+    std::vector<std::vector<char> >* pvChunks;
+    const int nType;
+    const int nVersion;
+    std::vector<char> vchChunk;
+    uint32_t nChunks;
+    size_t nWritten;
+
+    void WriteChunk()
+    {
+        if (pfileout) {
+            WriteFlatDBChunk(*pfileout, vchChunk, FlatDBChunkHash(nChunks, vchChunk));
+            vchChunk.clear();
+        } else {
+            pvChunks->push_back(std::vector<char>());
+            pvChunks->back().swap(vchChunk);
+            vchChunk.reserve(FLATDB_CHUNK_SIZE);
+        }
+        nChunks++;
+    }
+
+public:
+    CFlatDBChunkWriter(CAutoFile& fileoutIn, int nTypeIn, int nVersionIn) :
+        pfileout(&fileoutIn), pvChunks(NULL), nType(nTypeIn), nVersion(nVersionIn), nChunks(0), nWritten(0)
+    {
+        vchChunk.reserve(FLATDB_CHUNK_SIZE);
+    }
+
+    CFlatDBChunkWriter(std::vector<std::vector<char> >& vChunksIn, int nTypeIn, int nVersionIn) :
+        pfileout(NULL), pvChunks(&vChunksIn), nType(nTypeIn), nVersion(nVersionIn), nChunks(0), nWritten(0)
+    {
+        vchChunk.reserve(FLATDB_CHUNK_SIZE);
+    }
+
+    int GetType() const { return nType; }
+    int GetVersion() const { return nVersion; }
+    uint32_t GetChunkCount() const { return nChunks; }
+    //! Bytes serialized so far, like CDataStream::size() while writing
+    size_t size() const { return nWritten; }
+
+    void write(const char* pch, size_t nSize)
+    {
+        nWritten += nSize;
+        while (nSize > 0) {
+            size_t nCopy = std::min(nSize, (size_t)FLATDB_CHUNK_SIZE - vchChunk.size());
+            vchChunk.insert(vchChunk.end(), pch, pch + nCopy);
+            pch += nCopy;
+            nSize -= nCopy;
+            if (vchChunk.size() == FLATDB_CHUNK_SIZE)
+                WriteChunk();
+        }
+    }
+
+    /** Write the last partial chunk and, when writing to a file, the end marker */
+    void Finalize()
+    {
+        if (!vchChunk.empty())
+            WriteChunk();
+        if (pfileout)
+            *pfileout << (uint32_t)0;
+    }
+
+    template<typename T>
+    CFlatDBChunkWriter& operator<<(const T& obj)
+    {
+        ::Serialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
+
+/** Deserialization stream reading across verified chunks without joining them into one buffer */
+class CFlatDBChunkReader
+{
+private:
+    const std::vector<std::vector<char> >& vChunks;
+    const int nType;
+    const int nVersion;
+    size_t nChunk;
+    size_t nPos;
+    size_t nRemaining;
+
+public:
+    CFlatDBChunkReader(const std::vector<std::vector<char> >& vChunksIn, int nTypeIn, int nVersionIn) :
+        vChunks(vChunksIn), nType(nTypeIn), nVersion(nVersionIn), nChunk(0), nPos(0), nRemaining(0)
+    {
+        for (size_t i = 0; i < vChunks.size(); i++)
+            nRemaining += vChunks[i].size();
+    }
+
+    int GetType() const { return nType; }
+    int GetVersion() const { return nVersion; }
+    //! Bytes left to read, like CDataStream::size() while reading
+    size_t size() const { return nRemaining; }
+
+    void read(char* pch, size_t nSize)
+    {
+        while (nSize > 0) {
+            if (nChunk >= vChunks.size())
+                throw std::ios_base::failure("CFlatDBChunkReader::read(): end of data");
+            const std::vector<char>& vchChunk = vChunks[nChunk];
+            size_t nCopy = std::min(nSize, vchChunk.size() - nPos);
+            memcpy(pch, &vchChunk[nPos], nCopy);
+            pch += nCopy;
+            nSize -= nCopy;
+            nPos += nCopy;
+            nRemaining -= nCopy;
+            if (nPos == vchChunk.size()) {
+                nChunk++;
+                nPos = 0;
+            }
+        }
+    }
+
+    template<typename T>
+    CFlatDBChunkReader& operator>>(T& obj)
+    {
+        ::Unserialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
+
+/** Verify the checksums of chunks nFirst, nFirst + nStep, ... */
+inline void FlatDBVerifyChunks(const std::vector<std::vector<char> >& vChunks, const std::vector<uint256>& vHashes,
+                               size_t nFirst, size_t nStep, std::vector<char>& vfValid)
+{
+    for (size_t i = nFirst; i < vChunks.size(); i += nStep)
+        vfValid[i] = FlatDBChunkHash(i, vChunks[i]) == vHashes[i];
+}
+
 template<typename T>
 class CFlatDB
 {
@@ -36,7 +206,29 @@ private:
 
     boost::filesystem::path pathDB;
     std::string strFilename;
+    // file written in the old single checksum format, read if pathDB doesn't exist yet
+    boost::filesystem::path pathLegacyDB;
     std::string strMagicMessage;
+    // checksum over all chunks of the last snapshot
+    uint256 hashLastSnapshot;
+
+    void WriteHeader(CAutoFile& fileout)
+    {
+        fileout << strMagicMessage; // specific magic message for this type of object
+        fileout << FLATDATA(Params().MessageStart()); // network specific magic number
+        fileout << FLATDATA(FLATDB_SNAPSHOT_MAGIC);
+        fileout << FLATDB_FORMAT_VERSION;
+    }
+
+    bool CommitFile(CAutoFile& fileout, const boost::filesystem::path& pathTmp)
+    {
+        FileCommit(fileout.Get());
+        fileout.fclose();
+
+        if (!RenameOver(pathTmp, pathDB))
+            return error("%s: Rename-into-place failed for %s", __func__, pathDB.string());
+        return true;
+    }
 
     bool Write(const T& objToSave)
     {
@@ -44,51 +236,136 @@ private:
 
         int64_t nStart = GetTimeMillis();
 
-        // serialize, checksum data up to that point, then append checksum
-        CDataStream ssObj(SER_DISK, CLIENT_VERSION);
-        ssObj << strMagicMessage; // specific magic message for this type of object
-        ssObj << FLATDATA(Params().MessageStart()); // network specific magic number
-        ssObj << objToSave;
-        uint256 hash = Hash(ssObj.begin(), ssObj.end());
-        ssObj << hash;
+        // write to a temporary file first so that a crash never leaves a truncated file behind
+        boost::filesystem::path pathTmp = pathDB;
+        pathTmp += ".new";
 
         // open output file, and associate with CAutoFile
-        FILE *file = fopen(pathDB.string().c_str(), "wb");
+        FILE *file = fopen(pathTmp.string().c_str(), "wb");
         CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
         if (fileout.IsNull())
-            return error("%s: Failed to open file %s", __func__, pathDB.string());
+            return error("%s: Failed to open file %s", __func__, pathTmp.string());
 
-        // Write and commit header, data
+        // Write header, then stream the object chunk by chunk instead of serializing it into memory first
+        uint32_t nChunks = 0;
         try {
-            fileout << ssObj;
+            WriteHeader(fileout);
+
+            CFlatDBChunkWriter writer(fileout, SER_DISK, CLIENT_VERSION);
+            writer << objToSave;
+            writer.Finalize();
+            nChunks = writer.GetChunkCount();
         }
         catch (std::exception &e) {
             return error("%s: Serialize or I/O error - %s", __func__, e.what());
         }
-        fileout.fclose();
+        if (!CommitFile(fileout, pathTmp))
+            return false;
 
-        LogPrintf("Written info to %s  %dms\n", strFilename, GetTimeMillis() - nStart);
+        LogPrintf("Written info to %s  %d chunks  %dms\n", strFilename, nChunks, GetTimeMillis() - nStart);
         LogPrintf("     %s\n", objToSave.ToString());
 
         return true;
     }
 
-    ReadResult Read(T& objToLoad, bool fDryRun = false)
+    bool WriteChunks(const std::vector<std::vector<char> >& vChunks, const std::vector<uint256>& vHashes)
     {
-        //LOCK(objToLoad.cs);
+        boost::filesystem::path pathTmp = pathDB;
+        pathTmp += ".new";
 
-        int64_t nStart = GetTimeMillis();
+        FILE *file = fopen(pathTmp.string().c_str(), "wb");
+        CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+        if (fileout.IsNull())
+            return error("%s: Failed to open file %s", __func__, pathTmp.string());
+
+        try {
+            WriteHeader(fileout);
+            for (size_t i = 0; i < vChunks.size(); i++)
+                WriteFlatDBChunk(fileout, vChunks[i], vHashes[i]);
+            fileout << (uint32_t)0;
+        }
+        catch (std::exception &e) {
+            return error("%s: I/O error - %s", __func__, e.what());
+        }
+        return CommitFile(fileout, pathTmp);
+    }
+
+    ReadResult ReadChunks(CAutoFile& filein, T& objToLoad)
+    {
+        int nFormatVersion;
+        std::vector<std::vector<char> > vChunks;
+        std::vector<uint256> vHashes;
+        try {
+            filein >> nFormatVersion;
+            if (nFormatVersion != FLATDB_FORMAT_VERSION) {
+                error("%s: Unknown format version %d", __func__, nFormatVersion);
+                return IncorrectFormat;
+            }
+
+            while (true) {
+                uint32_t nSize;
+                filein >> nSize;
+                if (nSize == 0)
+                    break;
+                if (nSize > FLATDB_CHUNK_SIZE) {
+                    error("%s: Chunk too large", __func__);
+                    return IncorrectFormat;
+                }
+                vChunks.push_back(std::vector<char>(nSize));
+                filein.read(&vChunks.back()[0], nSize);
+                vHashes.push_back(uint256());
+                filein >> vHashes.back();
+            }
+        }
+        catch (std::exception &e) {
+            error("%s: Deserialize or I/O error - %s", __func__, e.what());
+            return HashReadError;
+        }
+
+        // verify stored checksums match input data, spreading the chunks over a few threads
+        std::vector<char> vfValid(vChunks.size(), false);
+        int nThreads = std::min(std::min((int)vChunks.size(), (int)boost::thread::hardware_concurrency()), FLATDB_MAX_VERIFY_THREADS);
+        if (nThreads > 1) {
+            boost::thread_group threadGroup;
+            for (int i = 0; i < nThreads; i++)
+                threadGroup.create_thread(boost::bind(&FlatDBVerifyChunks, boost::cref(vChunks), boost::cref(vHashes), i, nThreads, boost::ref(vfValid)));
+            threadGroup.join_all();
+        } else {
+            FlatDBVerifyChunks(vChunks, vHashes, 0, 1, vfValid);
+        }
+        if (std::find(vfValid.begin(), vfValid.end(), false) != vfValid.end())
+        {
+            error("%s: Checksum mismatch, data corrupted", __func__);
+            return IncorrectHash;
+        }
+
+        try {
+            // de-serialize data into T object
+            CFlatDBChunkReader reader(vChunks, SER_DISK, CLIENT_VERSION);
+            reader >> objToLoad;
+        }
+        catch (std::exception &e) {
+            objToLoad.Clear();
+            error("%s: Deserialize or I/O error - %s", __func__, e.what());
+            return IncorrectFormat;
+        }
+
+        return Ok;
+    }
+
+    ReadResult ReadLegacy(T& objToLoad)
+    {
         // open input file, and associate with CAutoFile
-        FILE *file = fopen(pathDB.string().c_str(), "rb");
+        FILE *file = fopen(pathLegacyDB.string().c_str(), "rb");
         CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
         if (filein.IsNull())
         {
-            error("%s: Failed to open file %s", __func__, pathDB.string());
+            error("%s: Failed to open file %s", __func__, pathLegacyDB.string());
             return FileError;
         }
 
         // use file size to size memory buffer
-        int fileSize = boost::filesystem::file_size(pathDB);
+        int fileSize = boost::filesystem::file_size(pathLegacyDB);
         int dataSize = fileSize - sizeof(uint256);
         // Don't try to resize to a negative number if file is small
         if (dataSize < 0)
@@ -118,7 +395,6 @@ private:
             return IncorrectHash;
         }
 
-
         unsigned char pchMsgTmp[4];
         std::string strMagicMessageTmp;
         try {
@@ -132,7 +408,6 @@ private:
                 return IncorrectMagicMessage;
             }
 
-
             // de-serialize file header (network specific magic number) and ..
             ssObj >> FLATDATA(pchMsgTmp);
 
@@ -142,7 +417,13 @@ private:
                 error("%s: Invalid network magic number", __func__);
                 return IncorrectMagicNumber;
             }
+        }
+        catch (std::exception &e) {
+            error("%s: Deserialize or I/O error - %s", __func__, e.what());
+            return IncorrectFormat;
+        }
 
+        try {
             // de-serialize data into T object
             ssObj >> objToLoad;
         }
@@ -152,23 +433,94 @@ private:
             return IncorrectFormat;
         }
 
+        return Ok;
+    }
+
+    ReadResult ReadFile(T& objToLoad)
+    {
+        // open input file, and associate with CAutoFile
+        FILE *file = fopen(pathDB.string().c_str(), "rb");
+        CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+        {
+            error("%s: Failed to open file %s", __func__, pathDB.string());
+            return FileError;
+        }
+
+        unsigned char pchMsgTmp[4];
+        unsigned char pchSnapshotTmp[4];
+        std::string strMagicMessageTmp;
+        try {
+            // de-serialize file header (file specific magic message) and ..
+            filein >> strMagicMessageTmp;
+
+            // ... verify the message matches predefined one
+            if (strMagicMessage != strMagicMessageTmp)
+            {
+                error("%s: Invalid magic message", __func__);
+                return IncorrectMagicMessage;
+            }
+
+            // de-serialize file header (network specific magic number) and ..
+            filein >> FLATDATA(pchMsgTmp);
+
+            // ... verify the network matches ours
+            if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)))
+            {
+                error("%s: Invalid network magic number", __func__);
+                return IncorrectMagicNumber;
+            }
+
+            filein >> FLATDATA(pchSnapshotTmp);
+        }
+        catch (std::exception &e) {
+            error("%s: Deserialize or I/O error - %s", __func__, e.what());
+            return HashReadError;
+        }
+
+        if (memcmp(pchSnapshotTmp, FLATDB_SNAPSHOT_MAGIC, sizeof(pchSnapshotTmp)))
+        {
+            error("%s: Invalid snapshot magic", __func__);
+            return IncorrectFormat;
+        }
+
+        return ReadChunks(filein, objToLoad);
+    }
+
+
+    ReadResult Read(T& objToLoad)
+    {
+        //LOCK(objToLoad.cs);
+
+        int64_t nStart = GetTimeMillis();
+        ReadResult result;
+        if (!pathLegacyDB.empty() && !boost::filesystem::exists(pathDB) && boost::filesystem::exists(pathLegacyDB)) {
+            // written by an older version, the next dump writes it under the new name
+            LogPrintf("%s: %s is missing, reading %s in the old single checksum format\n", __func__,
+                strFilename, pathLegacyDB.filename().string());
+            result = ReadLegacy(objToLoad);
+        } else {
+            result = ReadFile(objToLoad);
+        }
+        if (result != Ok)
+            return result;
+
         LogPrintf("Loaded info from %s  %dms\n", strFilename, GetTimeMillis() - nStart);
         LogPrintf("     %s\n", objToLoad.ToString());
-        if(!fDryRun) {
-            LogPrintf("%s: Cleaning....\n", __func__);
-            objToLoad.CheckAndRemove();
-            LogPrintf("     %s\n", objToLoad.ToString());
-        }
+        LogPrintf("%s: Cleaning....\n", __func__);
+        objToLoad.CheckAndRemove();
+        LogPrintf("     %s\n", objToLoad.ToString());
 
         return Ok;
     }
 
-
 public:
-    CFlatDB(std::string strFilenameIn, std::string strMagicMessageIn)
+    CFlatDB(std::string strFilenameIn, std::string strMagicMessageIn, std::string strLegacyFilenameIn = "")
     {
         pathDB = GetDataDir() / strFilenameIn;
         strFilename = strFilenameIn;
+        if (!strLegacyFilenameIn.empty())
+            pathLegacyDB = GetDataDir() / strLegacyFilenameIn;
         strMagicMessage = strMagicMessageIn;
     }
 
@@ -198,29 +550,52 @@ public:
     {
         int64_t nStart = GetTimeMillis();
 
-        LogPrintf("Verifying %s format...\n", strFilename);
-        T tmpObjToLoad;
-        ReadResult readResult = Read(tmpObjToLoad, true);
+        // The file is replaced atomically and every chunk carries its own checksum,
+        // so the old file does not have to be read back and verified first
+        LogPrintf("Writing info to %s...\n", strFilename);
+        if (!Write(objToSave))
+            return false;
+        LogPrintf("%s dump finished  %dms\n", strFilename, GetTimeMillis() - nStart);
 
-        // there was an error and it was not an error on file opening => do not proceed
-        if (readResult == FileError)
-            LogPrintf("Missing file %s, will try to recreate\n", strFilename);
-        else if (readResult != Ok)
-        {
-            LogPrintf("Error reading %s: ", strFilename);
-            if(readResult == IncorrectFormat)
-                LogPrintf("%s: Magic is ok but data has invalid format, will try to recreate\n", __func__);
-            else
-            {
-                LogPrintf("%s: File format is unknown or invalid, please fix it manually\n", __func__);
-                return false;
-            }
+        return true;
+    }
+
+    /**
+     * Write the object while it stays usable: its serialization (which takes the object's
+     * lock) only copies it into memory chunks, checksums and disk I/O happen after the lock
+     * is released. Nothing is written when the data didn't change since the last snapshot.
+     */
+    bool Snapshot(T& objToSave)
+    {
+        int64_t nStart = GetTimeMillis();
+
+        std::vector<std::vector<char> > vChunks;
+        try {
+            CFlatDBChunkWriter writer(vChunks, SER_DISK, CLIENT_VERSION);
+            writer << objToSave;
+            writer.Finalize();
+        }
+        catch (std::exception &e) {
+            return error("%s: Serialize error - %s", __func__, e.what());
+        }
+        int64_t nCopied = GetTimeMillis();
+
+        std::vector<uint256> vHashes;
+        vHashes.reserve(vChunks.size());
+        for (size_t i = 0; i < vChunks.size(); i++)
+            vHashes.push_back(FlatDBChunkHash(i, vChunks[i]));
+        uint256 hashSnapshot = Hash(vHashes.begin(), vHashes.end());
+        if (hashSnapshot == hashLastSnapshot) {
+            LogPrint("flatdb", "%s: %s unchanged, skipping\n", __func__, strFilename);
+            return true;
         }
 
-        LogPrintf("Writing info to %s...\n", strFilename);
-        Write(objToSave);
-        LogPrintf("%s dump finished  %dms\n", strFilename, GetTimeMillis() - nStart);
+        if (!WriteChunks(vChunks, vHashes))
+            return false;
+        hashLastSnapshot = hashSnapshot;
 
+        LogPrint("flatdb", "%s: %s written, %d chunks, copy %dms, total %dms\n", __func__, strFilename, vChunks.size(),
+            nCopied - nStart, GetTimeMillis() - nStart);
         return true;
     }
 
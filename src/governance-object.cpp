@@ -40,6 +40,7 @@ CGovernanceObject::CGovernanceObject()
   mapOrphanVotes(),
   fileVotes()
 {
+    RebuildVoteCounts();
     // PARSE JSON DATA STORAGE (STRDATA)
     LoadData();
 }
@@ -68,6 +69,7 @@ CGovernanceObject::CGovernanceObject(uint256 nHashParentIn, int nRevisionIn, int
   mapOrphanVotes(),
   fileVotes()
 {
+    RebuildVoteCounts();
     // PARSE JSON DATA STORAGE (STRDATA)
     LoadData();
 }
@@ -95,7 +97,11 @@ CGovernanceObject::CGovernanceObject(const CGovernanceObject& other)
   mapCurrentMNVotes(other.mapCurrentMNVotes),
   mapOrphanVotes(other.mapOrphanVotes),
   fileVotes(other.fileVotes)
-{}
+{
+    memcpy(anVoteCounts, other.anVoteCounts, sizeof(anVoteCounts));
+    hashVoteDigest = other.hashVoteDigest;
+    fVoteDigestDirty = other.fVoteDigestDirty;
+}
 
 bool CGovernanceObject::ProcessVote(CNode* pfrom,
                                     const CGovernanceVote& vote,
@@ -190,7 +196,10 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
         exception = CGovernanceException(ostr.str(), GOVERNANCE_EXCEPTION_PERMANENT_ERROR);
         return false;
     }
+    UpdateVoteCount(eSignal, voteInstance.eOutcome, -1);
     voteInstance = vote_instance_t(vote.GetOutcome(), nVoteTimeUpdate, vote.GetTimestamp());
+    UpdateVoteCount(eSignal, voteInstance.eOutcome, 1);
+    fVoteDigestDirty = true;
     if(!fileVotes.HasVote(vote.GetHash())) {
         fileVotes.AddVote(vote);
     }
@@ -204,7 +213,11 @@ void CGovernanceObject::ClearMasternodeVotes()
     while(it != mapCurrentMNVotes.end()) {
         if(!mnodeman.Has(it->first)) {
             fileVotes.RemoveVotesFromMasternode(it->first);
+            for(vote_instance_m_cit it2 = it->second.mapInstances.begin(); it2 != it->second.mapInstances.end(); ++it2) {
+                UpdateVoteCount(it2->first, it2->second.eOutcome, -1);
+            }
             mapCurrentMNVotes.erase(it++);
+            fVoteDigestDirty = true;
         }
         else {
             ++it;
@@ -212,6 +225,25 @@ void CGovernanceObject::ClearMasternodeVotes()
     }
 }
 
+void CGovernanceObject::UpdateVoteCount(int nSignal, vote_outcome_enum_t eOutcome, int nDelta)
+{
+    // placeholder instances of rejected votes have no outcome and are not counted
+    if(nSignal <= VOTE_SIGNAL_NONE || nSignal > MAX_SUPPORTED_VOTE_SIGNAL) return;
+    if(eOutcome <= VOTE_OUTCOME_NONE || eOutcome > VOTE_OUTCOME_ABSTAIN) return;
+    anVoteCounts[nSignal][eOutcome] += nDelta;
+}
+
+void CGovernanceObject::RebuildVoteCounts()
+{
+    memset(anVoteCounts, 0, sizeof(anVoteCounts));
+    fVoteDigestDirty = true;
+    for(vote_m_cit it = mapCurrentMNVotes.begin(); it != mapCurrentMNVotes.end(); ++it) {
+        for(vote_instance_m_cit it2 = it->second.mapInstances.begin(); it2 != it->second.mapInstances.end(); ++it2) {
+            UpdateVoteCount(it2->first, it2->second.eOutcome, 1);
+        }
+    }
+}
+
 std::string CGovernanceObject::GetSignatureMessage() const
 {
     LOCK(cs);
@@ -597,19 +629,9 @@ bool CGovernanceObject::IsCollateralValid(std::string& strError, bool& fMissingC
 
 int CGovernanceObject::CountMatchingVotes(vote_signal_enum_t eVoteSignalIn, vote_outcome_enum_t eVoteOutcomeIn) const
 {
-    int nCount = 0;
-    for(vote_m_cit it = mapCurrentMNVotes.begin(); it != mapCurrentMNVotes.end(); ++it) {
-        const vote_rec_t& recVote = it->second;
-        vote_instance_m_cit it2 = recVote.mapInstances.find(eVoteSignalIn);
-        if(it2 == recVote.mapInstances.end()) {
-            continue;
-        }
-        const vote_instance_t& voteInstance = it2->second;
-        if(voteInstance.eOutcome == eVoteOutcomeIn) {
-            ++nCount;
-        }
-    }
-    return nCount;
+    if(eVoteSignalIn <= VOTE_SIGNAL_NONE || eVoteSignalIn > MAX_SUPPORTED_VOTE_SIGNAL) return 0;
+    if(eVoteOutcomeIn <= VOTE_OUTCOME_NONE || eVoteOutcomeIn > VOTE_OUTCOME_ABSTAIN) return 0;
+    return anVoteCounts[eVoteSignalIn][eVoteOutcomeIn];
 }
 
 /**
@@ -651,6 +673,26 @@ bool CGovernanceObject::GetCurrentMNVotes(const COutPoint& mnCollateralOutpoint,
     return  true;
 }
 
+uint256 CGovernanceObject::GetVoteDigest()
+{
+    LOCK(cs);
+    if(!fVoteDigestDirty) {
+        return hashVoteDigest;
+    }
+
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    for(vote_m_cit it = mapCurrentMNVotes.begin(); it != mapCurrentMNVotes.end(); ++it) {
+        for(vote_instance_m_cit it2 = it->second.mapInstances.begin(); it2 != it->second.mapInstances.end(); ++it2) {
+            // placeholders of rejected votes only exist locally
+            if(it2->second.eOutcome == VOTE_OUTCOME_NONE) continue;
+            ss << it->first << it2->first << int(it2->second.eOutcome) << it2->second.nCreationTime;
+        }
+    }
+    hashVoteDigest = ss.GetHash();
+    fVoteDigestDirty = false;
+    return hashVoteDigest;
+}
+
 void CGovernanceObject::Relay(CConnman& connman)
 {
     // Do not relay until fully synced
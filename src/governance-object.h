@@ -27,6 +27,7 @@ class CGovernanceVote;
 static const int MAX_GOVERNANCE_OBJECT_DATA_SIZE = 16 * 1024;
 static const int MIN_GOVERNANCE_PEER_PROTO_VERSION = 70206;
 static const int GOVERNANCE_FILTER_PROTO_VERSION = 70206;
+static const int GOVERNANCE_DIGEST_PROTO_VERSION = 70210;
 
 static const double GOVERNANCE_FILTER_FP_RATE = 0.001;
 
@@ -185,6 +186,13 @@ private:
 
     vote_m_t mapCurrentMNVotes;
 
+    /// Number of current votes per signal and outcome, kept in step with mapCurrentMNVotes
+    int anVoteCounts[MAX_SUPPORTED_VOTE_SIGNAL + 1][VOTE_OUTCOME_ABSTAIN + 1];
+
+    /// Hash over the current votes, see GetVoteDigest
+    uint256 hashVoteDigest;
+    bool fVoteDigestDirty;
+
     /// Limited map of votes orphaned by MN
     vote_mcache_t mapOrphanVotes;
 
@@ -296,6 +304,12 @@ public:
 
     bool GetCurrentMNVotes(const COutPoint& mnCollateralOutpoint, vote_rec_t& voteRecord);
 
+    /**
+     * Summary of the current votes: a hash over (outpoint, signal) -> (outcome, vote time)
+     * of every masternode, equal on two nodes only if they have the same current votes
+     */
+    uint256 GetVoteDigest();
+
     // FUNCTIONS FOR DEALING WITH DATA STRING
 
     std::string GetDataAsHex();
@@ -324,6 +338,9 @@ public:
             READWRITE(nDeletionTime);
             READWRITE(fExpired);
             READWRITE(mapCurrentMNVotes);
+            if(ser_action.ForRead()) {
+                RebuildVoteCounts();
+            }
             READWRITE(fileVotes);
             LogPrint("gobject", "CGovernanceObject::SerializationOp hash = %s, vote count = %d\n", GetHash().ToString(), fileVotes.GetVoteCount());
         }
@@ -342,6 +359,7 @@ private:
     void LoadData();
     void GetData(UniValue& objResult);
 
+protected:
     bool ProcessVote(CNode* pfrom,
                      const CGovernanceVote& vote,
                      CGovernanceException& exception,
@@ -350,6 +368,10 @@ private:
     /// Called when MN's which have voted on this object have been removed
     void ClearMasternodeVotes();
 
+private:
+    void UpdateVoteCount(int nSignal, vote_outcome_enum_t eOutcome, int nDelta);
+    void RebuildVoteCounts();
+
     void CheckOrphanVotes(CConnman& connman);
 
 };
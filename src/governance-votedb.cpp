@@ -5,24 +5,28 @@
 
 #include "governance-votedb.h"
 
+#include <algorithm>
+
 CGovernanceObjectVoteFile::CGovernanceObjectVoteFile()
     : nMemoryVotes(0),
-      listVotes(),
-      mapVoteIndex()
+      vecVotes(),
+      mapVoteIndex(),
+      mapOutpointIndex()
 {}
 
 CGovernanceObjectVoteFile::CGovernanceObjectVoteFile(const CGovernanceObjectVoteFile& other)
     : nMemoryVotes(other.nMemoryVotes),
-      listVotes(other.listVotes),
-      mapVoteIndex()
-{
-    RebuildIndex();
-}
+      vecVotes(other.vecVotes),
+      mapVoteIndex(other.mapVoteIndex),
+      mapOutpointIndex(other.mapOutpointIndex)
+{}
 
 void CGovernanceObjectVoteFile::AddVote(const CGovernanceVote& vote)
 {
-    listVotes.push_front(vote);
-    mapVoteIndex[vote.GetHash()] = listVotes.begin();
+    size_t nPos = vecVotes.size();
+    vecVotes.push_back(vote);
+    mapVoteIndex[vote.GetHash()] = nPos;
+    mapOutpointIndex[vote.GetMasternodeOutpoint()].push_back(nPos);
     ++nMemoryVotes;
 }
 
@@ -41,57 +45,104 @@ bool CGovernanceObjectVoteFile::GetVote(const uint256& nHash, CGovernanceVote& v
     if(it == mapVoteIndex.end()) {
         return false;
     }
-    vote = *(it->second);
+    vote = vecVotes[it->second];
     return true;
 }
 
 std::vector<CGovernanceVote> CGovernanceObjectVoteFile::GetVotes() const
+{
+    return vecVotes;
+}
+
+std::vector<uint256> CGovernanceObjectVoteFile::GetVoteHashes() const
+{
+    std::vector<uint256> vecResult;
+    vecResult.reserve(mapVoteIndex.size());
+    for(vote_m_cit it = mapVoteIndex.begin(); it != mapVoteIndex.end(); ++it) {
+        vecResult.push_back(it->first);
+    }
+    return vecResult;
+}
+
+std::vector<CGovernanceVote> CGovernanceObjectVoteFile::GetVotes(const COutPoint& outpointMasternode) const
 {
     std::vector<CGovernanceVote> vecResult;
-    for(vote_l_cit it = listVotes.begin(); it != listVotes.end(); ++it) {
-        vecResult.push_back(*it);
+    outpoint_m_cit it = mapOutpointIndex.find(outpointMasternode);
+    if(it == mapOutpointIndex.end()) {
+        return vecResult;
+    }
+    vecResult.reserve(it->second.size());
+    for(size_t i = 0; i < it->second.size(); ++i) {
+        vecResult.push_back(vecVotes[it->second[i]]);
     }
     return vecResult;
 }
 
 void CGovernanceObjectVoteFile::RemoveVotesFromMasternode(const COutPoint& outpointMasternode)
 {
-    vote_l_it it = listVotes.begin();
-    while(it != listVotes.end()) {
-        if(it->GetMasternodeOutpoint() == outpointMasternode) {
-            --nMemoryVotes;
-            mapVoteIndex.erase(it->GetHash());
-            listVotes.erase(it++);
-        }
-        else {
-            ++it;
-        }
+    outpoint_m_it it = mapOutpointIndex.find(outpointMasternode);
+    if(it == mapOutpointIndex.end()) {
+        return;
+    }
+    // remove from the back so that positions which are still to be removed are not moved around
+    std::vector<size_t> vecPositions = it->second;
+    std::sort(vecPositions.begin(), vecPositions.end());
+    for(std::vector<size_t>::reverse_iterator it2 = vecPositions.rbegin(); it2 != vecPositions.rend(); ++it2) {
+        RemoveVote(*it2);
+    }
+}
+
+void CGovernanceObjectVoteFile::RemoveVote(size_t nPos)
+{
+    const CGovernanceVote& vote = vecVotes[nPos];
+    mapVoteIndex.erase(vote.GetHash());
+    outpoint_m_it it = mapOutpointIndex.find(vote.GetMasternodeOutpoint());
+    std::vector<size_t>& vecPositions = it->second;
+    vecPositions.erase(std::find(vecPositions.begin(), vecPositions.end(), nPos));
+    if(vecPositions.empty()) {
+        mapOutpointIndex.erase(it);
+    }
+
+    size_t nLast = vecVotes.size() - 1;
+    if(nPos != nLast) {
+        // move the last vote into the freed slot and point its indexes there
+        vecVotes[nPos] = vecVotes[nLast];
+        const CGovernanceVote& voteMoved = vecVotes[nPos];
+        mapVoteIndex[voteMoved.GetHash()] = nPos;
+        std::vector<size_t>& vecMoved = mapOutpointIndex[voteMoved.GetMasternodeOutpoint()];
+        *std::find(vecMoved.begin(), vecMoved.end(), nLast) = nPos;
     }
+    vecVotes.pop_back();
+    --nMemoryVotes;
 }
 
 CGovernanceObjectVoteFile& CGovernanceObjectVoteFile::operator=(const CGovernanceObjectVoteFile& other)
 {
     nMemoryVotes = other.nMemoryVotes;
-    listVotes = other.listVotes;
-    RebuildIndex();
+    vecVotes = other.vecVotes;
+    mapVoteIndex = other.mapVoteIndex;
+    mapOutpointIndex = other.mapOutpointIndex;
     return *this;
 }
 
 void CGovernanceObjectVoteFile::RebuildIndex()
 {
     mapVoteIndex.clear();
-    nMemoryVotes = 0;
-    vote_l_it it = listVotes.begin();
-    while(it != listVotes.end()) {
-        CGovernanceVote& vote = *it;
-        uint256 nHash = vote.GetHash();
-        if(mapVoteIndex.find(nHash) == mapVoteIndex.end()) {
-            mapVoteIndex[nHash] = it;
-            ++nMemoryVotes;
-            ++it;
+    mapOutpointIndex.clear();
+    // drop duplicates while compacting the storage in place
+    size_t nCount = 0;
+    for(size_t i = 0; i < vecVotes.size(); ++i) {
+        uint256 nHash = vecVotes[i].GetHash();
+        if(mapVoteIndex.find(nHash) != mapVoteIndex.end()) {
+            continue;
         }
-        else {
-            listVotes.erase(it++);
+        if(nCount != i) {
+            vecVotes[nCount] = vecVotes[i];
         }
+        mapVoteIndex[nHash] = nCount;
+        mapOutpointIndex[vecVotes[nCount].GetMasternodeOutpoint()].push_back(nCount);
+        ++nCount;
     }
+    vecVotes.resize(nCount);
+    nMemoryVotes = nCount;
 }
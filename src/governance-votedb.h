@@ -6,8 +6,8 @@
 #ifndef GOVERNANCE_VOTEDB_H
 #define GOVERNANCE_VOTEDB_H
 
-#include <list>
 #include <map>
+#include <vector>
 
 #include "governance-vote.h"
 #include "serialize.h"
@@ -15,36 +15,45 @@
 
 /**
  * Represents the collection of votes associated with a given CGovernanceObject
- * Recently received votes are held in memory until a maximum size is reached after
- * which older votes a flushed to a disk file.
+ * Votes are stored contiguously and indexed by vote hash and by masternode outpoint,
+ * removing a vote moves the last vote into its slot.
  *
- * Note: This is a stub implementation that doesn't limit the number of votes held
- * in memory and doesn't flush to disk.
+ * Note: This implementation doesn't limit the number of votes held
+ * in memory and doesn't flush to disk, all votes of an object are still
+ * kept in memory and written with it to governance.dat.
+ * TODO: persist the votes outside of governance.dat, keep only the index
+ * in memory with the disk position of each vote and load votes on demand.
  */
 class CGovernanceObjectVoteFile
 {
 public: // Types
-    typedef std::list<CGovernanceVote> vote_l_t;
+    typedef std::vector<CGovernanceVote> vote_v_t;
 
-    typedef vote_l_t::iterator vote_l_it;
+    typedef vote_v_t::const_iterator vote_v_cit;
 
-    typedef vote_l_t::const_iterator vote_l_cit;
-
-    typedef std::map<uint256,vote_l_it> vote_m_t;
+    typedef std::map<uint256,size_t> vote_m_t;
 
     typedef vote_m_t::iterator vote_m_it;
 
     typedef vote_m_t::const_iterator vote_m_cit;
 
+    typedef std::map<COutPoint,std::vector<size_t> > outpoint_m_t;
+
+    typedef outpoint_m_t::iterator outpoint_m_it;
+
+    typedef outpoint_m_t::const_iterator outpoint_m_cit;
+
 private:
     static const int MAX_MEMORY_VOTES = -1;
 
     int nMemoryVotes;
 
-    vote_l_t listVotes;
+    vote_v_t vecVotes;
 
     vote_m_t mapVoteIndex;
 
+    outpoint_m_t mapOutpointIndex;
+
 public:
     CGovernanceObjectVoteFile();
 
@@ -71,6 +80,16 @@ public:
 
     std::vector<CGovernanceVote> GetVotes() const;
 
+    /**
+     * Retrieve the hashes of all votes without copying the votes
+     */
+    std::vector<uint256> GetVoteHashes() const;
+
+    /**
+     * Retrieve all votes cast by a single masternode
+     */
+    std::vector<CGovernanceVote> GetVotes(const COutPoint& outpointMasternode) const;
+
     CGovernanceObjectVoteFile& operator=(const CGovernanceObjectVoteFile& other);
 
     void RemoveVotesFromMasternode(const COutPoint& outpointMasternode);
@@ -80,13 +99,15 @@ public:
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
     {
+        // same encoding as the list based storage used before
         READWRITE(nMemoryVotes);
-        READWRITE(listVotes);
+        READWRITE(vecVotes);
         if(ser_action.ForRead()) {
             RebuildIndex();
         }
     }
 private:
+    void RemoveVote(size_t nPos);
     void RebuildIndex();
 
 };
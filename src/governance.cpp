@@ -118,6 +118,9 @@ void CGovernanceManager::ProcessMessage(CNode* pfrom, std::string& strCommand, C
 
         uint256 nProp;
         CBloomFilter filter;
+        uint256 hashVoteDigest;
+        std::vector<std::pair<uint256, uint256> > vecDigests;
+        bool fHasDigest = false;
 
         vRecv >> nProp;
 
@@ -129,6 +132,17 @@ void CGovernanceManager::ProcessMessage(CNode* pfrom, std::string& strCommand, C
             filter.clear();
         }
 
+        // newer peers append vote digests of the objects they already have,
+        // a single one when asking for votes of one object or a list when asking for all objects
+        if(pfrom->nVersion >= GOVERNANCE_DIGEST_PROTO_VERSION && !vRecv.empty()) {
+            if(nProp == uint256()) {
+                vRecv >> vecDigests;
+            } else {
+                vRecv >> hashVoteDigest;
+            }
+            fHasDigest = true;
+        }
+
         if(nProp == uint256()) {
             if(netfulfilledman.HasFulfilledRequest(pfrom->addr, NetMsgType::MNGOVERNANCESYNC)) {
                 // Asking for the whole list multiple times in a short period of time is no good
@@ -139,11 +153,30 @@ void CGovernanceManager::ProcessMessage(CNode* pfrom, std::string& strCommand, C
             netfulfilledman.AddFulfilledRequest(pfrom->addr, NetMsgType::MNGOVERNANCESYNC);
         }
 
-        Sync(pfrom, nProp, filter, connman);
+        Sync(pfrom, nProp, filter, connman, (fHasDigest && nProp != uint256()) ? &hashVoteDigest : NULL);
+        if(fHasDigest && nProp == uint256()) {
+            SyncVoteDigests(pfrom, vecDigests, connman);
+        }
         LogPrint("gobject", "MNGOVERNANCESYNC -- syncing governance objects to our peer at %s\n", pfrom->addr.ToString());
 
     }
 
+    // A PEER WE SYNCED FROM TOLD US WHICH OBJECTS HAVE DIFFERENT VOTES
+    else if (strCommand == NetMsgType::MNGOVERNANCEDIGEST)
+    {
+        std::vector<uint256> vecDiffs;
+        vRecv >> vecDiffs;
+
+        if(!netfulfilledman.HasFulfilledRequest(pfrom->addr, "governance-sync")) {
+            LogPrint("gobject", "MNGOVERNANCEDIGEST -- unrequested vote digests, peer=%d\n", pfrom->id);
+            return;
+        }
+
+        LOCK(cs);
+        mapPeerVoteDiffs[pfrom->addr] = hash_s_t(vecDiffs.begin(), vecDiffs.end());
+        LogPrint("gobject", "MNGOVERNANCEDIGEST -- %d objects with different votes, peer=%d\n", vecDiffs.size(), pfrom->id);
+    }
+
     // A NEW GOVERNANCE OBJECT HAS ARRIVED
     else if (strCommand == NetMsgType::MNGOVERNANCEOBJECT)
     {
@@ -259,7 +292,7 @@ void CGovernanceManager::ProcessMessage(CNode* pfrom, std::string& strCommand, C
         CGovernanceException exception;
         if(ProcessVote(pfrom, vote, exception, connman)) {
             LogPrint("gobject", "MNGOVERNANCEOBJECTVOTE -- %s new\n", strHash);
-            masternodeSync.BumpAssetLastTime("MNGOVERNANCEOBJECTVOTE");
+            masternodeSync.BumpAssetLastTime(MASTERNODE_SYNC_GOVERNANCE, "MNGOVERNANCEOBJECTVOTE");
             vote.Relay(connman);
         }
         else {
@@ -380,7 +413,7 @@ void CGovernanceManager::AddGovernanceObject(CGovernanceObject& govobj, CConnman
     // Update the rate buffer
     MasternodeRateUpdate(govobj);
 
-    masternodeSync.BumpAssetLastTime("CGovernanceManager::AddGovernanceObject");
+    masternodeSync.BumpAssetLastTime(MASTERNODE_SYNC_GOVERNANCE, "CGovernanceManager::AddGovernanceObject");
 
     // WE MIGHT HAVE PENDING/ORPHAN VOTES FOR THIS OBJECT
 
@@ -546,6 +579,15 @@ void CGovernanceManager::UpdateCachesAndClean()
         }
     }
 
+    // forget vote digest replies of peers we are no longer syncing from
+    std::map<CService, hash_s_t>::iterator d_it = mapPeerVoteDiffs.begin();
+    while(d_it != mapPeerVoteDiffs.end()) {
+        if(!netfulfilledman.HasFulfilledRequest(CAddress(d_it->first, NODE_NONE), "governance-sync"))
+            mapPeerVoteDiffs.erase(d_it++);
+        else
+            ++d_it;
+    }
+
     // forget about expired deleted objects
     hash_time_m_it s_it = mapErasedGovernanceObjects.begin();
     while(s_it != mapErasedGovernanceObjects.end()) {
@@ -679,8 +721,8 @@ void CGovernanceManager::DoMaintenance(CConnman& connman)
 
 bool CGovernanceManager::ConfirmInventoryRequest(const CInv& inv)
 {
-    // do not request objects until it's time to sync
-    if(!masternodeSync.IsWinnersListSynced()) return false;
+    // do not request objects until it's time to sync, objects are synced in parallel with payment votes
+    if(!masternodeSync.IsMasternodeListSynced()) return false;
 
     LOCK(cs);
 
@@ -732,7 +774,7 @@ bool CGovernanceManager::ConfirmInventoryRequest(const CInv& inv)
     return true;
 }
 
-void CGovernanceManager::Sync(CNode* pfrom, const uint256& nProp, const CBloomFilter& filter, CConnman& connman)
+void CGovernanceManager::Sync(CNode* pfrom, const uint256& nProp, const CBloomFilter& filter, CConnman& connman, const uint256* pVoteDigest)
 {
 
     /*
@@ -795,16 +837,21 @@ void CGovernanceManager::Sync(CNode* pfrom, const uint256& nProp, const CBloomFi
             pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT, it->first));
             ++nObjCount;
 
-            std::vector<CGovernanceVote> vecVotes = govobj.GetVoteFile().GetVotes();
-            for(size_t i = 0; i < vecVotes.size(); ++i) {
-                if(filter.contains(vecVotes[i].GetHash())) {
-                    continue;
-                }
-                if(!vecVotes[i].IsValid(true)) {
-                    continue;
+            // peer already has the same current votes, no need to go through the vote file
+            if(pVoteDigest && *pVoteDigest == govobj.GetVoteDigest()) {
+                LogPrint("gobject", "CGovernanceManager::Sync -- votes already in sync for govobj: %s, peer=%d\n", strHash, pfrom->id);
+            } else {
+                std::vector<CGovernanceVote> vecVotes = govobj.GetVoteFile().GetVotes();
+                for(size_t i = 0; i < vecVotes.size(); ++i) {
+                    if(filter.contains(vecVotes[i].GetHash())) {
+                        continue;
+                    }
+                    if(!vecVotes[i].IsValid(true)) {
+                        continue;
+                    }
+                    pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT_VOTE, vecVotes[i].GetHash()));
+                    ++nVoteCount;
                 }
-                pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT_VOTE, vecVotes[i].GetHash()));
-                ++nVoteCount;
             }
         }
     }
@@ -814,6 +861,43 @@ void CGovernanceManager::Sync(CNode* pfrom, const uint256& nProp, const CBloomFi
     LogPrintf("CGovernanceManager::Sync -- sent %d objects and %d votes to peer=%d\n", nObjCount, nVoteCount, pfrom->id);
 }
 
+void CGovernanceManager::SyncVoteDigests(CNode* pfrom, const std::vector<std::pair<uint256, uint256> >& vecDigests, CConnman& connman)
+{
+    std::map<uint256, uint256> mapDigests(vecDigests.begin(), vecDigests.end());
+    std::vector<uint256> vecDiffs;
+
+    {
+        LOCK(cs);
+
+        for(object_m_it it = mapObjects.begin(); it != mapObjects.end(); ++it) {
+            CGovernanceObject& govobj = it->second;
+            if(govobj.IsSetCachedDelete() || govobj.IsSetExpired()) continue;
+
+            std::map<uint256, uint256>::iterator itDigest = mapDigests.find(it->first);
+            if(itDigest != mapDigests.end() && itDigest->second == govobj.GetVoteDigest()) continue;
+
+            vecDiffs.push_back(it->first);
+        }
+    }
+
+    LogPrint("gobject", "CGovernanceManager::SyncVoteDigests -- %d of %d objects have different votes, peer=%d\n",
+             vecDiffs.size(), vecDigests.size(), pfrom->id);
+    connman.PushMessage(pfrom, NetMsgType::MNGOVERNANCEDIGEST, vecDiffs);
+}
+
+std::vector<std::pair<uint256, uint256> > CGovernanceManager::GetVoteDigests()
+{
+    LOCK(cs);
+
+    std::vector<std::pair<uint256, uint256> > vecDigests;
+    vecDigests.reserve(mapObjects.size());
+    for(object_m_it it = mapObjects.begin(); it != mapObjects.end(); ++it) {
+        CGovernanceObject& govobj = it->second;
+        if(govobj.IsSetCachedDelete() || govobj.IsSetExpired()) continue;
+        vecDigests.push_back(std::make_pair(it->first, govobj.GetVoteDigest()));
+    }
+    return vecDigests;
+}
 
 void CGovernanceManager::MasternodeRateUpdate(const CGovernanceObject& govobj)
 {
@@ -1116,22 +1200,39 @@ void CGovernanceManager::RequestGovernanceObject(CNode* pfrom, const uint256& nH
     filter.clear();
 
     int nVoteCount = 0;
+    uint256 hashVoteDigest;
+    bool fHasDigest = false;
     if(fUseFilter) {
         LOCK(cs);
         CGovernanceObject* pObj = FindGovernanceObject(nHash);
 
         if(pObj) {
             filter = CBloomFilter(Params().GetConsensus().nGovernanceFilterElements, GOVERNANCE_FILTER_FP_RATE, GetRandInt(999999), BLOOM_UPDATE_ALL);
-            std::vector<CGovernanceVote> vecVotes = pObj->GetVoteFile().GetVotes();
-            nVoteCount = vecVotes.size();
-            for(size_t i = 0; i < vecVotes.size(); ++i) {
-                filter.insert(vecVotes[i].GetHash());
+            std::vector<uint256> vecVoteHashes = pObj->GetVoteFile().GetVoteHashes();
+            nVoteCount = vecVoteHashes.size();
+            for(size_t i = 0; i < vecVoteHashes.size(); ++i) {
+                filter.insert(vecVoteHashes[i]);
+            }
+            if(pfrom->nVersion >= GOVERNANCE_DIGEST_PROTO_VERSION) {
+                hashVoteDigest = pObj->GetVoteDigest();
+                fHasDigest = true;
             }
         }
     }
 
     LogPrint("gobject", "CGovernanceManager::RequestGovernanceObject -- nHash %s nVoteCount %d peer=%d\n", nHash.ToString(), nVoteCount, pfrom->id);
-    connman.PushMessage(pfrom, NetMsgType::MNGOVERNANCESYNC, nHash, filter);
+    if(fHasDigest) {
+        connman.PushMessage(pfrom, NetMsgType::MNGOVERNANCESYNC, nHash, filter, hashVoteDigest);
+    } else {
+        connman.PushMessage(pfrom, NetMsgType::MNGOVERNANCESYNC, nHash, filter);
+    }
+}
+
+bool CGovernanceManager::PeerHasSameVotes(const CService& addr, const uint256& nHash)
+{
+    LOCK(cs);
+    std::map<CService, hash_s_t>::iterator it = mapPeerVoteDiffs.find(addr);
+    return it != mapPeerVoteDiffs.end() && !it->second.count(nHash);
 }
 
 int CGovernanceManager::RequestGovernanceObjectVotes(CNode* pnode, CConnman& connman)
@@ -1223,6 +1324,11 @@ int CGovernanceManager::RequestGovernanceObjectVotes(const std::vector<CNode*>&
             if(nProjectedSize > SETASKFOR_MAX_SZ/2) continue;
             // to early to ask the same node
             if(mapAskedRecently[nHashGovobj].count(pnode->addr)) continue;
+            // peer told us during sync that it has the same votes for this object
+            if(PeerHasSameVotes(pnode->addr, nHashGovobj)) {
+                mapAskedRecently[nHashGovobj][pnode->addr] = nNow + nTimeout;
+                continue;
+            }
 
             RequestGovernanceObject(pnode, nHashGovobj, connman, true);
             mapAskedRecently[nHashGovobj][pnode->addr] = nNow + nTimeout;
@@ -1273,9 +1379,9 @@ void CGovernanceManager::RebuildIndexes()
     mapVoteToObject.Clear();
     for(object_m_it it = mapObjects.begin(); it != mapObjects.end(); ++it) {
         CGovernanceObject& govobj = it->second;
-        std::vector<CGovernanceVote> vecVotes = govobj.GetVoteFile().GetVotes();
-        for(size_t i = 0; i < vecVotes.size(); ++i) {
-            mapVoteToObject.Insert(vecVotes[i].GetHash(), &govobj);
+        std::vector<uint256> vecVoteHashes = govobj.GetVoteFile().GetVoteHashes();
+        for(size_t i = 0; i < vecVoteHashes.size(); ++i) {
+            mapVoteToObject.Insert(vecVoteHashes[i], &govobj);
         }
     }
 }
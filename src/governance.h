@@ -264,6 +264,10 @@ private:
 
     hash_s_t setRequestedVotes;
 
+    // objects whose votes differ between us and a peer we synced the list from,
+    // as reported by the peer in reply to our vote digests
+    std::map<CService, hash_s_t> mapPeerVoteDiffs;
+
     bool fRateChecksEnabled;
 
     class ScopedLockBool
@@ -300,7 +304,13 @@ public:
      */
     bool ConfirmInventoryRequest(const CInv& inv);
 
-    void Sync(CNode* node, const uint256& nProp, const CBloomFilter& filter, CConnman& connman);
+    void Sync(CNode* node, const uint256& nProp, const CBloomFilter& filter, CConnman& connman, const uint256* pVoteDigest = NULL);
+
+    /// Reply with the objects whose votes differ from the (object hash, vote digest) pairs the peer sent
+    void SyncVoteDigests(CNode* pfrom, const std::vector<std::pair<uint256, uint256> >& vecDigests, CConnman& connman);
+
+    /// (object hash, vote digest) pairs of all objects we would sync to others
+    std::vector<std::pair<uint256, uint256> > GetVoteDigests();
 
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv, CConnman& connman);
 
@@ -335,6 +345,7 @@ public:
         mapInvalidVotes.Clear();
         mapOrphanVotes.Clear();
         mapLastMasternodeObject.clear();
+        mapPeerVoteDiffs.clear();
     }
 
     std::string ToString() const;
@@ -427,6 +438,9 @@ public:
 private:
     void RequestGovernanceObject(CNode* pfrom, const uint256& nHash, CConnman& connman, bool fUseFilter = false);
 
+    /// True if the peer told us it has exactly the same votes for this object as we do
+    bool PeerHasSameVotes(const CService& addr, const uint256& nHash);
+
     void AddInvalidVote(const CGovernanceVote& vote)
     {
         mapInvalidVotes.Insert(vote.GetHash(), vote);
@@ -112,6 +112,8 @@ public:
     uint256 GetID() const { return id; }
 
     uint256 GetSeedHash();
+    //! Derive the key of an account's external or internal chain, the parent of its child keys
+    void DeriveChainExtKey(uint32_t nAccountIndex, bool fInternal, CExtKey& extKeyRet);
     void DeriveChildExtKey(uint32_t nAccountIndex, bool fInternal, uint32_t nChildIndex, CExtKey& extKeyRet);
 
     void AddAccount();
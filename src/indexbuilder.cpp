@@ -0,0 +1,492 @@
+// Copyright (c) 2018-2018 The Zixx developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "indexbuilder.h"
+
+#include "chainparams.h"
+#include "clientversion.h"
+#include "streams.h"
+#include "txdb.h"
+#include "undo.h"
+#include "util.h"
+#include "utiltime.h"
+#include "validation.h"
+
+#include <algorithm>
+#include <map>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+CIndexBuilder indexBuilder;
+
+namespace {
+
+/** Extract the address type and hash the address index uses for a script, or return false for other scripts */
+bool GetIndexAddress(const CScript& script, uint160& hashBytes, int& type)
+{
+    if (script.IsPayToScriptHash()) {
+        hashBytes = uint160(std::vector<unsigned char>(script.begin()+2, script.begin()+22));
+        type = 2;
+        return true;
+    }
+    if (script.IsPayToPublicKeyHash()) {
+        hashBytes = uint160(std::vector<unsigned char>(script.begin()+3, script.begin()+23));
+        type = 1;
+        return true;
+    }
+    hashBytes.SetNull();
+    type = 0;
+    return false;
+}
+
+struct CAddressIndexKeyCompare
+{
+    bool operator()(const std::pair<CAddressIndexKey, CAmount>& a, const std::pair<CAddressIndexKey, CAmount>& b) const {
+        const CAddressIndexKey& ka = a.first;
+        const CAddressIndexKey& kb = b.first;
+        if (ka.type != kb.type)
+            return ka.type < kb.type;
+        if (ka.hashBytes != kb.hashBytes)
+            return ka.hashBytes < kb.hashBytes;
+        if (ka.blockHeight != kb.blockHeight)
+            return ka.blockHeight < kb.blockHeight;
+        if (ka.txindex != kb.txindex)
+            return ka.txindex < kb.txindex;
+        if (ka.txhash != kb.txhash)
+            return ka.txhash < kb.txhash;
+        if (ka.index != kb.index)
+            return ka.index < kb.index;
+        return ka.spending < kb.spending;
+    }
+};
+
+struct CAddressUnspentKeyCompare
+{
+    bool operator()(const CAddressUnspentKey& a, const CAddressUnspentKey& b) const {
+        if (a.type != b.type)
+            return a.type < b.type;
+        if (a.hashBytes != b.hashBytes)
+            return a.hashBytes < b.hashBytes;
+        if (a.txhash != b.txhash)
+            return a.txhash < b.txhash;
+        return a.index < b.index;
+    }
+};
+
+struct CSpentIndexEntryCompare
+{
+    bool operator()(const std::pair<CSpentIndexKey, CSpentIndexValue>& a, const std::pair<CSpentIndexKey, CSpentIndexValue>& b) const {
+        return CSpentIndexKeyCompare()(a.first, b.first);
+    }
+};
+
+/** Address deltas of the blocks whose running balances have not been applied yet */
+void GetUnappliedBalanceEntries(const std::vector<std::pair<CAddressIndexKey, CAmount> >& addressIndex,
+                                const CBlockIndex* pindexLast,
+                                std::vector<std::pair<CAddressIndexKey, CAmount> >& vUnapplied)
+{
+    std::map<int, bool> mapApplied;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it = addressIndex.begin(); it != addressIndex.end(); it++) {
+        std::map<int, bool>::iterator mi = mapApplied.find(it->first.blockHeight);
+        if (mi == mapApplied.end())
+            mi = mapApplied.insert(std::make_pair(it->first.blockHeight, IsAddressBalanceApplied(pindexLast->GetAncestor(it->first.blockHeight)))).first;
+        if (!mi->second)
+            vUnapplied.push_back(*it);
+    }
+}
+
+} // anon namespace
+
+bool GetBlockIndexEntries(const CBlock& block, const CBlockUndo& blockundo, int nHeight, int nIndexes,
+                          bool fConnect, CBlockIndexEntries& entries)
+{
+    if (blockundo.vtxundo.size() + 1 != block.vtx.size())
+        return error("%s: block and undo data inconsistent", __func__);
+
+    const bool fAddress = (nIndexes & BUILD_ADDRESSINDEX) != 0;
+    const bool fSpent = (nIndexes & BUILD_SPENTINDEX) != 0;
+
+    for (unsigned int n = 0; n < block.vtx.size(); n++) {
+        // DisconnectBlock undoes transactions in reverse order
+        const unsigned int i = fConnect ? n : block.vtx.size() - 1 - n;
+        const CTransaction& tx = block.vtx[i];
+        const uint256 txhash = tx.GetHash();
+
+        std::vector<std::pair<CAddressIndexKey, CAmount> > vOutputs;
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vUnspentOutputs;
+        if (fAddress) {
+            for (unsigned int k = 0; k < tx.vout.size(); k++) {
+                const CTxOut& out = tx.vout[k];
+                uint160 hashBytes;
+                int type;
+                if (!GetIndexAddress(out.scriptPubKey, hashBytes, type))
+                    continue;
+                vOutputs.push_back(std::make_pair(CAddressIndexKey(type, hashBytes, nHeight, i, txhash, k, false), out.nValue));
+                vUnspentOutputs.push_back(std::make_pair(CAddressUnspentKey(type, hashBytes, txhash, k),
+                    fConnect ? CAddressUnspentValue(out.nValue, out.scriptPubKey, nHeight) : CAddressUnspentValue()));
+            }
+        }
+
+        if (!fConnect) {
+            entries.addressIndex.insert(entries.addressIndex.end(), vOutputs.rbegin(), vOutputs.rend());
+            entries.addressUnspentIndex.insert(entries.addressUnspentIndex.end(), vUnspentOutputs.rbegin(), vUnspentOutputs.rend());
+        }
+
+        if (i > 0 && (fAddress || fSpent)) {
+            const CTxUndo& txundo = blockundo.vtxundo[i-1];
+            if (txundo.vprevout.size() != tx.vin.size())
+                return error("%s: transaction and undo data inconsistent", __func__);
+
+            for (unsigned int m = 0; m < tx.vin.size(); m++) {
+                const unsigned int j = fConnect ? m : tx.vin.size() - 1 - m;
+                const COutPoint& prevout = tx.vin[j].prevout;
+                const Coin& coin = txundo.vprevout[j];
+                uint160 hashBytes;
+                int type;
+                bool fIndexed = GetIndexAddress(coin.out.scriptPubKey, hashBytes, type);
+
+                if (fSpent) {
+                    entries.spentIndex.push_back(std::make_pair(CSpentIndexKey(prevout.hash, prevout.n),
+                        fConnect ? CSpentIndexValue(txhash, j, nHeight, coin.out.nValue, type, hashBytes) : CSpentIndexValue()));
+                }
+
+                if (fAddress && fIndexed) {
+                    entries.addressIndex.push_back(std::make_pair(CAddressIndexKey(type, hashBytes, nHeight, i, txhash, j, true), coin.out.nValue * -1));
+                    entries.addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(type, hashBytes, prevout.hash, prevout.n),
+                        fConnect ? CAddressUnspentValue() : CAddressUnspentValue(coin.out.nValue, coin.out.scriptPubKey, coin.nHeight)));
+                }
+            }
+        }
+
+        if (fConnect) {
+            entries.addressIndex.insert(entries.addressIndex.end(), vOutputs.begin(), vOutputs.end());
+            entries.addressUnspentIndex.insert(entries.addressUnspentIndex.end(), vUnspentOutputs.begin(), vUnspentOutputs.end());
+        }
+    }
+
+    return true;
+}
+
+CIndexBuilder::CIndexBuilder() :
+    nNextJob(0), nJobsDone(0), nIndexes(0), fActive(false), nHeight(0), nStartHeight(0), nStartTime(0)
+{
+}
+
+int CIndexBuilder::GetPendingIndexes()
+{
+    int nPending = 0;
+    if (GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) && !fAddressIndex)
+        nPending |= BUILD_ADDRESSINDEX;
+    if (GetBoolArg("-spentindex", DEFAULT_SPENTINDEX) && !fSpentIndex)
+        nPending |= BUILD_SPENTINDEX;
+    if (GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX) && !fTimestampIndex)
+        nPending |= BUILD_TIMESTAMPINDEX;
+    return nPending;
+}
+
+bool CIndexBuilder::Start(int nIndexesIn, int nThreads, boost::thread_group& threadGroup)
+{
+    const CBlockIndex* pindexStart = NULL;
+    {
+        LOCK(cs_main);
+        if (fHavePruned)
+            return error("%s: cannot build indexes from pruned block files", __func__);
+
+        // Resume the previous build when it was building the same indexes
+        int nIndexesPrev = 0;
+        uint256 hashBest;
+        if (pblocktree->ReadIndexBuildProgress(nIndexesPrev, hashBest) && nIndexesPrev == nIndexesIn) {
+            BlockMap::iterator mi = mapBlockIndex.find(hashBest);
+            if (mi != mapBlockIndex.end())
+                pindexStart = mi->second;
+        }
+
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nIndexes = nIndexesIn;
+        fActive = true;
+        nHeight = pindexStart ? pindexStart->nHeight : 0;
+        nStartHeight = nHeight;
+        nStartTime = GetTime();
+        strError.clear();
+    }
+
+    LogPrintf("%s: building indexes 0x%x from height %d with %d reader threads\n", __func__, nIndexesIn,
+        pindexStart ? pindexStart->nHeight : 0, nThreads);
+
+    for (int i = 0; i < nThreads - 1; i++)
+        threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "idxread", boost::function<void()>(boost::bind(&CIndexBuilder::ThreadRead, this))));
+    threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "idxbuild", boost::function<void()>(boost::bind(&CIndexBuilder::ThreadBuild, this, pindexStart))));
+    return true;
+}
+
+bool CIndexBuilder::IsActive()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return fActive;
+}
+
+void CIndexBuilder::GetStatus(int& nIndexesOut, bool& fActiveOut, int& nHeightOut, int& nStartHeightOut,
+                              int64_t& nStartTimeOut, std::string& strErrorOut)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    nIndexesOut = nIndexes;
+    fActiveOut = fActive;
+    nHeightOut = nHeight;
+    nStartHeightOut = nStartHeight;
+    nStartTimeOut = nStartTime;
+    strErrorOut = strError;
+}
+
+bool CIndexBuilder::ProcessJob(CBuildJob& job)
+{
+    CBlock block;
+    {
+        CAutoFile filein(OpenBlockFile(job.posBlock, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("%s: OpenBlockFile failed for %s", __func__, job.posBlock.ToString());
+        try {
+            filein >> block;
+        } catch (const std::exception& e) {
+            return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), job.posBlock.ToString());
+        }
+    }
+    // The block was fully validated when it was connected, so rather than hashing the header
+    // again only make sure the file position still holds the block the index points to
+    if (block.hashPrevBlock != job.hashPrev || block.hashMerkleRoot != job.hashMerkleRoot)
+        return error("%s: block at %s does not match the block index", __func__, job.posBlock.ToString());
+
+    CBlockUndo blockundo;
+    if (!UndoReadFromDisk(blockundo, job.posUndo, job.hashPrev))
+        return error("%s: failure reading undo data at %s", __func__, job.posUndo.ToString());
+
+    return GetBlockIndexEntries(block, blockundo, job.pindex->nHeight, nIndexes, true, job.entries);
+}
+
+bool CIndexBuilder::ProcessNextJob(boost::unique_lock<boost::mutex>& lock)
+{
+    if (nNextJob >= vJobs.size())
+        return false;
+    CBuildJob& job = vJobs[nNextJob++];
+    lock.unlock();
+    bool fOk = ProcessJob(job);
+    lock.lock();
+    job.fOk = fOk;
+    if (++nJobsDone == vJobs.size())
+        condBuilder.notify_one();
+    return true;
+}
+
+void CIndexBuilder::ThreadRead()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while (true) {
+        while (fActive && nNextJob >= vJobs.size())
+            condWorker.wait(lock);
+        if (!fActive)
+            return;
+        ProcessNextJob(lock);
+    }
+}
+
+bool CIndexBuilder::ReadWindow()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    nNextJob = 0;
+    nJobsDone = 0;
+    condWorker.notify_all();
+    // The builder reads blocks itself too rather than idling until the readers are done
+    while (ProcessNextJob(lock)) {}
+    while (nJobsDone < vJobs.size())
+        condBuilder.wait(lock);
+
+    for (std::vector<CBuildJob>::const_iterator it = vJobs.begin(); it != vJobs.end(); it++) {
+        if (!it->fOk)
+            return false;
+    }
+    return true;
+}
+
+bool CIndexBuilder::CommitWindow(const CBlockIndex*& pindexBest)
+{
+    AssertLockHeld(cs_main);
+    const CBlockIndex* pindexLast = vJobs.back().pindex;
+
+    // Merge the window into one batch sorted in key order. Later blocks may spend outputs created
+    // earlier in the window, so only the final state of every unspent index key is written.
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    std::map<CAddressUnspentKey, CAddressUnspentValue, CAddressUnspentKeyCompare> mapUnspent;
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
+    std::vector<CTimestampIndexKey> timestampIndex;
+    for (std::vector<CBuildJob>::const_iterator it = vJobs.begin(); it != vJobs.end(); it++) {
+        addressIndex.insert(addressIndex.end(), it->entries.addressIndex.begin(), it->entries.addressIndex.end());
+        for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator itu = it->entries.addressUnspentIndex.begin(); itu != it->entries.addressUnspentIndex.end(); itu++)
+            mapUnspent[itu->first] = itu->second;
+        spentIndex.insert(spentIndex.end(), it->entries.spentIndex.begin(), it->entries.spentIndex.end());
+        if (nIndexes & BUILD_TIMESTAMPINDEX)
+            timestampIndex.push_back(CTimestampIndexKey(it->pindex->nTime, it->pindex->GetBlockHash()));
+    }
+    std::sort(addressIndex.begin(), addressIndex.end(), CAddressIndexKeyCompare());
+    std::sort(spentIndex.begin(), spentIndex.end(), CSpentIndexEntryCompare());
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex(mapUnspent.begin(), mapUnspent.end());
+
+    // Balances go first: their own best block marker keeps a replayed window from applying them twice
+    if (nIndexes & BUILD_ADDRESSINDEX) {
+        std::vector<std::pair<CAddressIndexKey, CAmount> > vUnapplied;
+        GetUnappliedBalanceEntries(addressIndex, pindexLast, vUnapplied);
+        if (!pblocktree->UpdateAddressBalanceIndex(vUnapplied, true, pindexLast->GetBlockHash()))
+            return error("%s: failed to write address balance index", __func__);
+    }
+
+    if (!pblocktree->WriteIndexBuildBatch(addressIndex, addressUnspentIndex, spentIndex, timestampIndex,
+                                          nIndexes, pindexLast->GetBlockHash()))
+        return error("%s: failed to write index batch", __func__);
+
+    pindexBest = pindexLast;
+    return true;
+}
+
+bool CIndexBuilder::RewindBlock(const CBlockIndex* pindex)
+{
+    AssertLockHeld(cs_main);
+
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus()))
+        return error("%s: failed to read block %s", __func__, pindex->GetBlockHash().ToString());
+    CBlockUndo blockundo;
+    if (!UndoReadFromDisk(blockundo, pindex->GetUndoPos(), pindex->pprev->GetBlockHash()))
+        return error("%s: failure reading undo data of %s", __func__, pindex->GetBlockHash().ToString());
+
+    CBlockIndexEntries entries;
+    if (!GetBlockIndexEntries(block, blockundo, pindex->nHeight, nIndexes, false, entries))
+        return false;
+
+    if (nIndexes & BUILD_ADDRESSINDEX) {
+        if (IsAddressBalanceApplied(pindex) &&
+            !pblocktree->UpdateAddressBalanceIndex(entries.addressIndex, false, pindex->pprev->GetBlockHash()))
+            return error("%s: failed to write address balance index", __func__);
+        if (!pblocktree->EraseAddressIndex(entries.addressIndex) ||
+            !pblocktree->UpdateAddressUnspentIndex(entries.addressUnspentIndex))
+            return error("%s: failed to rewind address index", __func__);
+    }
+    if ((nIndexes & BUILD_SPENTINDEX) && !pblocktree->UpdateSpentIndex(entries.spentIndex))
+        return error("%s: failed to rewind spent index", __func__);
+
+    return pblocktree->WriteIndexBuildBatch(std::vector<std::pair<CAddressIndexKey, CAmount> >(),
+                                            std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >(),
+                                            std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >(),
+                                            std::vector<CTimestampIndexKey>(),
+                                            nIndexes, pindex->pprev->GetBlockHash());
+}
+
+void CIndexBuilder::Finish()
+{
+    AssertLockHeld(cs_main);
+
+    // From here on ConnectBlock and DisconnectBlock keep the indexes up to date
+    if (nIndexes & BUILD_ADDRESSINDEX) {
+        fAddressIndex = true;
+        pblocktree->WriteFlag("addressindex", true);
+        pblocktree->WriteFlag("addressbalanceindex", true);
+    }
+    if (nIndexes & BUILD_SPENTINDEX) {
+        fSpentIndex = true;
+        pblocktree->WriteFlag("spentindex", true);
+    }
+    if (nIndexes & BUILD_TIMESTAMPINDEX) {
+        fTimestampIndex = true;
+        pblocktree->WriteFlag("timestampindex", true);
+    }
+    pblocktree->EraseIndexBuildProgress();
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    fActive = false;
+    condWorker.notify_all();
+    LogPrintf("CIndexBuilder::%s: indexes 0x%x built up to height %d in %ds\n", __func__, nIndexes, nHeight, GetTime() - nStartTime);
+}
+
+void CIndexBuilder::Fail(const std::string& strErrorIn)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    fActive = false;
+    condWorker.notify_all();
+    strError = strErrorIn;
+    LogPrintf("CIndexBuilder: %s, index build stopped\n", strErrorIn);
+}
+
+void CIndexBuilder::ThreadBuild(const CBlockIndex* pindexStart)
+{
+    const CBlockIndex* pindexBest = pindexStart;
+
+    while (true) {
+        boost::this_thread::interruption_point();
+
+        {
+            LOCK(cs_main);
+            // Undo blocks that were written before a reorg took them out of the active chain
+            while (pindexBest && !chainActive.Contains(pindexBest)) {
+                if (!RewindBlock(pindexBest)) {
+                    Fail("failed to rewind block " + pindexBest->GetBlockHash().ToString());
+                    return;
+                }
+                pindexBest = pindexBest->pprev;
+            }
+
+            if (pindexBest == chainActive.Tip() || (!pindexBest && chainActive.Height() < 1)) {
+                Finish();
+                return;
+            }
+
+            // The genesis block is never connected, so none of the indexes contain it
+            int nNextHeight = pindexBest ? pindexBest->nHeight + 1 : 1;
+            int nLastHeight = std::min(chainActive.Height(), nNextHeight + INDEXBUILDER_BATCH_BLOCKS - 1);
+
+            boost::unique_lock<boost::mutex> lock(mutex);
+            vJobs.clear();
+            vJobs.resize(nLastHeight - nNextHeight + 1);
+            nNextJob = vJobs.size();
+            for (int h = nNextHeight; h <= nLastHeight; h++) {
+                CBuildJob& job = vJobs[h - nNextHeight];
+                job.pindex = chainActive[h];
+                if (!(job.pindex->nStatus & BLOCK_HAVE_DATA) || !(job.pindex->nStatus & BLOCK_HAVE_UNDO)) {
+                    lock.unlock();
+                    Fail(strprintf("block data missing at height %d", h));
+                    return;
+                }
+                job.posBlock = job.pindex->GetBlockPos();
+                job.posUndo = job.pindex->GetUndoPos();
+                job.hashPrev = job.pindex->pprev->GetBlockHash();
+                job.hashMerkleRoot = job.pindex->hashMerkleRoot;
+                job.fOk = false;
+            }
+        }
+
+        if (!ReadWindow()) {
+            Fail("failed to read block or undo data");
+            return;
+        }
+
+        {
+            LOCK(cs_main);
+            // A reorg while the window was being read leaves it for the rewind on the next pass
+            if (!chainActive.Contains(vJobs.back().pindex))
+                continue;
+
+            if (!CommitWindow(pindexBest)) {
+                Fail("failed to write index batch");
+                return;
+            }
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                nHeight = pindexBest->nHeight;
+            }
+
+            // Hand over while still holding cs_main so no block is connected in between
+            if (pindexBest == chainActive.Tip()) {
+                Finish();
+                return;
+            }
+        }
+    }
+}
@@ -0,0 +1,125 @@
+// Copyright (c) 2018-2018 The Zixx developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEXBUILDER_H
+#define BITCOIN_INDEXBUILDER_H
+
+#include "chain.h"
+#include "spentindex.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+class CBlock;
+class CBlockUndo;
+
+namespace boost {
+    class thread_group;
+} // namespace boost
+
+//! -indexbuilderthreads default
+static const int DEFAULT_INDEXBUILDER_THREADS = 2;
+//! Maximum number of block readers of the index builder
+static const int MAX_INDEXBUILDER_THREADS = 16;
+//! Blocks read and written together by the index builder
+static const int INDEXBUILDER_BATCH_BLOCKS = 256;
+
+/** Indexes the builder can derive from the stored blocks */
+enum BuildIndexes
+{
+    BUILD_ADDRESSINDEX = (1 << 0),
+    BUILD_SPENTINDEX = (1 << 1),
+    BUILD_TIMESTAMPINDEX = (1 << 2),
+};
+
+/** Address and spent index entries of one block, in the order ConnectBlock or DisconnectBlock writes them */
+struct CBlockIndexEntries
+{
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
+};
+
+/**
+ * Derive the address and spent index entries of a block from the block and its undo data.
+ * With fConnect the entries add the block to the indexes, otherwise they remove it again.
+ */
+bool GetBlockIndexEntries(const CBlock& block, const CBlockUndo& blockundo, int nHeight, int nIndexes,
+                          bool fConnect, CBlockIndexEntries& entries);
+
+/**
+ * Builds the address, spent and timestamp indexes of a chain that was synced without them,
+ * while the node keeps running. Reader threads derive the entries of a window of blocks from
+ * the block and undo files; the entries are merged into one sorted batch and written in chain
+ * order together with the progress, so an interrupted build resumes where it stopped. Once the
+ * builder has caught up with the tip it enables the indexes and ConnectBlock/DisconnectBlock
+ * maintain them from then on.
+ */
+class CIndexBuilder
+{
+private:
+    /** One block to derive index entries for */
+    struct CBuildJob
+    {
+        const CBlockIndex* pindex;
+        CDiskBlockPos posBlock;
+        CDiskBlockPos posUndo;
+        uint256 hashPrev;
+        uint256 hashMerkleRoot;
+        bool fOk;
+        CBlockIndexEntries entries;
+    };
+
+    //! Protects the job window and the progress fields below
+    boost::mutex mutex;
+    //! Readers wait on this for a new window of blocks
+    boost::condition_variable condWorker;
+    //! The builder waits on this for the window to be read
+    boost::condition_variable condBuilder;
+
+    std::vector<CBuildJob> vJobs;
+    size_t nNextJob;
+    size_t nJobsDone;
+
+    int nIndexes;
+    bool fActive;
+    int nHeight;
+    int nStartHeight;
+    int64_t nStartTime;
+    std::string strError;
+
+    bool ProcessJob(CBuildJob& job);
+    bool ProcessNextJob(boost::unique_lock<boost::mutex>& lock);
+    bool ReadWindow();
+    bool CommitWindow(const CBlockIndex*& pindexBest);
+    bool RewindBlock(const CBlockIndex* pindex);
+    void Finish();
+    void Fail(const std::string& strErrorIn);
+
+    void ThreadRead();
+    void ThreadBuild(const CBlockIndex* pindexStart);
+
+public:
+    CIndexBuilder();
+
+    /** Indexes requested on the command line but not yet present in the block tree database */
+    static int GetPendingIndexes();
+
+    /** Start building nIndexesIn in the background, resuming a previous build if possible */
+    bool Start(int nIndexesIn, int nThreads, boost::thread_group& threadGroup);
+
+    bool IsActive();
+
+    /** Progress for RPC: indexes being built, last height written and the height the build started at */
+    void GetStatus(int& nIndexesOut, bool& fActiveOut, int& nHeightOut, int& nStartHeightOut,
+                   int64_t& nStartTimeOut, std::string& strErrorOut);
+};
+
+extern CIndexBuilder indexBuilder;
+
+#endif // BITCOIN_INDEXBUILDER_H
@@ -21,6 +21,7 @@
 #include "consensus/validation.h"
 #include "httpserver.h"
 #include "httprpc.h"
+#include "indexbuilder.h"
 #include "key.h"
 #include "validation.h"
 #include "miner.h"
@@ -55,6 +56,7 @@
 #ifdef ENABLE_WALLET
 #include "keepass.h"
 #endif
+#include "maintenance.h"
 #include "masternode-payments.h"
 #include "masternode-sync.h"
 #include "masternodeman.h"
@@ -104,6 +106,7 @@ static const bool DEFAULT_PROXYRANDOMIZE = true;
 static const bool DEFAULT_REST_ENABLE = false;
 static const bool DEFAULT_DISABLE_SAFEMODE = false;
 static const bool DEFAULT_STOPAFTERBLOCKIMPORT = false;
+static const int64_t DEFAULT_CACHE_SNAPSHOT_INTERVAL = 15 * 60;
 
 std::unique_ptr<CConnman> g_connman;
 std::unique_ptr<PeerLogicValidation> peerLogic;
@@ -210,6 +213,25 @@ void Interrupt(boost::thread_group& threadGroup)
     threadGroup.interrupt_all();
 }
 
+/**
+ * Write the data caches from their own scheduler thread so that a crash doesn't lose them
+ * and a long write doesn't hold up the maintenance tasks of the main scheduler.
+ * The managers are locked only while they are copied, see CFlatDB::Snapshot.
+ */
+static CScheduler snapshotScheduler;
+
+static void SnapshotCaches()
+{
+    static CFlatDB<CMasternodeMan> flatdb1("mncache2.dat", "magicMasternodeCache");
+    flatdb1.Snapshot(mnodeman);
+    static CFlatDB<CMasternodePayments> flatdb2("mnpayments2.dat", "magicMasternodePaymentsCache");
+    flatdb2.Snapshot(mnpayments);
+    static CFlatDB<CGovernanceManager> flatdb3("governance2.dat", "magicGovernanceCache");
+    flatdb3.Snapshot(governance);
+    static CFlatDB<CNetFulfilledRequestManager> flatdb4("netfulfilled2.dat", "magicFulfilledCache");
+    flatdb4.Snapshot(netfulfilledman);
+}
+
 /** Preparing steps before shutting down or restarting the wallet */
 void PrepareShutdown()
 {
@@ -242,13 +264,13 @@ void PrepareShutdown()
     g_connman.reset();
 
     // STORE DATA CACHES INTO SERIALIZED DAT FILES
-    CFlatDB<CMasternodeMan> flatdb1("mncache.dat", "magicMasternodeCache");
+    CFlatDB<CMasternodeMan> flatdb1("mncache2.dat", "magicMasternodeCache");
     flatdb1.Dump(mnodeman);
-    CFlatDB<CMasternodePayments> flatdb2("mnpayments.dat", "magicMasternodePaymentsCache");
+    CFlatDB<CMasternodePayments> flatdb2("mnpayments2.dat", "magicMasternodePaymentsCache");
     flatdb2.Dump(mnpayments);
-    CFlatDB<CGovernanceManager> flatdb3("governance.dat", "magicGovernanceCache");
+    CFlatDB<CGovernanceManager> flatdb3("governance2.dat", "magicGovernanceCache");
     flatdb3.Dump(governance);
-    CFlatDB<CNetFulfilledRequestManager> flatdb4("netfulfilled.dat", "magicFulfilledCache");
+    CFlatDB<CNetFulfilledRequestManager> flatdb4("netfulfilled2.dat", "magicFulfilledCache");
     flatdb4.Dump(netfulfilledman);
 
     UnregisterNodeSignals(GetNodeSignals());
@@ -431,6 +453,8 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-addressindex", strprintf(_("Maintain a full address index, used to query for the balance, txids and unspent outputs for addresses (default: %u)"), DEFAULT_ADDRESSINDEX));
     strUsage += HelpMessageOpt("-timestampindex", strprintf(_("Maintain a timestamp index for block hashes, used to query blocks hashes by a range of timestamps (default: %u)"), DEFAULT_TIMESTAMPINDEX));
     strUsage += HelpMessageOpt("-spentindex", strprintf(_("Maintain a full spent index, used to query the spending txid and input index for an outpoint (default: %u)"), DEFAULT_SPENTINDEX));
+    strUsage += HelpMessageOpt("-blockfilterindex", strprintf(_("Maintain compact per-block script filters for blocks connected while enabled, used to skip blocks during wallet rescans (default: %u)"), DEFAULT_BLOCKFILTERINDEX));
+    strUsage += HelpMessageOpt("-indexbuilderthreads=<n>", strprintf(_("Number of threads reading blocks when one of the above indexes is enabled on an existing chain (1 to %d, default: %d)"), MAX_INDEXBUILDER_THREADS, DEFAULT_INDEXBUILDER_THREADS));
 
     strUsage += HelpMessageGroup(_("Connection options:"));
     strUsage += HelpMessageOpt("-addnode=<ip>", _("Add a node to connect to and attempt to keep the connection open"));
@@ -521,6 +545,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-zmqpubrawblock=<address>", _("Enable publish raw block in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtx=<address>", _("Enable publish raw transaction in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtxlock=<address>", _("Enable publish raw transaction (locked via InstantSend) in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubtxlocktrace=<address>", _("Enable publish stage timings of InstantSend transaction locks in <address>"));
 #endif
 
     strUsage += HelpMessageGroup(_("Debugging/Testing options:"));
@@ -548,7 +573,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-limitdescendantcount=<n>", strprintf("Do not accept transactions if any ancestor would have <n> or more in-mempool descendants (default: %u)", DEFAULT_DESCENDANT_LIMIT));
         strUsage += HelpMessageOpt("-limitdescendantsize=<n>", strprintf("Do not accept transactions if any ancestor would have more than <n> kilobytes of in-mempool descendants (default: %u).", DEFAULT_DESCENDANT_SIZE_LIMIT));
     }
-    string debugCategories = "addrman, alert, bench, coindb, db, http, leveldb, libevent, lock, mempool, mempoolrej, net, proxy, prune, rand, reindex, rpc, selectcoins, tor, zmq, "
+    string debugCategories = "addrman, alert, bench, coindb, db, flatdb, http, leveldb, libevent, lock, mempool, mempoolrej, net, proxy, prune, rand, reindex, rpc, selectcoins, tor, zmq, "
                              "zixx (or specifically: gobject, instantsend, keepass, masternode, mnpayments, mnsync, privatesend, spork)"; // Don't translate these and qt below
     if (mode == HMM_BITCOIN_QT)
         debugCategories += ", qt";
@@ -584,6 +609,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-shrinkdebugfile", _("Shrink debug.log file on client startup (default: 1 when no -debug)"));
     AppendParamsHelpMessages(strUsage, showDebug);
     strUsage += HelpMessageOpt("-litemode=<n>", strprintf(_("Disable all Zixx specific functionality (Masternodes, PrivateSend, InstantSend, Governance) (0-1, default: %u)"), 0));
+    strUsage += HelpMessageOpt("-cachesnapshotinterval=<n>", strprintf(_("Write masternode, payment and governance caches to disk every <n> seconds, 0 to write them at shutdown only (default: %u)"), DEFAULT_CACHE_SNAPSHOT_INTERVAL));
 
     strUsage += HelpMessageGroup(_("Masternode options:"));
     strUsage += HelpMessageOpt("-masternode=<n>", strprintf(_("Enable the client to act as a masternode (0-1, default: %u)"), 0));
@@ -1079,6 +1105,8 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     }
     fCheckBlockIndex = GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
     fCheckpointsEnabled = GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
+    // filters are optional per block, blocks connected without one are read in full by rescans
+    fBlockFilterIndex = GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX);
 
     hashAssumeValid = uint256S(GetArg("-assumevalid", chainparams.GetConsensus().defaultAssumeValid.GetHex()));
     if (!hashAssumeValid.IsNull())
@@ -1825,8 +1853,19 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             uiInterface.InitMessage(_("Rescanning..."));
             LogPrintf("Rescanning last %i blocks (from block %i)...\n", chainActive.Height() - pindexRescan->nHeight, pindexRescan->nHeight);
             nStart = GetTimeMillis();
-            pwalletMain->ScanForWalletTransactions(pindexRescan, true);
+            {
+                CWalletRescanReserver reserver(pwalletMain);
+                if (!reserver.Reserve())
+                    return InitError(_("Failed to rescan the wallet during initialization"));
+                pwalletMain->ScanForWalletTransactions(pindexRescan, reserver, true);
+            }
             LogPrintf(" rescan      %15dms\n", GetTimeMillis() - nStart);
+            // an interrupted rescan must resume from the old locator on the next start
+            if (fRequestShutdown)
+            {
+                LogPrintf("Shutdown requested. Exiting.\n");
+                return false;
+            }
             pwalletMain->SetBestChain(chainActive.GetLocator());
             nWalletDBUpdated++;
 
@@ -1892,6 +1931,14 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             MilliSleep(10);
     }
 
+    // Indexes enabled on a chain that was synced without them are built in the background
+    int nBuildIndexes = CIndexBuilder::GetPendingIndexes();
+    if (nBuildIndexes != 0) {
+        int nIndexBuilderThreads = std::max(1, std::min((int)GetArg("-indexbuilderthreads", DEFAULT_INDEXBUILDER_THREADS), MAX_INDEXBUILDER_THREADS));
+        if (!indexBuilder.Start(nBuildIndexes, nIndexBuilderThreads, threadGroup))
+            InitWarning(_("Unable to build the requested indexes from pruned block files. Restart with -reindex to enable them."));
+    }
+
     // ********************************************************* Step 11a: setup PrivateSend
     fMasterNode = GetBoolArg("-masternode", false);
     // TODO: masternode should have no wallet
@@ -1971,28 +2018,29 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     // ********************************************************* Step 11b: Load cache data
 
     // LOAD SERIALIZED DAT FILES INTO DATA CACHES FOR INTERNAL USE
+    // (files of older versions are read when the new ones don't exist yet and left in place for them)
 
     boost::filesystem::path pathDB = GetDataDir();
     std::string strDBName;
 
-    strDBName = "mncache.dat";
+    strDBName = "mncache2.dat";
     uiInterface.InitMessage(_("Loading masternode cache..."));
-    CFlatDB<CMasternodeMan> flatdb1(strDBName, "magicMasternodeCache");
+    CFlatDB<CMasternodeMan> flatdb1(strDBName, "magicMasternodeCache", "mncache.dat");
     if(!flatdb1.Load(mnodeman)) {
         return InitError(_("Failed to load masternode cache from") + "\n" + (pathDB / strDBName).string());
     }
 
     if(mnodeman.size()) {
-        strDBName = "mnpayments.dat";
+        strDBName = "mnpayments2.dat";
         uiInterface.InitMessage(_("Loading masternode payment cache..."));
-        CFlatDB<CMasternodePayments> flatdb2(strDBName, "magicMasternodePaymentsCache");
+        CFlatDB<CMasternodePayments> flatdb2(strDBName, "magicMasternodePaymentsCache", "mnpayments.dat");
         if(!flatdb2.Load(mnpayments)) {
             return InitError(_("Failed to load masternode payments cache from") + "\n" + (pathDB / strDBName).string());
         }
 
-        strDBName = "governance.dat";
+        strDBName = "governance2.dat";
         uiInterface.InitMessage(_("Loading governance cache..."));
-        CFlatDB<CGovernanceManager> flatdb3(strDBName, "magicGovernanceCache");
+        CFlatDB<CGovernanceManager> flatdb3(strDBName, "magicGovernanceCache", "governance.dat");
         if(!flatdb3.Load(governance)) {
             return InitError(_("Failed to load governance cache from") + "\n" + (pathDB / strDBName).string());
         }
@@ -2001,13 +2049,20 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         uiInterface.InitMessage(_("Masternode cache is empty, skipping payments and governance cache..."));
     }
 
-    strDBName = "netfulfilled.dat";
+    strDBName = "netfulfilled2.dat";
     uiInterface.InitMessage(_("Loading fulfilled requests cache..."));
-    CFlatDB<CNetFulfilledRequestManager> flatdb4(strDBName, "magicFulfilledCache");
+    CFlatDB<CNetFulfilledRequestManager> flatdb4(strDBName, "magicFulfilledCache", "netfulfilled.dat");
     if(!flatdb4.Load(netfulfilledman)) {
         return InitError(_("Failed to load fulfilled requests cache from") + "\n" + (pathDB / strDBName).string());
     }
 
+    int64_t nCacheSnapshotInterval = GetArg("-cachesnapshotinterval", DEFAULT_CACHE_SNAPSHOT_INTERVAL);
+    if (nCacheSnapshotInterval > 0 && !fLiteMode) {
+        CScheduler::Function snapshotLoop = boost::bind(&CScheduler::serviceQueue, &snapshotScheduler);
+        threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "cachesnapshot", snapshotLoop));
+        snapshotScheduler.scheduleEvery(&SnapshotCaches, nCacheSnapshotInterval);
+    }
+
     // ********************************************************* Step 11c: update block tip in Zixx modules
 
     // force UpdatedBlockTip to initialize nCachedBlockHeight for DS, MN payments and budgets
@@ -2022,7 +2077,9 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
 
     // ********************************************************* Step 11d: start zixx-ps-<smth> threads
 
-    threadGroup.create_thread(boost::bind(&ThreadCheckPrivateSend, boost::ref(*g_connman)));
+    // masternode, governance and InstantSend maintenance runs on the scheduler thread
+    ScheduleMasternodeMaintenance(scheduler, *g_connman);
+    threadGroup.create_thread(boost::bind(&ThreadInstantSendVotes, boost::ref(*g_connman)));
     if (fMasterNode)
         threadGroup.create_thread(boost::bind(&ThreadCheckPrivateSendServer, boost::ref(*g_connman)));
 #ifdef ENABLE_WALLET
@@ -76,6 +76,88 @@ void CInstantSend::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataSt
         // Ignore any InstantSend messages until masternode list is synced
         if(!masternodeSync.IsMasternodeListSynced()) return;
 
+        {
+            LOCK(cs_instantsend);
+            if(mapTxLockVotes.count(nVoteHash)) return;
+            mapTxLockVotes.insert(std::make_pair(nVoteHash, vote));
+            dequeTxLockVoteTimes.push_back(std::make_pair(GetTime(), nVoteHash));
+        }
+
+        // validation and processing happen in ThreadInstantSendVotes
+        if(!QueueTxLockVote(pfrom->GetId(), vote)) {
+            LogPrint("instantsend", "CInstantSend::ProcessMessage -- vote queue is full, dropping vote %s, peer=%d\n", nVoteHash.ToString(), pfrom->id);
+            // forget about it so that it can be requested again
+            LOCK(cs_instantsend);
+            mapTxLockVotes.erase(nVoteHash);
+        }
+
+        return;
+    }
+}
+
+bool CInstantSend::QueueTxLockVote(NodeId nodeId, const CTxLockVote& vote)
+{
+    boost::lock_guard<boost::mutex> lock(cs_votequeue);
+
+    if(queueTxLockVotes.size() >= INSTANTSEND_VOTE_QUEUE_MAX) {
+        voteStats.nVotesDropped++;
+        return false;
+    }
+
+    queueTxLockVotes.push_back(std::make_pair(nodeId, vote));
+    voteStats.nVotesQueued++;
+    voteStats.nQueueSizeMax = std::max(voteStats.nQueueSizeMax, queueTxLockVotes.size());
+    condVoteQueue.notify_one();
+    return true;
+}
+
+void CInstantSend::ProcessTxLockVoteQueue(CConnman& connman)
+{
+    std::vector<std::pair<NodeId, CTxLockVote> > vecVotes;
+    {
+        boost::unique_lock<boost::mutex> lock(cs_votequeue);
+        while(queueTxLockVotes.empty()) {
+            condVoteQueue.wait(lock);
+        }
+        while(!queueTxLockVotes.empty() && vecVotes.size() < INSTANTSEND_VOTE_BATCH_SIZE) {
+            vecVotes.push_back(queueTxLockVotes.front());
+            queueTxLockVotes.pop_front();
+        }
+    }
+
+    // Rank and signature checks only take short internal locks,
+    // do them before touching cs_main
+    std::vector<CTxLockVote> vecValidVotes;
+    int nInvalid = 0;
+    for(size_t i = 0; i < vecVotes.size(); ++i) {
+        CTxLockVote& vote = vecVotes[i].second;
+
+        CNode* pfrom = NULL;
+        connman.ForNode(vecVotes[i].first, [&pfrom](CNode* pnode) {
+            pfrom = pnode->AddRef();
+            return true;
+        });
+        bool fValid = vote.IsValid(pfrom, connman);
+        if(pfrom) {
+            pfrom->Release();
+        }
+
+        if(!fValid) {
+            // could be because of missing MN
+            LogPrint("instantsend", "CInstantSend::ProcessTxLockVoteQueue -- Vote is invalid, txid=%s\n", vote.GetTxHash().ToString());
+            nInvalid++;
+            continue;
+        }
+
+        // relay valid vote asap
+        int64_t nTimeStart = GetTimeMicros();
+        vote.Relay(connman);
+        AddTraceTime(INSTANTSEND_TRACE_RELAY, GetTimeMicros() - nTimeStart);
+        vecValidVotes.push_back(vote);
+    }
+
+    int64_t nMainLockMicros = 0;
+    if(!vecValidVotes.empty()) {
         LOCK(cs_main);
 #ifdef ENABLE_WALLET
         if (pwalletMain)
@@ -83,13 +165,30 @@ void CInstantSend::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataSt
 #endif
         LOCK(cs_instantsend);
 
-        if(mapTxLockVotes.count(nVoteHash)) return;
-        mapTxLockVotes.insert(std::make_pair(nVoteHash, vote));
+        int64_t nTimeStart = GetTimeMicros();
+        for(size_t i = 0; i < vecValidVotes.size(); ++i) {
+            ProcessTxLockVote(vecValidVotes[i], connman);
+        }
+        nMainLockMicros = GetTimeMicros() - nTimeStart;
+    }
 
-        ProcessTxLockVote(pfrom, vote, connman);
+    LogPrint("instantsend", "CInstantSend::ProcessTxLockVoteQueue -- votes: %d, invalid: %d, cs_main held for %.2fms\n",
+            vecVotes.size(), nInvalid, nMainLockMicros * 0.001);
 
-        return;
-    }
+    boost::lock_guard<boost::mutex> lock(cs_votequeue);
+    voteStats.nBatches++;
+    voteStats.nVotesInvalid += nInvalid;
+    voteStats.nVotesProcessed += vecValidVotes.size();
+    voteStats.nMainLockMicrosTotal += nMainLockMicros;
+    voteStats.nMainLockMicrosMax = std::max(voteStats.nMainLockMicrosMax, nMainLockMicros);
+}
+
+CInstantSendVoteStats CInstantSend::GetVoteStats()
+{
+    boost::lock_guard<boost::mutex> lock(cs_votequeue);
+    CInstantSendVoteStats stats = voteStats;
+    stats.nQueueSize = queueTxLockVotes.size();
+    return stats;
 }
 
 bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest, CConnman& connman)
@@ -100,7 +199,7 @@ bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest, CCo
 
     // Check to see if we conflict with existing completed lock
     BOOST_FOREACH(const CTxIn& txin, txLockRequest.vin) {
-        std::map<COutPoint, uint256>::iterator it = mapLockedOutpoints.find(txin.prevout);
+        outpoint_hash_m_t::iterator it = mapLockedOutpoints.find(txin.prevout);
         if(it != mapLockedOutpoints.end() && it->second != txLockRequest.GetHash()) {
             // Conflicting with complete lock, proceed to see if we should cancel them both
             LogPrintf("CInstantSend::ProcessTxLockRequest -- WARNING: Found conflicting completed Transaction Lock, txid=%s, completed lock txid=%s\n",
@@ -111,7 +210,7 @@ bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest, CCo
     // Check to see if there are votes for conflicting request,
     // if so - do not fail, just warn user
     BOOST_FOREACH(const CTxIn& txin, txLockRequest.vin) {
-        std::map<COutPoint, std::set<uint256> >::iterator it = mapVotedOutpoints.find(txin.prevout);
+        outpoint_hash_set_m_t::iterator it = mapVotedOutpoints.find(txin.prevout);
         if(it != mapVotedOutpoints.end()) {
             BOOST_FOREACH(const uint256& hash, it->second) {
                 if(hash != txLockRequest.GetHash()) {
@@ -133,7 +232,7 @@ bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest, CCo
     // Masternodes will sometimes propagate votes before the transaction is known to the client.
     // If this just happened - lock inputs, resolve conflicting locks, update transaction status
     // forcing external script notification.
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    txlockcandidate_m_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     TryToFinalizeLockCandidate(itLockCandidate->second);
 
     return true;
@@ -147,11 +246,13 @@ bool CInstantSend::CreateTxLockCandidate(const CTxLockRequest& txLockRequest)
 
     uint256 txHash = txLockRequest.GetHash();
 
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    txlockcandidate_m_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     if(itLockCandidate == mapTxLockCandidates.end()) {
         LogPrintf("CInstantSend::CreateTxLockCandidate -- new, txid=%s\n", txHash.ToString());
 
         CTxLockCandidate txLockCandidate(txLockRequest);
+        txLockCandidate.trace.txHash = txHash;
+        txLockCandidate.trace.nTimeRequest = GetTimeMicros();
         // all inputs should already be checked by txLockRequest.IsValid() above, just use them now
         BOOST_REVERSE_FOREACH(const CTxIn& txin, txLockRequest.vin) {
             txLockCandidate.AddOutPointLock(txin.prevout);
@@ -160,6 +261,7 @@ bool CInstantSend::CreateTxLockCandidate(const CTxLockRequest& txLockRequest)
     } else if (!itLockCandidate->second.txLockRequest) {
         // i.e. empty Transaction Lock Candidate was created earlier, let's update it with actual data
         itLockCandidate->second.txLockRequest = txLockRequest;
+        itLockCandidate->second.trace.nTimeRequest = GetTimeMicros();
         if (itLockCandidate->second.IsTimedOut()) {
             LogPrintf("CInstantSend::CreateTxLockCandidate -- timed out, txid=%s\n", txHash.ToString());
             return false;
@@ -183,7 +285,9 @@ void CInstantSend::CreateEmptyTxLockCandidate(const uint256& txHash)
         return;
     LogPrintf("CInstantSend::CreateEmptyTxLockCandidate -- new, txid=%s\n", txHash.ToString());
     const CTxLockRequest txLockRequest = CTxLockRequest();
-    mapTxLockCandidates.insert(std::make_pair(txHash, CTxLockCandidate(txLockRequest)));
+    CTxLockCandidate txLockCandidate(txLockRequest);
+    txLockCandidate.trace.txHash = txHash;
+    mapTxLockCandidates.insert(std::make_pair(txHash, txLockCandidate));
 }
 
 void CInstantSend::Vote(const uint256& txHash, CConnman& connman)
@@ -191,7 +295,7 @@ void CInstantSend::Vote(const uint256& txHash, CConnman& connman)
     AssertLockHeld(cs_main);
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    txlockcandidate_m_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     if (itLockCandidate == mapTxLockCandidates.end()) return;
     Vote(itLockCandidate->second, connman);
     // Let's see if our vote changed smth
@@ -237,14 +341,14 @@ void CInstantSend::Vote(CTxLockCandidate& txLockCandidate, CConnman& connman)
 
         LogPrint("instantsend", "CInstantSend::Vote -- In the top %d (%d)\n", nSignaturesTotal, nRank);
 
-        std::map<COutPoint, std::set<uint256> >::iterator itVoted = mapVotedOutpoints.find(itOutpointLock->first);
+        outpoint_hash_set_m_t::iterator itVoted = mapVotedOutpoints.find(itOutpointLock->first);
 
         // Check to see if we already voted for this outpoint,
         // refuse to vote twice or to include the same outpoint in another tx
         bool fAlreadyVoted = false;
         if(itVoted != mapVotedOutpoints.end()) {
             BOOST_FOREACH(const uint256& hash, itVoted->second) {
-                std::map<uint256, CTxLockCandidate>::iterator it2 = mapTxLockCandidates.find(hash);
+                txlockcandidate_m_t::iterator it2 = mapTxLockCandidates.find(hash);
                 if(it2->second.HasMasternodeVoted(itOutpointLock->first, activeMasternode.outpoint)) {
                     // we already voted for this outpoint to be included either in the same tx or in a competing one,
                     // skip it anyway
@@ -275,6 +379,7 @@ void CInstantSend::Vote(CTxLockCandidate& txLockCandidate, CConnman& connman)
         // vote constructed sucessfully, let's store and relay it
         uint256 nVoteHash = vote.GetHash();
         mapTxLockVotes.insert(std::make_pair(nVoteHash, vote));
+        dequeTxLockVoteTimes.push_back(std::make_pair(GetTime(), nVoteHash));
         if(itOutpointLock->second.AddVote(vote)) {
             LogPrintf("CInstantSend::Vote -- Vote created successfully, relaying: txHash=%s, outpoint=%s, vote=%s\n",
                     txHash.ToString(), itOutpointLock->first.ToStringShort(), nVoteHash.ToString());
@@ -300,7 +405,7 @@ void CInstantSend::Vote(CTxLockCandidate& txLockCandidate, CConnman& connman)
 }
 
 //received a consensus vote
-bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote, CConnman& connman)
+bool CInstantSend::ProcessTxLockVote(CTxLockVote& vote, CConnman& connman)
 {
     // cs_main, cs_wallet and cs_instantsend should be already locked
     AssertLockHeld(cs_main);
@@ -312,28 +417,22 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote, CConnman&
 
     uint256 txHash = vote.GetTxHash();
 
-    if(!vote.IsValid(pfrom, connman)) {
-        // could be because of missing MN
-        LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- Vote is invalid, txid=%s\n", txHash.ToString());
-        return false;
-    }
-
-    // relay valid vote asap
-    vote.Relay(connman);
-
     // Masternodes will sometimes propagate votes before the transaction is known to the client,
     // will actually process only after the lock request itself has arrived
 
-    std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
+    txlockcandidate_m_t::iterator it = mapTxLockCandidates.find(txHash);
     if(it == mapTxLockCandidates.end() || !it->second.txLockRequest) {
-        if(!mapTxLockVotesOrphan.count(vote.GetHash())) {
+        std::set<uint256>& setOrphanVotes = mapTxLockVotesOrphan[txHash];
+        if(!setOrphanVotes.count(vote.GetHash())) {
             // start timeout countdown after the very first vote
             CreateEmptyTxLockCandidate(txHash);
-            mapTxLockVotesOrphan[vote.GetHash()] = vote;
+            setOrphanVotes.insert(vote.GetHash());
+            mapTxLockVotes.insert(std::make_pair(vote.GetHash(), vote));
+            dequeOrphanVoteTimes.push_back(std::make_pair(GetTime(), vote.GetHash()));
             LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- Orphan vote: txid=%s  masternode=%s new\n",
                     txHash.ToString(), vote.GetMasternodeOutpoint().ToStringShort());
             bool fReprocess = true;
-            std::map<uint256, CTxLockRequest>::iterator itLockRequest = mapLockRequestAccepted.find(txHash);
+            txlockrequest_m_t::iterator itLockRequest = mapLockRequestAccepted.find(txHash);
             if(itLockRequest == mapLockRequestAccepted.end()) {
                 itLockRequest = mapLockRequestRejected.find(txHash);
                 if(itLockRequest == mapLockRequestRejected.end()) {
@@ -383,14 +482,14 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote, CConnman&
 
     LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- Transaction Lock Vote, txid=%s\n", txHash.ToString());
 
-    std::map<COutPoint, std::set<uint256> >::iterator it1 = mapVotedOutpoints.find(vote.GetOutpoint());
+    outpoint_hash_set_m_t::iterator it1 = mapVotedOutpoints.find(vote.GetOutpoint());
     if(it1 != mapVotedOutpoints.end()) {
         BOOST_FOREACH(const uint256& hash, it1->second) {
             if(hash != txHash) {
                 // same outpoint was already voted to be locked by another tx lock request,
                 // let's see if it was the same masternode who voted on this outpoint
                 // for another tx lock request
-                std::map<uint256, CTxLockCandidate>::iterator it2 = mapTxLockCandidates.find(hash);
+                txlockcandidate_m_t::iterator it2 = mapTxLockCandidates.find(hash);
                 if(it2 !=mapTxLockCandidates.end() && it2->second.HasMasternodeVoted(vote.GetOutpoint(), vote.GetMasternodeOutpoint())) {
                     // yes, it was the same masternode
                     LogPrintf("CInstantSend::ProcessTxLockVote -- masternode sent conflicting votes! %s\n", vote.GetMasternodeOutpoint().ToStringShort());
@@ -439,12 +538,24 @@ void CInstantSend::ProcessOrphanTxLockVotes(CConnman& connman)
 #endif
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.begin();
-    while(it != mapTxLockVotesOrphan.end()) {
-        if(ProcessTxLockVote(NULL, it->second, connman)) {
-            mapTxLockVotesOrphan.erase(it++);
-        } else {
-            ++it;
+    // processing can change the orphan index, work on a copy of it
+    std::vector<std::pair<uint256, uint256> > vecOrphanVotes; // tx hash - vote hash
+    for(hash_set_m_t::iterator it = mapTxLockVotesOrphan.begin(); it != mapTxLockVotesOrphan.end(); ++it) {
+        BOOST_FOREACH(const uint256& nVoteHash, it->second) {
+            vecOrphanVotes.push_back(std::make_pair(it->first, nVoteHash));
+        }
+    }
+
+    for(size_t i = 0; i < vecOrphanVotes.size(); ++i) {
+        txlockvote_m_t::iterator itVote = mapTxLockVotes.find(vecOrphanVotes[i].second);
+        if(itVote == mapTxLockVotes.end()) continue;
+        if(itVote->second.IsValid(NULL, connman) && ProcessTxLockVote(itVote->second, connman)) {
+            hash_set_m_t::iterator itOrphan = mapTxLockVotesOrphan.find(vecOrphanVotes[i].first);
+            if(itOrphan == mapTxLockVotesOrphan.end()) continue;
+            itOrphan->second.erase(vecOrphanVotes[i].second);
+            if(itOrphan->second.empty()) {
+                mapTxLockVotesOrphan.erase(itOrphan);
+            }
         }
     }
 }
@@ -467,20 +578,21 @@ bool CInstantSend::IsEnoughOrphanVotesForTxAndOutPoint(const uint256& txHash, co
     // Scan orphan votes to check if this outpoint has enough orphan votes to be locked in some tx.
     LOCK2(cs_main, cs_instantsend);
     int nCountVotes = 0;
-    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.begin();
-    while(it != mapTxLockVotesOrphan.end()) {
-        if(it->second.GetTxHash() == txHash && it->second.GetOutpoint() == outpoint) {
+    hash_set_m_t::iterator itOrphan = mapTxLockVotesOrphan.find(txHash);
+    if(itOrphan == mapTxLockVotesOrphan.end()) return false;
+    BOOST_FOREACH(const uint256& nVoteHash, itOrphan->second) {
+        txlockvote_m_t::iterator itVote = mapTxLockVotes.find(nVoteHash);
+        if(itVote != mapTxLockVotes.end() && itVote->second.GetOutpoint() == outpoint) {
             nCountVotes++;
             if(nCountVotes >= COutPointLock::SIGNATURES_REQUIRED) {
                 return true;
             }
         }
-        ++it;
     }
     return false;
 }
 
-void CInstantSend::TryToFinalizeLockCandidate(const CTxLockCandidate& txLockCandidate)
+void CInstantSend::TryToFinalizeLockCandidate(CTxLockCandidate& txLockCandidate)
 {
     if(!sporkManager.IsSporkActive(SPORK_2_INSTANTSEND_ENABLED)) return;
 
@@ -495,9 +607,33 @@ void CInstantSend::TryToFinalizeLockCandidate(const CTxLockCandidate& txLockCand
     if(txLockCandidate.IsAllOutPointsReady() && !IsLockedInstantSendTransaction(txHash)) {
         // we have enough votes now
         LogPrint("instantsend", "CInstantSend::TryToFinalizeLockCandidate -- Transaction Lock is ready to complete, txid=%s\n", txHash.ToString());
+        int64_t nTimeStart = GetTimeMicros();
+        if(txLockCandidate.trace.nTimeReady == 0) {
+            txLockCandidate.trace.nTimeReady = nTimeStart;
+        }
+        // NOTE: txLockCandidate could be removed by ResolveConflicts, do not touch it if that fails
         if(ResolveConflicts(txLockCandidate)) {
             LockTransactionInputs(txLockCandidate);
+            CTxLockTrace& trace = txLockCandidate.trace;
+            trace.nTimeLocked = GetTimeMicros();
+            AddTraceTime(INSTANTSEND_TRACE_FINALIZE, trace.nTimeLocked - nTimeStart);
+            if(trace.nTimeRequest != 0) {
+                if(trace.nTimeFirstVote != 0) {
+                    AddTraceTime(INSTANTSEND_TRACE_FIRST_VOTE, trace.nTimeFirstVote - trace.nTimeRequest);
+                }
+                AddTraceTime(INSTANTSEND_TRACE_READY, trace.nTimeReady - trace.nTimeRequest);
+                AddTraceTime(INSTANTSEND_TRACE_LOCK, trace.nTimeLocked - trace.nTimeRequest);
+            }
+            LogPrint("instantsend", "CInstantSend::TryToFinalizeLockCandidate -- %s\n", trace.ToString());
+
             UpdateLockedTransaction(txLockCandidate);
+            GetMainSignals().NotifyTransactionLockTrace(trace);
+
+            int64_t nLockLatency = GetTimeMicros() - txLockCandidate.GetTimeCreatedMicros();
+            boost::lock_guard<boost::mutex> lock(cs_votequeue);
+            voteStats.nLocksCompleted++;
+            voteStats.nLockLatencyMicrosTotal += nLockLatency;
+            voteStats.nLockLatencyMicrosMax = std::max(voteStats.nLockLatencyMicrosMax, nLockLatency);
         }
     }
 }
@@ -555,7 +691,7 @@ void CInstantSend::LockTransactionInputs(const CTxLockCandidate& txLockCandidate
 bool CInstantSend::GetLockedOutPointTxHash(const COutPoint& outpoint, uint256& hashRet)
 {
     LOCK(cs_instantsend);
-    std::map<COutPoint, uint256>::iterator it = mapLockedOutpoints.find(outpoint);
+    outpoint_hash_m_t::iterator it = mapLockedOutpoints.find(outpoint);
     if(it == mapLockedOutpoints.end()) return false;
     hashRet = it->second;
     return true;
@@ -577,8 +713,8 @@ bool CInstantSend::ResolveConflicts(const CTxLockCandidate& txLockCandidate)
         if(GetLockedOutPointTxHash(txin.prevout, hashConflicting) && txHash != hashConflicting) {
             // completed lock which conflicts with another completed one?
             // this means that majority of MNs in the quorum for this specific tx input are malicious!
-            std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
-            std::map<uint256, CTxLockCandidate>::iterator itLockCandidateConflicting = mapTxLockCandidates.find(hashConflicting);
+            txlockcandidate_m_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+            txlockcandidate_m_t::iterator itLockCandidateConflicting = mapTxLockCandidates.find(hashConflicting);
             if(itLockCandidate == mapTxLockCandidates.end() || itLockCandidateConflicting == mapTxLockCandidates.end()) {
                 // safety check, should never really happen
                 LogPrintf("CInstantSend::ResolveConflicts -- ERROR: Found conflicting completed Transaction Lock, but one of txLockCandidate-s is missing, txid=%s, conflicting txid=%s\n",
@@ -589,8 +725,8 @@ bool CInstantSend::ResolveConflicts(const CTxLockCandidate& txLockCandidate)
                     txHash.ToString(), hashConflicting.ToString());
             CTxLockRequest txLockRequest = itLockCandidate->second.txLockRequest;
             CTxLockRequest txLockRequestConflicting = itLockCandidateConflicting->second.txLockRequest;
-            itLockCandidate->second.SetConfirmedHeight(0); // expired
-            itLockCandidateConflicting->second.SetConfirmedHeight(0); // expired
+            SetTxLockCandidateConfirmedHeight(txHash, itLockCandidate->second, 0); // expired
+            SetTxLockCandidateConfirmedHeight(hashConflicting, itLockCandidateConflicting->second, 0); // expired
             CheckAndRemove(); // clean up
             // AlreadyHave should still return "true" for both of them
             mapLockRequestRejected.insert(make_pair(txHash, txLockRequest));
@@ -653,69 +789,55 @@ int64_t CInstantSend::GetAverageMasternodeOrphanVoteTime()
     return total / mapMasternodeOrphanVotes.size();
 }
 
-void CInstantSend::CheckAndRemove()
+void CInstantSend::CheckAndRemove(int nMaxItems)
 {
     if(!masternodeSync.IsMasternodeListSynced()) return;
 
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.begin();
-
-    // remove expired candidates
-    while(itLockCandidate != mapTxLockCandidates.end()) {
-        CTxLockCandidate &txLockCandidate = itLockCandidate->second;
-        uint256 txHash = txLockCandidate.GetHash();
-        if(txLockCandidate.IsExpired(nCachedBlockHeight)) {
-            LogPrintf("CInstantSend::CheckAndRemove -- Removing expired Transaction Lock Candidate: txid=%s\n", txHash.ToString());
-            std::map<COutPoint, COutPointLock>::iterator itOutpointLock = txLockCandidate.mapOutPointLocks.begin();
-            while(itOutpointLock != txLockCandidate.mapOutPointLocks.end()) {
-                mapLockedOutpoints.erase(itOutpointLock->first);
-                mapVotedOutpoints.erase(itOutpointLock->first);
-                ++itOutpointLock;
-            }
-            mapLockRequestAccepted.erase(txHash);
-            mapLockRequestRejected.erase(txHash);
-            mapTxLockCandidates.erase(itLockCandidate++);
-        } else {
-            ++itLockCandidate;
-        }
-    }
-
-    // remove expired votes
-    std::map<uint256, CTxLockVote>::iterator itVote = mapTxLockVotes.begin();
-    while(itVote != mapTxLockVotes.end()) {
-        if(itVote->second.IsExpired(nCachedBlockHeight)) {
-            LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing expired vote: txid=%s  masternode=%s\n",
-                    itVote->second.GetTxHash().ToString(), itVote->second.GetMasternodeOutpoint().ToStringShort());
-            mapTxLockVotes.erase(itVote++);
-        } else {
-            ++itVote;
-        }
+    int nKeepLock = Params().GetConsensus().nInstantSendKeepLock;
+    int64_t nNow = GetTime();
+    // expiry queue entries visited in this run, what is left over is picked up by the next one
+    int nVisited = 0;
+
+    // remove expired candidates together with their votes
+    while((nMaxItems <= 0 || nVisited++ < nMaxItems) && !mapTxLockCandidateHeights.empty() && nCachedBlockHeight - mapTxLockCandidateHeights.begin()->first > nKeepLock) {
+        uint256 txHash = mapTxLockCandidateHeights.begin()->second;
+        mapTxLockCandidateHeights.erase(mapTxLockCandidateHeights.begin());
+        txlockcandidate_m_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+        // already removed or confirmed at another height after a reorg
+        if(itLockCandidate == mapTxLockCandidates.end() || !itLockCandidate->second.IsExpired(nCachedBlockHeight)) continue;
+        LogPrintf("CInstantSend::CheckAndRemove -- Removing expired Transaction Lock Candidate: txid=%s\n", txHash.ToString());
+        RemoveTxLockCandidate(itLockCandidate);
     }
 
     // remove timed out orphan votes
-    std::map<uint256, CTxLockVote>::iterator itOrphanVote = mapTxLockVotesOrphan.begin();
-    while(itOrphanVote != mapTxLockVotesOrphan.end()) {
-        if(itOrphanVote->second.IsTimedOut()) {
-            LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing timed out orphan vote: txid=%s  masternode=%s\n",
-                    itOrphanVote->second.GetTxHash().ToString(), itOrphanVote->second.GetMasternodeOutpoint().ToStringShort());
-            mapTxLockVotes.erase(itOrphanVote->first);
-            mapTxLockVotesOrphan.erase(itOrphanVote++);
-        } else {
-            ++itOrphanVote;
-        }
+    while((nMaxItems <= 0 || nVisited++ < nMaxItems) && !dequeOrphanVoteTimes.empty() && nNow - dequeOrphanVoteTimes.front().first > INSTANTSEND_LOCK_TIMEOUT_SECONDS) {
+        uint256 nVoteHash = dequeOrphanVoteTimes.front().second;
+        dequeOrphanVoteTimes.pop_front();
+        txlockvote_m_t::iterator itVote = mapTxLockVotes.find(nVoteHash);
+        if(itVote == mapTxLockVotes.end()) continue;
+        hash_set_m_t::iterator itOrphan = mapTxLockVotesOrphan.find(itVote->second.GetTxHash());
+        if(itOrphan == mapTxLockVotesOrphan.end() || !itOrphan->second.count(nVoteHash)) continue;
+        LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing timed out orphan vote: txid=%s  masternode=%s\n",
+                itVote->second.GetTxHash().ToString(), itVote->second.GetMasternodeOutpoint().ToStringShort());
+        EraseTxLockVote(nVoteHash);
     }
 
-    // remove invalid votes and votes for failed lock attempts
-    itVote = mapTxLockVotes.begin();
-    while(itVote != mapTxLockVotes.end()) {
-        if(itVote->second.IsFailed()) {
-            LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing vote for failed lock attempt: txid=%s  masternode=%s\n",
-                    itVote->second.GetTxHash().ToString(), itVote->second.GetMasternodeOutpoint().ToStringShort());
-            mapTxLockVotes.erase(itVote++);
-        } else {
-            ++itVote;
+    // remove invalid votes and votes for failed lock attempts,
+    // votes of completed locks stay until their lock candidate expires
+    while((nMaxItems <= 0 || nVisited++ < nMaxItems) && !dequeTxLockVoteTimes.empty() && nNow - dequeTxLockVoteTimes.front().first > INSTANTSEND_FAILED_TIMEOUT_SECONDS) {
+        uint256 nVoteHash = dequeTxLockVoteTimes.front().second;
+        dequeTxLockVoteTimes.pop_front();
+        txlockvote_m_t::iterator itVote = mapTxLockVotes.find(nVoteHash);
+        if(itVote == mapTxLockVotes.end()) continue;
+        if(!itVote->second.IsFailed()) {
+            txlockcandidate_m_t::iterator itLockCandidate = mapTxLockCandidates.find(itVote->second.GetTxHash());
+            if(itLockCandidate != mapTxLockCandidates.end() && itLockCandidate->second.HasVote(itVote->second)) continue;
         }
+        LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing vote for failed lock attempt: txid=%s  masternode=%s\n",
+                itVote->second.GetTxHash().ToString(), itVote->second.GetMasternodeOutpoint().ToStringShort());
+        EraseTxLockVote(nVoteHash);
     }
 
     // remove timed out masternode orphan votes (DOS protection)
@@ -729,7 +851,59 @@ void CInstantSend::CheckAndRemove()
             ++itMasternodeOrphan;
         }
     }
-    LogPrintf("CInstantSend::CheckAndRemove -- %s\n", ToString());
+    LogPrint("instantsend", "CInstantSend::CheckAndRemove -- %s\n", ToString());
+}
+
+void CInstantSend::SetTxLockCandidateConfirmedHeight(const uint256& txHash, CTxLockCandidate& txLockCandidate, int nHeight)
+{
+    txLockCandidate.SetConfirmedHeight(nHeight);
+    // -1 means 0-confirmed or conflicted, such candidates do not expire
+    if(nHeight != -1) {
+        mapTxLockCandidateHeights.insert(std::make_pair(nHeight, txHash));
+    }
+}
+
+void CInstantSend::RemoveTxLockCandidate(txlockcandidate_m_t::iterator itLockCandidate)
+{
+    uint256 txHash = itLockCandidate->first;
+    const CTxLockCandidate& txLockCandidate = itLockCandidate->second;
+
+    std::map<COutPoint, COutPointLock>::const_iterator itOutpointLock = txLockCandidate.mapOutPointLocks.begin();
+    while(itOutpointLock != txLockCandidate.mapOutPointLocks.end()) {
+        mapLockedOutpoints.erase(itOutpointLock->first);
+        mapVotedOutpoints.erase(itOutpointLock->first);
+        BOOST_FOREACH(const uint256& nVoteHash, itOutpointLock->second.GetVoteHashes()) {
+            mapTxLockVotes.erase(nVoteHash);
+        }
+        ++itOutpointLock;
+    }
+
+    hash_set_m_t::iterator itOrphan = mapTxLockVotesOrphan.find(txHash);
+    if(itOrphan != mapTxLockVotesOrphan.end()) {
+        BOOST_FOREACH(const uint256& nVoteHash, itOrphan->second) {
+            mapTxLockVotes.erase(nVoteHash);
+        }
+        mapTxLockVotesOrphan.erase(itOrphan);
+    }
+
+    mapLockRequestAccepted.erase(txHash);
+    mapLockRequestRejected.erase(txHash);
+    mapTxLockCandidates.erase(itLockCandidate);
+}
+
+void CInstantSend::EraseTxLockVote(const uint256& nVoteHash)
+{
+    txlockvote_m_t::iterator itVote = mapTxLockVotes.find(nVoteHash);
+    if(itVote == mapTxLockVotes.end()) return;
+
+    hash_set_m_t::iterator itOrphan = mapTxLockVotesOrphan.find(itVote->second.GetTxHash());
+    if(itOrphan != mapTxLockVotesOrphan.end()) {
+        itOrphan->second.erase(nVoteHash);
+        if(itOrphan->second.empty()) {
+            mapTxLockVotesOrphan.erase(itOrphan);
+        }
+    }
+    mapTxLockVotes.erase(itVote);
 }
 
 bool CInstantSend::AlreadyHave(const uint256& hash)
@@ -744,6 +918,11 @@ void CInstantSend::AcceptLockRequest(const CTxLockRequest& txLockRequest)
 {
     LOCK(cs_instantsend);
     mapLockRequestAccepted.insert(make_pair(txLockRequest.GetHash(), txLockRequest));
+
+    txlockcandidate_m_t::iterator itLockCandidate = mapTxLockCandidates.find(txLockRequest.GetHash());
+    if(itLockCandidate != mapTxLockCandidates.end() && itLockCandidate->second.trace.nTimeAccepted == 0) {
+        itLockCandidate->second.trace.nTimeAccepted = GetTimeMicros();
+    }
 }
 
 void CInstantSend::RejectLockRequest(const CTxLockRequest& txLockRequest)
@@ -762,7 +941,7 @@ bool CInstantSend::GetTxLockRequest(const uint256& txHash, CTxLockRequest& txLoc
 {
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
+    txlockcandidate_m_t::iterator it = mapTxLockCandidates.find(txHash);
     if(it == mapTxLockCandidates.end()) return false;
     txLockRequestRet = it->second.txLockRequest;
 
@@ -773,7 +952,7 @@ bool CInstantSend::GetTxLockVote(const uint256& hash, CTxLockVote& txLockVoteRet
 {
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotes.find(hash);
+    txlockvote_m_t::iterator it = mapTxLockVotes.find(hash);
     if(it == mapTxLockVotes.end()) return false;
     txLockVoteRet = it->second;
 
@@ -788,7 +967,7 @@ bool CInstantSend::IsInstantSendReadyToLock(const uint256& txHash)
     LOCK(cs_instantsend);
     // There must be a successfully verified lock request
     // and all outputs must be locked (i.e. have enough signatures)
-    std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
+    txlockcandidate_m_t::iterator it = mapTxLockCandidates.find(txHash);
     return it != mapTxLockCandidates.end() && it->second.IsAllOutPointsReady();
 }
 
@@ -800,7 +979,7 @@ bool CInstantSend::IsLockedInstantSendTransaction(const uint256& txHash)
     LOCK(cs_instantsend);
 
     // there must be a lock candidate
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    txlockcandidate_m_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     if(itLockCandidate == mapTxLockCandidates.end()) return false;
 
     // which should have outpoints
@@ -825,7 +1004,7 @@ int CInstantSend::GetTransactionLockSignatures(const uint256& txHash)
 
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    txlockcandidate_m_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     if(itLockCandidate != mapTxLockCandidates.end()) {
         return itLockCandidate->second.CountVotes();
     }
@@ -844,7 +1023,7 @@ bool CInstantSend::IsTxLockCandidateTimedOut(const uint256& txHash)
 
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    txlockcandidate_m_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     if (itLockCandidate != mapTxLockCandidates.end()) {
         return !itLockCandidate->second.IsAllOutPointsReady() &&
                 itLockCandidate->second.IsTimedOut();
@@ -857,7 +1036,7 @@ void CInstantSend::Relay(const uint256& txHash, CConnman& connman)
 {
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::const_iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    txlockcandidate_m_t::const_iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     if (itLockCandidate != mapTxLockCandidates.end()) {
         itLockCandidate->second.Relay(connman);
     }
@@ -896,48 +1075,153 @@ void CInstantSend::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
     LogPrint("instantsend", "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d\n", txHash.ToString(), nHeightNew);
 
     // Check lock candidates
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    txlockcandidate_m_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     if(itLockCandidate != mapTxLockCandidates.end()) {
         LogPrint("instantsend", "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d lock candidate updated\n",
                 txHash.ToString(), nHeightNew);
-        itLockCandidate->second.SetConfirmedHeight(nHeightNew);
+        SetTxLockCandidateConfirmedHeight(txHash, itLockCandidate->second, nHeightNew);
         // Loop through outpoint locks
         std::map<COutPoint, COutPointLock>::iterator itOutpointLock = itLockCandidate->second.mapOutPointLocks.begin();
         while(itOutpointLock != itLockCandidate->second.mapOutPointLocks.end()) {
             // Check corresponding lock votes
-            std::vector<CTxLockVote> vVotes = itOutpointLock->second.GetVotes();
-            std::vector<CTxLockVote>::iterator itVote = vVotes.begin();
-            std::map<uint256, CTxLockVote>::iterator it;
-            while(itVote != vVotes.end()) {
-                uint256 nVoteHash = itVote->GetHash();
+            BOOST_FOREACH(const uint256& nVoteHash, itOutpointLock->second.GetVoteHashes()) {
                 LogPrint("instantsend", "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d vote %s updated\n",
                         txHash.ToString(), nHeightNew, nVoteHash.ToString());
-                it = mapTxLockVotes.find(nVoteHash);
-                if(it != mapTxLockVotes.end()) {
-                    it->second.SetConfirmedHeight(nHeightNew);
+                txlockvote_m_t::iterator itVote = mapTxLockVotes.find(nVoteHash);
+                if(itVote != mapTxLockVotes.end()) {
+                    itVote->second.SetConfirmedHeight(nHeightNew);
                 }
-                ++itVote;
             }
             ++itOutpointLock;
         }
     }
 
     // check orphan votes
-    std::map<uint256, CTxLockVote>::iterator itOrphanVote = mapTxLockVotesOrphan.begin();
-    while(itOrphanVote != mapTxLockVotesOrphan.end()) {
-        if(itOrphanVote->second.GetTxHash() == txHash) {
+    hash_set_m_t::iterator itOrphan = mapTxLockVotesOrphan.find(txHash);
+    if(itOrphan != mapTxLockVotesOrphan.end()) {
+        BOOST_FOREACH(const uint256& nVoteHash, itOrphan->second) {
             LogPrint("instantsend", "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d vote %s updated\n",
-                    txHash.ToString(), nHeightNew, itOrphanVote->first.ToString());
-            mapTxLockVotes[itOrphanVote->first].SetConfirmedHeight(nHeightNew);
+                    txHash.ToString(), nHeightNew, nVoteHash.ToString());
+            txlockvote_m_t::iterator itVote = mapTxLockVotes.find(nVoteHash);
+            if(itVote != mapTxLockVotes.end()) {
+                itVote->second.SetConfirmedHeight(nHeightNew);
+            }
         }
-        ++itOrphanVote;
     }
 }
 
+void CInstantSend::AddTraceTime(int nStage, int64_t nMicros)
+{
+    if(nStage < 0 || nStage >= INSTANTSEND_TRACE_MAX) return;
+    LOCK(cs_trace);
+    histTrace[nStage].Add(nMicros);
+}
+
+std::vector<CLatencyHistogram> CInstantSend::GetTraceHistograms()
+{
+    LOCK(cs_trace);
+    return std::vector<CLatencyHistogram>(histTrace, histTrace + INSTANTSEND_TRACE_MAX);
+}
+
+bool CInstantSend::GetTxLockTrace(const uint256& txHash, CTxLockTrace& traceRet)
+{
+    LOCK(cs_instantsend);
+
+    txlockcandidate_m_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    if(itLockCandidate == mapTxLockCandidates.end()) return false;
+    traceRet = itLockCandidate->second.trace;
+
+    return true;
+}
+
 std::string CInstantSend::ToString()
 {
     LOCK(cs_instantsend);
-    return strprintf("Lock Candidates: %llu, Votes %llu", mapTxLockCandidates.size(), mapTxLockVotes.size());
+    return strprintf("Lock Candidates: %llu, Votes %llu, Orphan vote txes %llu", mapTxLockCandidates.size(), mapTxLockVotes.size(), mapTxLockVotesOrphan.size());
+}
+
+std::string GetInstantSendTraceStageName(int nStage)
+{
+    switch(nStage) {
+        case INSTANTSEND_TRACE_MEMPOOL:     return "mempool";
+        case INSTANTSEND_TRACE_RANK:        return "rank";
+        case INSTANTSEND_TRACE_SIGNATURE:   return "signature";
+        case INSTANTSEND_TRACE_RELAY:       return "relay";
+        case INSTANTSEND_TRACE_FINALIZE:    return "finalize";
+        case INSTANTSEND_TRACE_FIRST_VOTE:  return "firstvote";
+        case INSTANTSEND_TRACE_READY:       return "ready";
+        case INSTANTSEND_TRACE_LOCK:        return "lock";
+        default:                            return "unknown";
+    }
+}
+
+//
+// CLatencyHistogram
+//
+
+void CLatencyHistogram::Clear()
+{
+    memset(anCounts, 0, sizeof(anCounts));
+    nCount = 0;
+    nTotal = 0;
+    nMax = 0;
+}
+
+int CLatencyHistogram::GetBucket(int64_t nMicros)
+{
+    if(nMicros < 4) return std::max(int64_t(0), nMicros);
+
+    // position of the highest bit, then the two bits below it pick one of 4 sub-buckets
+    int nBits = 0;
+    while((nMicros >> (nBits + 1)) != 0) ++nBits;
+    int nBucket = 4 * (nBits - 1) + ((nMicros >> (nBits - 2)) & 3);
+    return std::min(nBucket, BUCKETS - 1);
+}
+
+int64_t CLatencyHistogram::GetBucketUpperBound(int nBucket)
+{
+    if(nBucket < 4) return nBucket;
+    int nBits = nBucket / 4 + 1;
+    return (int64_t(5 + nBucket % 4) << (nBits - 2)) - 1;
+}
+
+void CLatencyHistogram::Add(int64_t nMicros)
+{
+    nMicros = std::max(int64_t(0), nMicros);
+    anCounts[GetBucket(nMicros)]++;
+    nCount++;
+    nTotal += nMicros;
+    nMax = std::max(nMax, nMicros);
+}
+
+int64_t CLatencyHistogram::GetPercentile(double dPercentile) const
+{
+    if(nCount == 0) return 0;
+
+    int64_t nRank = std::max(int64_t(1), int64_t(nCount * dPercentile / 100.0 + 0.5));
+    int64_t nSeen = 0;
+    for(int i = 0; i < BUCKETS; ++i) {
+        nSeen += anCounts[i];
+        if(nSeen >= nRank) {
+            return std::min(GetBucketUpperBound(i), nMax);
+        }
+    }
+    return nMax;
+}
+
+//
+// CTxLockTrace
+//
+
+std::string CTxLockTrace::ToString() const
+{
+    // stages relative to the lock request, -1 if the stage was not reached
+    int64_t nStart = nTimeRequest;
+    return strprintf("CTxLockTrace(txid=%s, accepted=%dus, firstvote=%dus, ready=%dus, locked=%dus)", txHash.ToString(),
+            (nStart && nTimeAccepted) ? nTimeAccepted - nStart : -1,
+            (nStart && nTimeFirstVote) ? nTimeFirstVote - nStart : -1,
+            (nStart && nTimeReady) ? nTimeReady - nStart : -1,
+            (nStart && nTimeLocked) ? nTimeLocked - nStart : -1);
 }
 
 //
@@ -1030,7 +1314,10 @@ bool CTxLockVote::IsValid(CNode* pnode, CConnman& connman) const
 
     // ZIXX Team: check to see if there's need to update an older voting entity
     int nRank;
-    if(!mnodeman.GetMasternodeRank(outpointMasternode, nRank, nLockInputHeight, MIN_INSTANTSEND_PROTO_VERSION)) {
+    int64_t nTimeStart = GetTimeMicros();
+    bool fRank = mnodeman.GetMasternodeRank(outpointMasternode, nRank, nLockInputHeight, MIN_INSTANTSEND_PROTO_VERSION);
+    instantsend.AddTraceTime(INSTANTSEND_TRACE_RANK, GetTimeMicros() - nTimeStart);
+    if(!fRank) {
         //can be caused by past versions trying to vote with an invalid protocol
         LogPrint("instantsend", "CTxLockVote::IsValid -- Can't calculate rank for masternode %s\n", outpointMasternode.ToStringShort());
         return false;
@@ -1044,7 +1331,10 @@ bool CTxLockVote::IsValid(CNode* pnode, CConnman& connman) const
         return false;
     }
 
-    if(!CheckSignature()) {
+    nTimeStart = GetTimeMicros();
+    bool fSignature = CheckSignature();
+    instantsend.AddTraceTime(INSTANTSEND_TRACE_SIGNATURE, GetTimeMicros() - nTimeStart);
+    if(!fSignature) {
         LogPrintf("CTxLockVote::IsValid -- Signature invalid\n");
         return false;
     }
@@ -1129,14 +1419,14 @@ bool COutPointLock::AddVote(const CTxLockVote& vote)
 {
     if(mapMasternodeVotes.count(vote.GetMasternodeOutpoint()))
         return false;
-    mapMasternodeVotes.insert(std::make_pair(vote.GetMasternodeOutpoint(), vote));
+    mapMasternodeVotes.insert(std::make_pair(vote.GetMasternodeOutpoint(), vote.GetHash()));
     return true;
 }
 
-std::vector<CTxLockVote> COutPointLock::GetVotes() const
+std::vector<uint256> COutPointLock::GetVoteHashes() const
 {
-    std::vector<CTxLockVote> vRet;
-    std::map<COutPoint, CTxLockVote>::const_iterator itVote = mapMasternodeVotes.begin();
+    std::vector<uint256> vRet;
+    std::map<COutPoint, uint256>::const_iterator itVote = mapMasternodeVotes.begin();
     while(itVote != mapMasternodeVotes.end()) {
         vRet.push_back(itVote->second);
         ++itVote;
@@ -1144,6 +1434,12 @@ std::vector<CTxLockVote> COutPointLock::GetVotes() const
     return vRet;
 }
 
+bool COutPointLock::HasVote(const CTxLockVote& vote) const
+{
+    std::map<COutPoint, uint256>::const_iterator itVote = mapMasternodeVotes.find(vote.GetMasternodeOutpoint());
+    return itVote != mapMasternodeVotes.end() && itVote->second == vote.GetHash();
+}
+
 bool COutPointLock::HasMasternodeVoted(const COutPoint& outpointMasternodeIn) const
 {
     return mapMasternodeVotes.count(outpointMasternodeIn);
@@ -1151,9 +1447,10 @@ bool COutPointLock::HasMasternodeVoted(const COutPoint& outpointMasternodeIn) co
 
 void COutPointLock::Relay(CConnman& connman) const
 {
-    std::map<COutPoint, CTxLockVote>::const_iterator itVote = mapMasternodeVotes.begin();
+    std::map<COutPoint, uint256>::const_iterator itVote = mapMasternodeVotes.begin();
     while(itVote != mapMasternodeVotes.end()) {
-        itVote->second.Relay(connman);
+        CInv inv(MSG_TXLOCK_VOTE, itVote->second);
+        connman.RelayInv(inv);
         ++itVote;
     }
 }
@@ -1178,7 +1475,11 @@ bool CTxLockCandidate::AddVote(const CTxLockVote& vote)
 {
     std::map<COutPoint, COutPointLock>::iterator it = mapOutPointLocks.find(vote.GetOutpoint());
     if(it == mapOutPointLocks.end()) return false;
-    return it->second.AddVote(vote);
+    if(!it->second.AddVote(vote)) return false;
+    if(trace.nTimeFirstVote == 0) {
+        trace.nTimeFirstVote = GetTimeMicros();
+    }
+    return true;
 }
 
 bool CTxLockCandidate::IsAllOutPointsReady() const
@@ -1193,6 +1494,12 @@ bool CTxLockCandidate::IsAllOutPointsReady() const
     return true;
 }
 
+bool CTxLockCandidate::HasVote(const CTxLockVote& vote) const
+{
+    std::map<COutPoint, COutPointLock>::const_iterator it = mapOutPointLocks.find(vote.GetOutpoint());
+    return it != mapOutPointLocks.end() && it->second.HasVote(vote);
+}
+
 bool CTxLockCandidate::HasMasternodeVoted(const COutPoint& outpointIn, const COutPoint& outpointMasternodeIn)
 {
     std::map<COutPoint, COutPointLock>::iterator it = mapOutPointLocks.find(outpointIn);
@@ -1231,3 +1538,17 @@ void CTxLockCandidate::Relay(CConnman& connman) const
         ++itOutpointLock;
     }
 }
+
+void ThreadInstantSendVotes(CConnman& connman)
+{
+    if(fLiteMode) return; // disable all Zixx specific functionality
+
+    // Make this thread recognisable as the InstantSend vote processing thread
+    RenameThread("zixx-is-votes");
+
+    while (true)
+    {
+        // blocks until there are votes to process, interrupted on shutdown
+        instantsend.ProcessTxLockVoteQueue(connman);
+    }
+}
@@ -8,11 +8,17 @@
 #include "chain.h"
 #include "net.h"
 #include "primitives/transaction.h"
+#include "sync.h"
+#include "txmempool.h"
+
+#include <deque>
+#include <unordered_map>
 
 class CTxLockVote;
 class COutPointLock;
 class CTxLockRequest;
 class CTxLockCandidate;
+class CTxLockTrace;
 class CInstantSend;
 
 extern CInstantSend instantsend;
@@ -38,43 +44,158 @@ static const int INSTANTSEND_LOCK_TIMEOUT_SECONDS   = 15;
 // For how long we are going to keep invalid votes and votes for failed lock attempts,
 // must be greater than INSTANTSEND_LOCK_TIMEOUT_SECONDS
 static const int INSTANTSEND_FAILED_TIMEOUT_SECONDS = 60;
+// How many lock votes can wait for validation, votes over this limit are dropped
+static const size_t INSTANTSEND_VOTE_QUEUE_MAX      = 10000;
+// How many validated lock votes are applied under a single cs_main lock
+static const size_t INSTANTSEND_VOTE_BATCH_SIZE     = 100;
+// How many expiry queue entries CheckAndRemove visits per scheduled run
+static const int INSTANTSEND_CLEANUP_SLICE_SIZE     = 10000;
 
 extern bool fEnableInstantSend;
 extern int nInstantSendDepth;
 extern int nCompleteTXLocks;
 
+/** Stages of InstantSend processing we collect timings for */
+enum instantsend_trace_stage_t {
+    INSTANTSEND_TRACE_MEMPOOL = 0,  // AcceptToMemoryPool of a lock request
+    INSTANTSEND_TRACE_RANK,         // masternode rank lookup for a vote
+    INSTANTSEND_TRACE_SIGNATURE,    // signature check of a vote
+    INSTANTSEND_TRACE_RELAY,        // relaying a valid vote
+    INSTANTSEND_TRACE_FINALIZE,     // conflict resolution and locking of inputs
+    INSTANTSEND_TRACE_FIRST_VOTE,   // lock request received -> first vote applied
+    INSTANTSEND_TRACE_READY,        // lock request received -> enough votes for all inputs
+    INSTANTSEND_TRACE_LOCK,         // lock request received -> transaction locked
+    INSTANTSEND_TRACE_MAX
+};
+
+std::string GetInstantSendTraceStageName(int nStage);
+
+/**
+ * Log-linear histogram of durations in microseconds: every power of two
+ * is split into 4 buckets, so percentiles are off by 25% at most.
+ */
+class CLatencyHistogram
+{
+public:
+    static const int BUCKETS = 128;
+
+private:
+    int64_t anCounts[BUCKETS];
+    int64_t nCount;
+    int64_t nTotal;
+    int64_t nMax;
+
+    static int GetBucket(int64_t nMicros);
+    static int64_t GetBucketUpperBound(int nBucket);
+
+public:
+    CLatencyHistogram() { Clear(); }
+
+    void Clear();
+    void Add(int64_t nMicros);
+
+    int64_t GetCount() const { return nCount; }
+    int64_t GetTotal() const { return nTotal; }
+    int64_t GetMax() const { return nMax; }
+    // upper bound of the bucket the given percentile (0-100) falls into
+    int64_t GetPercentile(double dPercentile) const;
+};
+
+/** Counters of the lock vote processing thread */
+struct CInstantSendVoteStats
+{
+    int64_t nVotesQueued;
+    int64_t nVotesDropped;
+    int64_t nVotesInvalid;
+    int64_t nVotesProcessed;
+    size_t nQueueSize;
+    size_t nQueueSizeMax;
+    int64_t nBatches;
+    // time spent holding cs_main while applying validated votes
+    int64_t nMainLockMicrosTotal;
+    int64_t nMainLockMicrosMax;
+    // time from the first vote or lock request seen to the lock completion
+    int64_t nLocksCompleted;
+    int64_t nLockLatencyMicrosTotal;
+    int64_t nLockLatencyMicrosMax;
+
+    CInstantSendVoteStats() :
+        nVotesQueued(0),
+        nVotesDropped(0),
+        nVotesInvalid(0),
+        nVotesProcessed(0),
+        nQueueSize(0),
+        nQueueSizeMax(0),
+        nBatches(0),
+        nMainLockMicrosTotal(0),
+        nMainLockMicrosMax(0),
+        nLocksCompleted(0),
+        nLockLatencyMicrosTotal(0),
+        nLockLatencyMicrosMax(0)
+        {}
+};
+
 class CInstantSend
 {
+public: // Types
+    typedef std::unordered_map<uint256, CTxLockRequest, SaltedTxidHasher> txlockrequest_m_t;
+    typedef std::unordered_map<uint256, CTxLockVote, SaltedTxidHasher> txlockvote_m_t;
+    typedef std::unordered_map<uint256, std::set<uint256>, SaltedTxidHasher> hash_set_m_t;
+    typedef std::unordered_map<uint256, CTxLockCandidate, SaltedTxidHasher> txlockcandidate_m_t;
+    typedef std::unordered_map<COutPoint, std::set<uint256>, SaltedOutpointHasher> outpoint_hash_set_m_t;
+    typedef std::unordered_map<COutPoint, uint256, SaltedOutpointHasher> outpoint_hash_m_t;
+
 private:
     // Keep track of current block height
     int nCachedBlockHeight;
 
     // maps for AlreadyHave
-    std::map<uint256, CTxLockRequest> mapLockRequestAccepted; // tx hash - tx
-    std::map<uint256, CTxLockRequest> mapLockRequestRejected; // tx hash - tx
-    std::map<uint256, CTxLockVote> mapTxLockVotes; // vote hash - vote
-    std::map<uint256, CTxLockVote> mapTxLockVotesOrphan; // vote hash - vote
+    txlockrequest_m_t mapLockRequestAccepted; // tx hash - tx
+    txlockrequest_m_t mapLockRequestRejected; // tx hash - tx
+    // the only place votes are stored, everything else refers to them by hash
+    txlockvote_m_t mapTxLockVotes; // vote hash - vote
+    hash_set_m_t mapTxLockVotesOrphan; // tx hash - orphan vote hashes
+
+    txlockcandidate_m_t mapTxLockCandidates; // tx hash - lock candidate
 
-    std::map<uint256, CTxLockCandidate> mapTxLockCandidates; // tx hash - lock candidate
+    outpoint_hash_set_m_t mapVotedOutpoints; // utxo - tx hash set
+    outpoint_hash_m_t mapLockedOutpoints; // utxo - tx hash
 
-    std::map<COutPoint, std::set<uint256> > mapVotedOutpoints; // utxo - tx hash set
-    std::map<COutPoint, uint256> mapLockedOutpoints; // utxo - tx hash
+    // Expiry indexes for CheckAndRemove, so that it only visits what is due.
+    // Entries are not removed when the indexed object goes away or changes,
+    // the object is looked up and checked again instead.
+    std::deque<std::pair<int64_t, uint256> > dequeTxLockVoteTimes; // time received - vote hash
+    std::deque<std::pair<int64_t, uint256> > dequeOrphanVoteTimes; // time received - vote hash
+    std::multimap<int, uint256> mapTxLockCandidateHeights; // confirmed height - tx hash
 
     //track masternodes who voted with no txreq (for DOS protection)
     std::map<COutPoint, int64_t> mapMasternodeOrphanVotes; // mn outpoint - time
 
+    // votes waiting for ThreadInstantSendVotes, cs_votequeue also protects voteStats
+    CWaitableCriticalSection cs_votequeue;
+    CConditionVariable condVoteQueue;
+    std::deque<std::pair<NodeId, CTxLockVote> > queueTxLockVotes; // peer id - vote
+    CInstantSendVoteStats voteStats;
+
+    CCriticalSection cs_trace;
+    CLatencyHistogram histTrace[INSTANTSEND_TRACE_MAX];
+
     bool CreateTxLockCandidate(const CTxLockRequest& txLockRequest);
     void CreateEmptyTxLockCandidate(const uint256& txHash);
+    void SetTxLockCandidateConfirmedHeight(const uint256& txHash, CTxLockCandidate& txLockCandidate, int nHeight);
+    void RemoveTxLockCandidate(txlockcandidate_m_t::iterator itLockCandidate);
+    void EraseTxLockVote(const uint256& nVoteHash);
     void Vote(CTxLockCandidate& txLockCandidate, CConnman& connman);
 
-    //process consensus vote message
-    bool ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote, CConnman& connman);
+    bool QueueTxLockVote(NodeId nodeId, const CTxLockVote& vote);
+    //process consensus vote message, the vote must be already validated
+    bool ProcessTxLockVote(CTxLockVote& vote, CConnman& connman);
     void ProcessOrphanTxLockVotes(CConnman& connman);
     bool IsEnoughOrphanVotesForTx(const CTxLockRequest& txLockRequest);
     bool IsEnoughOrphanVotesForTxAndOutPoint(const uint256& txHash, const COutPoint& outpoint);
     int64_t GetAverageMasternodeOrphanVoteTime();
 
-    void TryToFinalizeLockCandidate(const CTxLockCandidate& txLockCandidate);
+    void TryToFinalizeLockCandidate(CTxLockCandidate& txLockCandidate);
     void LockTransactionInputs(const CTxLockCandidate& txLockCandidate);
     //update UI and notify external script if any
     void UpdateLockedTransaction(const CTxLockCandidate& txLockCandidate);
@@ -90,6 +211,14 @@ public:
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv, CConnman& connman);
 
     bool ProcessTxLockRequest(const CTxLockRequest& txLockRequest, CConnman& connman);
+
+    // wait for queued votes, validate a batch of them and apply the valid ones
+    void ProcessTxLockVoteQueue(CConnman& connman);
+    CInstantSendVoteStats GetVoteStats();
+
+    void AddTraceTime(int nStage, int64_t nMicros);
+    std::vector<CLatencyHistogram> GetTraceHistograms();
+    bool GetTxLockTrace(const uint256& txHash, CTxLockTrace& traceRet);
     void Vote(const uint256& txHash, CConnman& connman);
 
     bool AlreadyHave(const uint256& hash);
@@ -111,7 +240,7 @@ public:
     int GetConfirmations(const uint256 &nTXHash);
 
     // remove expired entries from maps
-    void CheckAndRemove();
+    void CheckAndRemove(int nMaxItems = 0);
     // verify if transaction lock timed out
     bool IsTxLockCandidateTimedOut(const uint256& txHash);
 
@@ -206,7 +335,7 @@ class COutPointLock
 {
 private:
     COutPoint outpoint; // utxo
-    std::map<COutPoint, CTxLockVote> mapMasternodeVotes; // masternode outpoint - vote
+    std::map<COutPoint, uint256> mapMasternodeVotes; // masternode outpoint - vote hash
     bool fAttacked = false;
 
 public:
@@ -221,7 +350,8 @@ public:
     COutPoint GetOutpoint() const { return outpoint; }
 
     bool AddVote(const CTxLockVote& vote);
-    std::vector<CTxLockVote> GetVotes() const;
+    std::vector<uint256> GetVoteHashes() const;
+    bool HasVote(const CTxLockVote& vote) const;
     bool HasMasternodeVoted(const COutPoint& outpointMasternodeIn) const;
     int CountVotes() const { return fAttacked ? 0 : mapMasternodeVotes.size(); }
     bool IsReady() const { return !fAttacked && CountVotes() >= SIGNATURES_REQUIRED; }
@@ -230,22 +360,63 @@ public:
     void Relay(CConnman& connman) const;
 };
 
+/**
+ * Times (GetTimeMicros) a transaction lock reached each stage at,
+ * 0 for stages it did not reach (yet)
+ */
+class CTxLockTrace
+{
+public:
+    uint256 txHash;
+    int64_t nTimeRequest;   // lock request received
+    int64_t nTimeAccepted;  // lock request accepted to mempool
+    int64_t nTimeFirstVote; // first vote applied
+    int64_t nTimeReady;     // enough votes for all inputs
+    int64_t nTimeLocked;    // inputs locked
+
+    CTxLockTrace() :
+        txHash(),
+        nTimeRequest(0),
+        nTimeAccepted(0),
+        nTimeFirstVote(0),
+        nTimeReady(0),
+        nTimeLocked(0)
+        {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(txHash);
+        READWRITE(nTimeRequest);
+        READWRITE(nTimeAccepted);
+        READWRITE(nTimeFirstVote);
+        READWRITE(nTimeReady);
+        READWRITE(nTimeLocked);
+    }
+
+    std::string ToString() const;
+};
+
 class CTxLockCandidate
 {
 private:
     int nConfirmedHeight; // when corresponding tx is 0-confirmed or conflicted, nConfirmedHeight is -1
     int64_t nTimeCreated;
+    int64_t nTimeCreatedMicros;
 
 public:
     CTxLockCandidate(const CTxLockRequest& txLockRequestIn) :
         nConfirmedHeight(-1),
         nTimeCreated(GetTime()),
+        nTimeCreatedMicros(GetTimeMicros()),
         txLockRequest(txLockRequestIn),
         mapOutPointLocks()
         {}
 
     CTxLockRequest txLockRequest;
     std::map<COutPoint, COutPointLock> mapOutPointLocks;
+    CTxLockTrace trace;
 
     uint256 GetHash() const { return txLockRequest.GetHash(); }
 
@@ -254,14 +425,18 @@ public:
     bool AddVote(const CTxLockVote& vote);
     bool IsAllOutPointsReady() const;
 
+    bool HasVote(const CTxLockVote& vote) const;
     bool HasMasternodeVoted(const COutPoint& outpointIn, const COutPoint& outpointMasternodeIn);
     int CountVotes() const;
 
     void SetConfirmedHeight(int nConfirmedHeightIn) { nConfirmedHeight = nConfirmedHeightIn; }
     bool IsExpired(int nHeight) const;
     bool IsTimedOut() const;
+    int64_t GetTimeCreatedMicros() const { return nTimeCreatedMicros; }
 
     void Relay(CConnman& connman) const;
 };
 
+void ThreadInstantSendVotes(CConnman& connman);
+
 #endif
@@ -0,0 +1,154 @@
+// Copyright (c) 2018-2018 The Zixx developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "maintenance.h"
+
+#include "activemasternode.h"
+#include "governance.h"
+#include "init.h"
+#include "instantx.h"
+#include "masternode-payments.h"
+#include "masternode-sync.h"
+#include "masternodeman.h"
+#include "random.h"
+#include "scheduler.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <boost/bind.hpp>
+
+CMaintenanceScheduler maintenanceScheduler;
+
+void CMaintenanceScheduler::Schedule(CScheduler& scheduler, const std::string& strName, Function func, int64_t nFirstDelay, int64_t nInterval, int64_t nJitter)
+{
+    size_t nTask;
+    {
+        LOCK(cs);
+        CTask task;
+        task.func = func;
+        task.nJitter = nJitter;
+        task.stats.strName = strName;
+        task.stats.nInterval = nInterval;
+        vecTasks.push_back(task);
+        nTask = vecTasks.size() - 1;
+    }
+    scheduler.scheduleFromNow(boost::bind(&CMaintenanceScheduler::Run, this, boost::ref(scheduler), nTask), nFirstDelay);
+}
+
+void CMaintenanceScheduler::Run(CScheduler& scheduler, size_t nTask)
+{
+    if(ShutdownRequested()) return;
+
+    Function func;
+    {
+        LOCK(cs);
+        func = vecTasks[nTask].func;
+    }
+
+    int64_t nTimeStart = GetTimeMicros();
+    func();
+    int64_t nMicros = GetTimeMicros() - nTimeStart;
+
+    int64_t nDelay;
+    {
+        LOCK(cs);
+        CTask& task = vecTasks[nTask];
+        task.stats.nRuns++;
+        task.stats.nTotalMicros += nMicros;
+        task.stats.nMaxMicros = std::max(task.stats.nMaxMicros, nMicros);
+        task.stats.nLastMicros = nMicros;
+        task.stats.nTimeLastRun = GetTime();
+        nDelay = task.stats.nInterval + (task.nJitter > 0 ? GetRand(task.nJitter + 1) : 0);
+        LogPrint("bench", "CMaintenanceScheduler::Run -- %s: %.2fms\n", task.stats.strName, nMicros * 0.001);
+    }
+
+    scheduler.scheduleFromNow(boost::bind(&CMaintenanceScheduler::Run, this, boost::ref(scheduler), nTask), nDelay);
+}
+
+std::vector<CMaintenanceTaskStats> CMaintenanceScheduler::GetStats() const
+{
+    LOCK(cs);
+    std::vector<CMaintenanceTaskStats> vecStats;
+    vecStats.reserve(vecTasks.size());
+    for (const auto& task : vecTasks) {
+        vecStats.push_back(task.stats);
+    }
+    return vecStats;
+}
+
+static void ProcessMasternodeSync(CConnman& connman)
+{
+    // try to sync from all available nodes, one step at a time
+    masternodeSync.ProcessTick(connman);
+}
+
+static void CheckMasternodes()
+{
+    if(!masternodeSync.IsBlockchainSynced()) return;
+    mnodeman.Check();
+}
+
+static void ManageActiveMasternode(CConnman& connman)
+{
+    if(!masternodeSync.IsBlockchainSynced()) return;
+    activeMasternode.ManageState(connman);
+}
+
+static void ProcessMasternodeConnections(CConnman& connman)
+{
+    if(!masternodeSync.IsBlockchainSynced()) return;
+    mnodeman.ProcessMasternodeConnections(connman);
+}
+
+static void CleanupMasternodes(CConnman& connman)
+{
+    if(!masternodeSync.IsBlockchainSynced()) return;
+    mnodeman.CheckAndRemove(connman, MNODEMAN_CLEANUP_SLICE_SIZE);
+}
+
+static void CleanupMasternodePayments()
+{
+    if(!masternodeSync.IsBlockchainSynced()) return;
+    mnpayments.CheckAndRemove(MNPAYMENTS_CLEANUP_SLICE_SIZE);
+}
+
+static void CleanupInstantSend()
+{
+    if(!masternodeSync.IsBlockchainSynced()) return;
+    instantsend.CheckAndRemove(INSTANTSEND_CLEANUP_SLICE_SIZE);
+}
+
+static void VerifyMasternodes(CConnman& connman)
+{
+    if(!masternodeSync.IsBlockchainSynced()) return;
+    mnodeman.DoFullVerificationStep(connman);
+}
+
+static void MaintainGovernance(CConnman& connman)
+{
+    if(!masternodeSync.IsBlockchainSynced()) return;
+    governance.DoMaintenance(connman);
+}
+
+void ScheduleMasternodeMaintenance(CScheduler& scheduler, CConnman& connman)
+{
+    if(fLiteMode) return; // disable all Zixx specific functionality
+
+    maintenanceScheduler.Schedule(scheduler, "mnsync", boost::bind(&ProcessMasternodeSync, boost::ref(connman)), 1, 1);
+    // make sure to check all masternodes before the rest of the tasks look at them
+    maintenanceScheduler.Schedule(scheduler, "mncheck", &CheckMasternodes, 1, 1);
+    // check if we should activate or ping every few minutes,
+    // slightly postpone first run to give net thread a chance to connect to some peers
+    maintenanceScheduler.Schedule(scheduler, "mnstate", boost::bind(&ManageActiveMasternode, boost::ref(connman)), 15, MASTERNODE_MIN_MNP_SECONDS);
+    maintenanceScheduler.Schedule(scheduler, "mnconnections", boost::bind(&ProcessMasternodeConnections, boost::ref(connman)), 60, 60, 10);
+    // masternodes, payment votes and instantsend entries are cleaned up in slices,
+    // run often enough to sweep all of them about once a minute
+    maintenanceScheduler.Schedule(scheduler, "mncleanup", boost::bind(&CleanupMasternodes, boost::ref(connman)), 60, 10, 5);
+    maintenanceScheduler.Schedule(scheduler, "mnpaymentscleanup", &CleanupMasternodePayments, 60, 10, 5);
+    maintenanceScheduler.Schedule(scheduler, "instantsendcleanup", &CleanupInstantSend, 60, 10, 5);
+    if(fMasterNode) {
+        maintenanceScheduler.Schedule(scheduler, "mnverify", boost::bind(&VerifyMasternodes, boost::ref(connman)), 5 * 60, 5 * 60, 30);
+    }
+    maintenanceScheduler.Schedule(scheduler, "governance", boost::bind(&MaintainGovernance, boost::ref(connman)), 5 * 60, 5 * 60, 30);
+}
@@ -0,0 +1,71 @@
+// Copyright (c) 2018-2018 The Zixx developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_MAINTENANCE_H
+#define BITCOIN_MAINTENANCE_H
+
+#include "sync.h"
+
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+
+class CConnman;
+class CMaintenanceScheduler;
+class CScheduler;
+
+extern CMaintenanceScheduler maintenanceScheduler;
+
+/** Runtime statistics of a single periodic maintenance task */
+struct CMaintenanceTaskStats
+{
+    std::string strName;
+    int64_t nInterval;
+    int64_t nRuns;
+    int64_t nTotalMicros;
+    int64_t nMaxMicros;
+    int64_t nLastMicros;
+    int64_t nTimeLastRun;
+
+    CMaintenanceTaskStats() : nInterval(0), nRuns(0), nTotalMicros(0), nMaxMicros(0), nLastMicros(0), nTimeLastRun(0) {}
+};
+
+/**
+ * Runs periodic masternode, governance and InstantSend maintenance as independent tasks
+ * on the shared CScheduler thread. Every task is rescheduled with a random jitter after
+ * it finishes so that tasks with the same interval drift apart instead of running back to back.
+ */
+class CMaintenanceScheduler
+{
+public:
+    typedef boost::function<void(void)> Function;
+
+private:
+    struct CTask
+    {
+        Function func;
+        int64_t nJitter;
+        CMaintenanceTaskStats stats;
+    };
+
+    mutable CCriticalSection cs;
+    std::vector<CTask> vecTasks;
+
+    void Run(CScheduler& scheduler, size_t nTask);
+
+public:
+    /**
+     * Run func on scheduler every nInterval seconds plus a random delay of up to nJitter seconds,
+     * the first run happens nFirstDelay seconds from now.
+     */
+    void Schedule(CScheduler& scheduler, const std::string& strName, Function func, int64_t nFirstDelay, int64_t nInterval, int64_t nJitter = 0);
+
+    std::vector<CMaintenanceTaskStats> GetStats() const;
+};
+
+/** Schedule the Zixx specific maintenance that used to run in the PrivateSend thread */
+void ScheduleMasternodeMaintenance(CScheduler& scheduler, CConnman& connman);
+
+#endif // BITCOIN_MAINTENANCE_H
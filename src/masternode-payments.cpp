@@ -240,6 +240,7 @@ void CMasternodePayments::Clear()
     LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
     mapMasternodeBlocks.clear();
     mapMasternodePaymentVotes.clear();
+    hashCleanupNext.SetNull();
 }
 
 bool CMasternodePayments::CanVote(COutPoint outMasternode, int nBlockHeight)
@@ -321,6 +322,19 @@ void CMasternodePayments::ProcessMessage(CNode* pfrom, std::string& strCommand,
         int nCountNeeded;
         vRecv >> nCountNeeded;
 
+        // Newer peers also tell us which votes they already have so that we only send the difference
+        bool fHasFilter = false;
+        CBloomFilter filterKnown;
+        if(pfrom->nVersion >= MNPAYMENTS_FILTER_VERSION && !vRecv.empty()) {
+            vRecv >> filterKnown;
+            if(!filterKnown.IsWithinSizeConstraints()) {
+                LogPrintf("MASTERNODEPAYMENTSYNC -- filter is too large, peer=%d\n", pfrom->id);
+                Misbehaving(pfrom->GetId(), 100);
+                return;
+            }
+            fHasFilter = true;
+        }
+
         if(netfulfilledman.HasFulfilledRequest(pfrom->addr, NetMsgType::MASTERNODEPAYMENTSYNC)) {
             // Asking for the payments list multiple times in a short period of time is no good
             LogPrintf("MASTERNODEPAYMENTSYNC -- peer already asked me for the list, peer=%d\n", pfrom->id);
@@ -329,7 +343,7 @@ void CMasternodePayments::ProcessMessage(CNode* pfrom, std::string& strCommand,
         }
         netfulfilledman.AddFulfilledRequest(pfrom->addr, NetMsgType::MASTERNODEPAYMENTSYNC);
 
-        Sync(pfrom, connman);
+        Sync(pfrom, connman, fHasFilter ? &filterKnown : NULL);
         LogPrintf("MASTERNODEPAYMENTSYNC -- Sent Masternode payment votes to peer %d\n", pfrom->id);
 
     } else if (strCommand == NetMsgType::MASTERNODEPAYMENTVOTE) { // Masternode Payments Vote for the Winner
@@ -414,7 +428,7 @@ void CMasternodePayments::ProcessMessage(CNode* pfrom, std::string& strCommand,
 
         if(AddPaymentVote(vote)){
             vote.Relay(connman);
-            masternodeSync.BumpAssetLastTime("MASTERNODEPAYMENTVOTE");
+            masternodeSync.BumpAssetLastTime(MASTERNODE_SYNC_MNW, "MASTERNODEPAYMENTVOTE");
         }
     }
 }
@@ -652,27 +666,37 @@ bool CMasternodePayments::IsTransactionValid(const CTransaction& txNew, int nBlo
     return true;
 }
 
-void CMasternodePayments::CheckAndRemove()
+// Check at most nMaxVotes votes per call (0 means all of them) and continue where the previous call stopped
+void CMasternodePayments::CheckAndRemove(int nMaxVotes)
 {
     if(!masternodeSync.IsBlockchainSynced()) return;
 
-    LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
-
     int nLimit = GetStorageLimit();
 
-    std::map<uint256, CMasternodePaymentVote>::iterator it = mapMasternodePaymentVotes.begin();
-    while(it != mapMasternodePaymentVotes.end()) {
-        CMasternodePaymentVote vote = (*it).second;
+    LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
+
+    std::map<uint256, CMasternodePaymentVote>::iterator it = nMaxVotes > 0 ? mapMasternodePaymentVotes.lower_bound(hashCleanupNext) : mapMasternodePaymentVotes.begin();
+    int nChecked = 0;
+    while(it != mapMasternodePaymentVotes.end() && (nMaxVotes <= 0 || nChecked < nMaxVotes)) {
+        int nBlockHeight = it->second.nBlockHeight;
+        nChecked++;
 
-        if(nCachedBlockHeight - vote.nBlockHeight > nLimit) {
-            LogPrint("mnpayments", "CMasternodePayments::CheckAndRemove -- Removing old Masternode payment: nBlockHeight=%d\n", vote.nBlockHeight);
+        if(nCachedBlockHeight - nBlockHeight > nLimit) {
+            LogPrint("mnpayments", "CMasternodePayments::CheckAndRemove -- Removing old Masternode payment: nBlockHeight=%d\n", nBlockHeight);
             mapMasternodePaymentVotes.erase(it++);
-            mapMasternodeBlocks.erase(vote.nBlockHeight);
+            mapMasternodeBlocks.erase(nBlockHeight);
         } else {
             ++it;
         }
     }
-    LogPrintf("CMasternodePayments::CheckAndRemove -- %s\n", ToString());
+
+    if(it == mapMasternodePaymentVotes.end()) {
+        // full pass is done, start over next time
+        hashCleanupNext.SetNull();
+        LogPrintf("CMasternodePayments::CheckAndRemove -- %s\n", ToString());
+    } else {
+        hashCleanupNext = it->first;
+    }
 }
 
 bool CMasternodePaymentVote::IsValid(CNode* pnode, int nValidationHeight, std::string& strError, CConnman& connman)
@@ -906,8 +930,39 @@ std::string CMasternodePaymentVote::ToString() const
     return info.str();
 }
 
-// Send only votes for future blocks, node should request every other missing payment block individually
-void CMasternodePayments::Sync(CNode* pnode, CConnman& connman)
+// Build a filter of the verified votes we have, peers use it to send us only the votes we are missing.
+// Beyond MNPAYMENTS_SYNC_FILTER_MAX_VOTES only the votes for the most recent blocks are included.
+void CMasternodePayments::GetSyncFilter(CBloomFilter& filterRet)
+{
+    LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
+
+    std::vector<uint256> vecVoteHashes;
+    std::map<int, CMasternodeBlockPayees>::reverse_iterator it = mapMasternodeBlocks.rbegin();
+    while(it != mapMasternodeBlocks.rend() && vecVoteHashes.size() < MNPAYMENTS_SYNC_FILTER_MAX_VOTES) {
+        BOOST_FOREACH(CMasternodePayee& payee, it->second.vecPayees) {
+            BOOST_FOREACH(const uint256& hash, payee.GetVoteHashes()) {
+                std::map<uint256, CMasternodePaymentVote>::iterator itVote = mapMasternodePaymentVotes.find(hash);
+                if(itVote != mapMasternodePaymentVotes.end() && itVote->second.IsVerified()) {
+                    vecVoteHashes.push_back(hash);
+                }
+            }
+        }
+        ++it;
+    }
+    if(vecVoteHashes.size() > MNPAYMENTS_SYNC_FILTER_MAX_VOTES) {
+        vecVoteHashes.resize(MNPAYMENTS_SYNC_FILTER_MAX_VOTES);
+    }
+
+    filterRet = CBloomFilter(std::max<size_t>(vecVoteHashes.size(), 1), MNPAYMENTS_SYNC_FILTER_FP_RATE, GetRandInt(999999), BLOOM_UPDATE_NONE);
+
+    BOOST_FOREACH(const uint256& hash, vecVoteHashes) {
+        filterRet.insert(hash);
+    }
+}
+
+// Without a filter send only votes for future blocks, node should request every other missing payment block individually.
+// With a filter send every vote we store which is not in it.
+void CMasternodePayments::Sync(CNode* pnode, CConnman& connman, const CBloomFilter* pfilterKnown)
 {
     LOCK(cs_mapMasternodeBlocks);
 
@@ -915,17 +970,20 @@ void CMasternodePayments::Sync(CNode* pnode, CConnman& connman)
 
     int nInvCount = 0;
 
-    for(int h = nCachedBlockHeight; h < nCachedBlockHeight + 20; h++) {
-        if(mapMasternodeBlocks.count(h)) {
-            BOOST_FOREACH(CMasternodePayee& payee, mapMasternodeBlocks[h].vecPayees) {
-                std::vector<uint256> vecVoteHashes = payee.GetVoteHashes();
-                BOOST_FOREACH(uint256& hash, vecVoteHashes) {
-                    if(!HasVerifiedPaymentVote(hash)) continue;
-                    pnode->PushInventory(CInv(MSG_MASTERNODE_PAYMENT_VOTE, hash));
-                    nInvCount++;
-                }
+    int nFirstBlock = pfilterKnown ? nCachedBlockHeight - GetStorageLimit() : nCachedBlockHeight;
+    std::map<int, CMasternodeBlockPayees>::iterator it = mapMasternodeBlocks.lower_bound(nFirstBlock);
+
+    while(it != mapMasternodeBlocks.end() && it->first < nCachedBlockHeight + 20) {
+        BOOST_FOREACH(CMasternodePayee& payee, it->second.vecPayees) {
+            std::vector<uint256> vecVoteHashes = payee.GetVoteHashes();
+            BOOST_FOREACH(uint256& hash, vecVoteHashes) {
+                if(pfilterKnown && pfilterKnown->contains(hash)) continue;
+                if(!HasVerifiedPaymentVote(hash)) continue;
+                pnode->PushInventory(CInv(MSG_MASTERNODE_PAYMENT_VOTE, hash));
+                nInvCount++;
             }
         }
+        ++it;
     }
 
     LogPrintf("CMasternodePayments::Sync -- Sent %d votes to peer %d\n", nInvCount, pnode->id);
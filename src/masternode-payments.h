@@ -7,6 +7,7 @@
 #define MASTERNODE_PAYMENTS_H
 
 #include "util.h"
+#include "bloom.h"
 #include "core_io.h"
 #include "key.h"
 #include "masternode.h"
@@ -20,6 +21,16 @@ class CMasternodeBlockPayees;
 static const int MNPAYMENTS_SIGNATURES_REQUIRED         = 6;
 static const int MNPAYMENTS_SIGNATURES_TOTAL            = 10;
 
+//! false positive rate of the known votes filter sent with "mnget", a vote missed because of it
+//  is sent by the next peer (filters use random tweaks) or its block is fetched by RequestLowDataPaymentBlocks
+static const double MNPAYMENTS_SYNC_FILTER_FP_RATE     = 0.001;
+//! most votes the known votes filter holds, more would not keep the false positive rate
+//  within MAX_BLOOM_FILTER_SIZE; votes left out are simply sent again
+static const unsigned int MNPAYMENTS_SYNC_FILTER_MAX_VOTES = 20000;
+
+//! how many payment votes CheckAndRemove looks at per call when it runs in slices
+static const int MNPAYMENTS_CLEANUP_SLICE_SIZE          = 10000;
+
 //! minimum peer version that can receive and send masternode payment messages,
 //  vote for masternode and be elected as a payment winner
 // V1 - Last protocol version before update
@@ -32,6 +43,7 @@ static const int MIN_MASTERNODE_PAYMENT_PROTO_VERSION_3 = 70209;
 extern CCriticalSection cs_vecPayees;
 extern CCriticalSection cs_mapMasternodeBlocks;
 extern CCriticalSection cs_mapMasternodePayeeVotes;
+extern CCriticalSection cs_mapMasternodePaymentVotes;
 
 extern CMasternodePayments mnpayments;
 
@@ -178,6 +190,9 @@ private:
     // Keep track of current block height
     int nCachedBlockHeight;
 
+    // Vote CheckAndRemove continues from when it runs in slices
+    uint256 hashCleanupNext;
+
 public:
     std::map<uint256, CMasternodePaymentVote> mapMasternodePaymentVotes;
     std::map<int, CMasternodeBlockPayees> mapMasternodeBlocks;
@@ -190,6 +205,8 @@ public:
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        // also taken while cache snapshots are copied from the scheduler thread
+        LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
         READWRITE(mapMasternodePaymentVotes);
         READWRITE(mapMasternodeBlocks);
     }
@@ -201,9 +218,10 @@ public:
     bool ProcessBlock(int nBlockHeight, CConnman& connman);
     void CheckPreviousBlockVotes(int nPrevBlockHeight);
 
-    void Sync(CNode* node, CConnman& connman);
+    void GetSyncFilter(CBloomFilter& filterRet);
+    void Sync(CNode* node, CConnman& connman, const CBloomFilter* pfilterKnown = NULL);
     void RequestLowDataPaymentBlocks(CNode* pnode, CConnman& connman);
-    void CheckAndRemove();
+    void CheckAndRemove(int nMaxVotes = 0);
 
     bool GetBlockPayee(int nBlockHeight, CScript& payee);
     bool IsTransactionValid(const CTransaction& txNew, int nBlockHeight);
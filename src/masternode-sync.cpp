@@ -19,6 +19,34 @@
 class CMasternodeSync;
 CMasternodeSync masternodeSync;
 
+void CMasternodeSyncAsset::Reset()
+{
+    nAttempt = 0;
+    nTimeStarted = GetTime();
+    nTimeLastBumped = GetTime();
+    nMaxPingUsec = 0;
+    fSynced = false;
+}
+
+void CMasternodeSyncAsset::AddPeer(const CNode* pnode)
+{
+    nAttempt++;
+    // no pong yet, assume the peer is slow enough to need the default timeout
+    int64_t nPingUsec = pnode->nMinPingUsecTime == std::numeric_limits<int64_t>::max()
+                            ? (int64_t)MASTERNODE_SYNC_TIMEOUT_SECONDS * 1000000 / MASTERNODE_SYNC_TIMEOUT_PING_FACTOR
+                            : pnode->nMinPingUsecTime;
+    nMaxPingUsec = std::max(nMaxPingUsec, nPingUsec);
+}
+
+int64_t CMasternodeSyncAsset::GetTimeout() const
+{
+    // nobody was asked yet, nothing to measure
+    if(nMaxPingUsec == 0) return MASTERNODE_SYNC_TIMEOUT_SECONDS;
+
+    int64_t nTimeout = nMaxPingUsec * MASTERNODE_SYNC_TIMEOUT_PING_FACTOR / 1000000;
+    return std::min<int64_t>(std::max<int64_t>(nTimeout, MASTERNODE_SYNC_MIN_TIMEOUT_SECONDS), MASTERNODE_SYNC_TIMEOUT_SECONDS);
+}
+
 void CMasternodeSync::Fail()
 {
     nTimeLastFailure = GetTime();
@@ -32,12 +60,35 @@ void CMasternodeSync::Reset()
     nTimeAssetSyncStarted = GetTime();
     nTimeLastBumped = GetTime();
     nTimeLastFailure = 0;
+    assetList.Reset();
+    assetWinners.Reset();
+    assetGovernance.Reset();
 }
 
-void CMasternodeSync::BumpAssetLastTime(std::string strFuncName)
+CMasternodeSyncAsset* CMasternodeSync::GetAsset(int nAsset)
+{
+    switch(nAsset)
+    {
+        case(MASTERNODE_SYNC_LIST):         return &assetList;
+        case(MASTERNODE_SYNC_MNW):          return &assetWinners;
+        case(MASTERNODE_SYNC_GOVERNANCE):   return &assetGovernance;
+        default:                            return NULL;
+    }
+}
+
+int CMasternodeSync::GetAttempt()
+{
+    CMasternodeSyncAsset* passet = GetAsset(nRequestedMasternodeAssets);
+    if(passet && Params().NetworkIDString() != CBaseChainParams::REGTEST) return passet->nAttempt;
+    return nRequestedMasternodeAttempt;
+}
+
+void CMasternodeSync::BumpAssetLastTime(int nAsset, std::string strFuncName)
 {
     if(IsSynced() || IsFailed()) return;
     nTimeLastBumped = GetTime();
+    CMasternodeSyncAsset* passet = GetAsset(nAsset);
+    if(passet) passet->nTimeLastBumped = GetTime();
     LogPrint("mnsync", "CMasternodeSync::BumpAssetLastTime -- %s\n", strFuncName);
 }
 
@@ -72,20 +123,31 @@ void CMasternodeSync::SwitchToNextAsset(CConnman& connman)
             ClearFulfilledRequests(connman);
             LogPrintf("CMasternodeSync::SwitchToNextAsset -- Completed %s in %llds\n", GetAssetName(), GetTime() - nTimeAssetSyncStarted);
             nRequestedMasternodeAssets = MASTERNODE_SYNC_LIST;
+            assetList.Reset();
             LogPrintf("CMasternodeSync::SwitchToNextAsset -- Starting %s\n", GetAssetName());
             break;
         case(MASTERNODE_SYNC_LIST):
-            LogPrintf("CMasternodeSync::SwitchToNextAsset -- Completed %s in %llds\n", GetAssetName(), GetTime() - nTimeAssetSyncStarted);
+            LogPrintf("CMasternodeSync::SwitchToNextAsset -- Completed %s in %llds\n", GetAssetName(), GetTime() - assetList.nTimeStarted);
+            assetList.fSynced = true;
+            // payment votes and governance objects only need the masternode list, sync them side by side
             nRequestedMasternodeAssets = MASTERNODE_SYNC_MNW;
-            LogPrintf("CMasternodeSync::SwitchToNextAsset -- Starting %s\n", GetAssetName());
+            assetWinners.Reset();
+            assetGovernance.Reset();
+            LogPrintf("CMasternodeSync::SwitchToNextAsset -- Starting %s and MASTERNODE_SYNC_GOVERNANCE\n", GetAssetName());
             break;
         case(MASTERNODE_SYNC_MNW):
-            LogPrintf("CMasternodeSync::SwitchToNextAsset -- Completed %s in %llds\n", GetAssetName(), GetTime() - nTimeAssetSyncStarted);
+            LogPrintf("CMasternodeSync::SwitchToNextAsset -- Completed %s in %llds\n", GetAssetName(), GetTime() - assetWinners.nTimeStarted);
+            assetWinners.fSynced = true;
             nRequestedMasternodeAssets = MASTERNODE_SYNC_GOVERNANCE;
-            LogPrintf("CMasternodeSync::SwitchToNextAsset -- Starting %s\n", GetAssetName());
-            break;
+            if(!assetGovernance.fSynced) {
+                LogPrintf("CMasternodeSync::SwitchToNextAsset -- Waiting for %s\n", GetAssetName());
+                break;
+            }
+            // governance was synced in parallel already, we are done
+            // fall through
         case(MASTERNODE_SYNC_GOVERNANCE):
-            LogPrintf("CMasternodeSync::SwitchToNextAsset -- Completed %s in %llds\n", GetAssetName(), GetTime() - nTimeAssetSyncStarted);
+            LogPrintf("CMasternodeSync::SwitchToNextAsset -- Completed %s in %llds\n", GetAssetName(), GetTime() - assetGovernance.nTimeStarted);
+            assetGovernance.fSynced = true;
             nRequestedMasternodeAssets = MASTERNODE_SYNC_FINISHED;
             uiInterface.NotifyAdditionalDataSyncProgressChanged(1);
             //try to activate our masternode if possible
@@ -186,12 +248,16 @@ void CMasternodeSync::ProcessTick(CConnman& connman)
     }
 
     // Calculate "progress" for LOG reporting / GUI notification
-    double nSyncProgress = double(nRequestedMasternodeAttempt + (nRequestedMasternodeAssets - 1) * 8) / (8*4);
-    LogPrintf("CMasternodeSync::ProcessTick -- nTick %d nRequestedMasternodeAssets %d nRequestedMasternodeAttempt %d nSyncProgress %f\n", nTick, nRequestedMasternodeAssets, nRequestedMasternodeAttempt, nSyncProgress);
+    double nSyncProgress = double(GetAttempt() + (nRequestedMasternodeAssets - 1) * 8) / (8*4);
+    LogPrintf("CMasternodeSync::ProcessTick -- nTick %d nRequestedMasternodeAssets %d nRequestedMasternodeAttempt %d nSyncProgress %f\n", nTick, nRequestedMasternodeAssets, GetAttempt(), nSyncProgress);
     uiInterface.NotifyAdditionalDataSyncProgressChanged(nSyncProgress);
 
     std::vector<CNode*> vNodesCopy = connman.CopyNodeVector();
 
+    bool fCheckedTimeouts = false;
+    bool fRequestedWinners = false;
+    bool fRequestedGovernance = false;
+
     BOOST_FOREACH(CNode* pnode, vNodesCopy)
     {
         // Don't try to sync any data from outbound "masternode" connections -
@@ -258,11 +324,11 @@ void CMasternodeSync::ProcessTick(CConnman& connman)
             // MNLIST : SYNC MASTERNODE LIST FROM OTHER CONNECTED CLIENTS
 
             if(nRequestedMasternodeAssets == MASTERNODE_SYNC_LIST) {
-                LogPrint("masternode", "CMasternodeSync::ProcessTick -- nTick %d nRequestedMasternodeAssets %d nTimeLastBumped %lld GetTime() %lld diff %lld\n", nTick, nRequestedMasternodeAssets, nTimeLastBumped, GetTime(), GetTime() - nTimeLastBumped);
+                LogPrint("masternode", "CMasternodeSync::ProcessTick -- nTick %d nRequestedMasternodeAssets %d nTimeLastBumped %lld GetTime() %lld diff %lld\n", nTick, nRequestedMasternodeAssets, assetList.nTimeLastBumped, GetTime(), GetTime() - assetList.nTimeLastBumped);
                 // check for timeout first
-                if(GetTime() - nTimeLastBumped > MASTERNODE_SYNC_TIMEOUT_SECONDS) {
+                if(assetList.IsTimedOut()) {
                     LogPrintf("CMasternodeSync::ProcessTick -- nTick %d nRequestedMasternodeAssets %d -- timeout\n", nTick, nRequestedMasternodeAssets);
-                    if (nRequestedMasternodeAttempt == 0) {
+                    if (assetList.nAttempt == 0) {
                         LogPrintf("CMasternodeSync::ProcessTick -- ERROR: failed to sync %s\n", GetAssetName());
                         // there is no way we can continue without masternode list, fail here and try later
                         Fail();
@@ -279,7 +345,7 @@ void CMasternodeSync::ProcessTick(CConnman& connman)
                 netfulfilledman.AddFulfilledRequest(pnode->addr, "masternode-list-sync");
 
                 if (pnode->nVersion < mnpayments.GetMinMasternodePaymentsProto()) continue;
-                nRequestedMasternodeAttempt++;
+                assetList.AddPeer(pnode);
 
                 mnodeman.DsegUpdate(pnode, connman);
 
@@ -287,122 +353,170 @@ void CMasternodeSync::ProcessTick(CConnman& connman)
                 return; //this will cause each peer to get one request each six seconds for the various assets we need
             }
 
-            // MNW : SYNC MASTERNODE PAYMENT VOTES FROM OTHER CONNECTED CLIENTS
+            // MNW + GOVOBJ : SYNC MASTERNODE PAYMENT VOTES AND GOVERNANCE ITEMS FROM DIFFERENT PEERS IN PARALLEL
 
-            if(nRequestedMasternodeAssets == MASTERNODE_SYNC_MNW) {
-                LogPrint("mnpayments", "CMasternodeSync::ProcessTick -- nTick %d nRequestedMasternodeAssets %d nTimeLastBumped %lld GetTime() %lld diff %lld\n", nTick, nRequestedMasternodeAssets, nTimeLastBumped, GetTime(), GetTime() - nTimeLastBumped);
-                // check for timeout first
-                // This might take a lot longer than MASTERNODE_SYNC_TIMEOUT_SECONDS due to new blocks,
-                // but that should be OK and it should timeout eventually.
-                if(GetTime() - nTimeLastBumped > MASTERNODE_SYNC_TIMEOUT_SECONDS) {
-                    LogPrintf("CMasternodeSync::ProcessTick -- nTick %d nRequestedMasternodeAssets %d -- timeout\n", nTick, nRequestedMasternodeAssets);
-                    if (nRequestedMasternodeAttempt == 0) {
-                        LogPrintf("CMasternodeSync::ProcessTick -- ERROR: failed to sync %s\n", GetAssetName());
-                        // probably not a good idea to proceed without winner list
-                        Fail();
+            if(nRequestedMasternodeAssets == MASTERNODE_SYNC_MNW || nRequestedMasternodeAssets == MASTERNODE_SYNC_GOVERNANCE) {
+                if(!fCheckedTimeouts) {
+                    fCheckedTimeouts = true;
+                    if(!CheckParallelTimeouts(nTick, connman)) {
                         connman.ReleaseNodeVector(vNodesCopy);
                         return;
                     }
-                    SwitchToNextAsset(connman);
-                    connman.ReleaseNodeVector(vNodesCopy);
-                    return;
                 }
 
-                // check for data
-                // if mnpayments already has enough blocks and votes, switch to the next asset
-                // try to fetch data from at least two peers though
-                if(nRequestedMasternodeAttempt > 1 && mnpayments.IsEnoughData()) {
-                    LogPrintf("CMasternodeSync::ProcessTick -- nTick %d nRequestedMasternodeAssets %d -- found enough data\n", nTick, nRequestedMasternodeAssets);
-                    SwitchToNextAsset(connman);
-                    connman.ReleaseNodeVector(vNodesCopy);
-                    return;
+                // ask a single new peer for each asset per tick and never the same peer for both
+                if(!assetWinners.fSynced && !fRequestedWinners) {
+                    fRequestedWinners = SyncWinners(pnode, nTick, connman);
+                    if(fRequestedWinners) continue;
                 }
-
-                // only request once from each peer
-                if(netfulfilledman.HasFulfilledRequest(pnode->addr, "masternode-payment-sync")) continue;
-                netfulfilledman.AddFulfilledRequest(pnode->addr, "masternode-payment-sync");
-
-                if(pnode->nVersion < mnpayments.GetMinMasternodePaymentsProto()) continue;
-                nRequestedMasternodeAttempt++;
-
-                // ask node for all payment votes it has (new nodes will only return votes for future payments)
-                connman.PushMessage(pnode, NetMsgType::MASTERNODEPAYMENTSYNC, mnpayments.GetStorageLimit());
-                // ask node for missing pieces only (old nodes will not be asked)
-                mnpayments.RequestLowDataPaymentBlocks(pnode, connman);
-
-                connman.ReleaseNodeVector(vNodesCopy);
-                return; //this will cause each peer to get one request each six seconds for the various assets we need
+                if(!assetGovernance.fSynced && SyncGovernance(pnode, nTick, !fRequestedGovernance, connman)) {
+                    fRequestedGovernance = true;
+                }
+                if(IsSynced()) break;
             }
+        }
+    }
+    // looped through all nodes, release them
+    connman.ReleaseNodeVector(vNodesCopy);
+}
 
-            // GOVOBJ : SYNC GOVERNANCE ITEMS FROM OUR PEERS
+void CMasternodeSync::CompleteAsset(int nAsset, CConnman& connman)
+{
+    if(nAsset == nRequestedMasternodeAssets) {
+        SwitchToNextAsset(connman);
+        return;
+    }
+    // finished ahead of the asset we are waiting for, SwitchToNextAsset will move past it
+    CMasternodeSyncAsset* passet = GetAsset(nAsset);
+    if(!passet || passet->fSynced) return;
+    passet->fSynced = true;
+    LogPrintf("CMasternodeSync::CompleteAsset -- Completed asset %d in %llds\n", nAsset, GetTime() - passet->nTimeStarted);
+}
 
-            if(nRequestedMasternodeAssets == MASTERNODE_SYNC_GOVERNANCE) {
-                LogPrint("gobject", "CMasternodeSync::ProcessTick -- nTick %d nRequestedMasternodeAssets %d nTimeLastBumped %lld GetTime() %lld diff %lld\n", nTick, nRequestedMasternodeAssets, nTimeLastBumped, GetTime(), GetTime() - nTimeLastBumped);
+// Returns false if there is nothing left to request during this tick
+bool CMasternodeSync::CheckParallelTimeouts(int nTick, CConnman& connman)
+{
+    if(!assetWinners.fSynced && assetWinners.IsTimedOut()) {
+        // This might take a lot longer than the timeout due to new blocks,
+        // but that should be OK and it should timeout eventually.
+        LogPrintf("CMasternodeSync::ProcessTick -- nTick %d nRequestedMasternodeAssets %d -- MASTERNODE_SYNC_MNW timeout\n", nTick, nRequestedMasternodeAssets);
+        if(assetWinners.nAttempt == 0) {
+            LogPrintf("CMasternodeSync::ProcessTick -- ERROR: failed to sync MASTERNODE_SYNC_MNW\n");
+            // probably not a good idea to proceed without winner list
+            Fail();
+            return false;
+        }
+        CompleteAsset(MASTERNODE_SYNC_MNW, connman);
+    }
 
-                // check for timeout first
-                if(GetTime() - nTimeLastBumped > MASTERNODE_SYNC_TIMEOUT_SECONDS) {
-                    LogPrintf("CMasternodeSync::ProcessTick -- nTick %d nRequestedMasternodeAssets %d -- timeout\n", nTick, nRequestedMasternodeAssets);
-                    if(nRequestedMasternodeAttempt == 0) {
-                        LogPrintf("CMasternodeSync::ProcessTick -- WARNING: failed to sync %s\n", GetAssetName());
-                        // it's kind of ok to skip this for now, hopefully we'll catch up later?
-                    }
-                    SwitchToNextAsset(connman);
-                    connman.ReleaseNodeVector(vNodesCopy);
-                    return;
-                }
+    if(!assetGovernance.fSynced && assetGovernance.IsTimedOut()) {
+        LogPrintf("CMasternodeSync::ProcessTick -- nTick %d nRequestedMasternodeAssets %d -- MASTERNODE_SYNC_GOVERNANCE timeout\n", nTick, nRequestedMasternodeAssets);
+        if(assetGovernance.nAttempt == 0) {
+            LogPrintf("CMasternodeSync::ProcessTick -- WARNING: failed to sync MASTERNODE_SYNC_GOVERNANCE\n");
+            // it's kind of ok to skip this for now, hopefully we'll catch up later?
+        }
+        CompleteAsset(MASTERNODE_SYNC_GOVERNANCE, connman);
+    }
 
-                // only request obj sync once from each peer, then request votes on per-obj basis
-                if(netfulfilledman.HasFulfilledRequest(pnode->addr, "governance-sync")) {
-                    int nObjsLeftToAsk = governance.RequestGovernanceObjectVotes(pnode, connman);
-                    static int64_t nTimeNoObjectsLeft = 0;
-                    // check for data
-                    if(nObjsLeftToAsk == 0) {
-                        static int nLastTick = 0;
-                        static int nLastVotes = 0;
-                        if(nTimeNoObjectsLeft == 0) {
-                            // asked all objects for votes for the first time
-                            nTimeNoObjectsLeft = GetTime();
-                        }
-                        // make sure the condition below is checked only once per tick
-                        if(nLastTick == nTick) continue;
-                        if(GetTime() - nTimeNoObjectsLeft > MASTERNODE_SYNC_TIMEOUT_SECONDS &&
-                            governance.GetVoteCount() - nLastVotes < std::max(int(0.0001 * nLastVotes), MASTERNODE_SYNC_TICK_SECONDS)
-                        ) {
-                            // We already asked for all objects, waited for MASTERNODE_SYNC_TIMEOUT_SECONDS
-                            // after that and less then 0.01% or MASTERNODE_SYNC_TICK_SECONDS
-                            // (i.e. 1 per second) votes were recieved during the last tick.
-                            // We can be pretty sure that we are done syncing.
-                            LogPrintf("CMasternodeSync::ProcessTick -- nTick %d nRequestedMasternodeAssets %d -- asked for all objects, nothing to do\n", nTick, nRequestedMasternodeAssets);
-                            // reset nTimeNoObjectsLeft to be able to use the same condition on resync
-                            nTimeNoObjectsLeft = 0;
-                            SwitchToNextAsset(connman);
-                            connman.ReleaseNodeVector(vNodesCopy);
-                            return;
-                        }
-                        nLastTick = nTick;
-                        nLastVotes = governance.GetVoteCount();
-                    }
-                    continue;
-                }
-                netfulfilledman.AddFulfilledRequest(pnode->addr, "governance-sync");
+    return !IsSynced();
+}
+
+// Returns true if payment votes were requested from pnode
+bool CMasternodeSync::SyncWinners(CNode* pnode, int nTick, CConnman& connman)
+{
+    LogPrint("mnpayments", "CMasternodeSync::SyncWinners -- nTick %d nTimeLastBumped %lld GetTime() %lld diff %lld\n", nTick, assetWinners.nTimeLastBumped, GetTime(), GetTime() - assetWinners.nTimeLastBumped);
+
+    // check for data
+    // if mnpayments already has enough blocks and votes, the asset is done
+    // try to fetch data from at least two peers though
+    if(assetWinners.nAttempt > 1 && mnpayments.IsEnoughData()) {
+        LogPrintf("CMasternodeSync::ProcessTick -- nTick %d nRequestedMasternodeAssets %d -- found enough data\n", nTick, nRequestedMasternodeAssets);
+        CompleteAsset(MASTERNODE_SYNC_MNW, connman);
+        return false;
+    }
 
-                if (pnode->nVersion < MIN_GOVERNANCE_PEER_PROTO_VERSION) continue;
-                nRequestedMasternodeAttempt++;
+    // only request once from each peer
+    if(netfulfilledman.HasFulfilledRequest(pnode->addr, "masternode-payment-sync")) return false;
+    if(pnode->nVersion < mnpayments.GetMinMasternodePaymentsProto()) return false;
+    netfulfilledman.AddFulfilledRequest(pnode->addr, "masternode-payment-sync");
+    assetWinners.AddPeer(pnode);
+
+    if(pnode->nVersion >= MNPAYMENTS_FILTER_VERSION) {
+        // tell node which votes we already have and let it send us the rest,
+        // every filter gets a new random tweak so votes hidden by a false positive
+        // on one peer are very likely sent by the next one
+        CBloomFilter filterKnown;
+        mnpayments.GetSyncFilter(filterKnown);
+        connman.PushMessage(pnode, NetMsgType::MASTERNODEPAYMENTSYNC, mnpayments.GetStorageLimit(), filterKnown);
+    } else {
+        // ask node for all payment votes it has (new nodes will only return votes for future payments)
+        connman.PushMessage(pnode, NetMsgType::MASTERNODEPAYMENTSYNC, mnpayments.GetStorageLimit());
+    }
+    // ask node for missing pieces only (old nodes will not be asked),
+    // this also fills blocks left short of votes by filter false positives
+    mnpayments.RequestLowDataPaymentBlocks(pnode, connman);
 
-                SendGovernanceSyncRequest(pnode, connman);
+    return true;
+}
 
-                connman.ReleaseNodeVector(vNodesCopy);
-                return; //this will cause each peer to get one request each six seconds for the various assets we need
+// Returns true if governance objects were requested from pnode
+bool CMasternodeSync::SyncGovernance(CNode* pnode, int nTick, bool fAllowRequest, CConnman& connman)
+{
+    LogPrint("gobject", "CMasternodeSync::SyncGovernance -- nTick %d nTimeLastBumped %lld GetTime() %lld diff %lld\n", nTick, assetGovernance.nTimeLastBumped, GetTime(), GetTime() - assetGovernance.nTimeLastBumped);
+
+    // only request obj sync once from each peer, then request votes on per-obj basis
+    if(netfulfilledman.HasFulfilledRequest(pnode->addr, "governance-sync")) {
+        int nObjsLeftToAsk = governance.RequestGovernanceObjectVotes(pnode, connman);
+        static int64_t nTimeNoObjectsLeft = 0;
+        // check for data
+        if(nObjsLeftToAsk == 0) {
+            static int nLastTick = 0;
+            static int nLastVotes = 0;
+            if(nTimeNoObjectsLeft == 0) {
+                // asked all objects for votes for the first time
+                nTimeNoObjectsLeft = GetTime();
+            }
+            // make sure the condition below is checked only once per tick
+            if(nLastTick == nTick) return false;
+            if(GetTime() - nTimeNoObjectsLeft > assetGovernance.GetTimeout() &&
+                governance.GetVoteCount() - nLastVotes < std::max(int(0.0001 * nLastVotes), MASTERNODE_SYNC_TICK_SECONDS)
+            ) {
+                // We already asked for all objects, waited for the asset timeout
+                // after that and less then 0.01% or MASTERNODE_SYNC_TICK_SECONDS
+                // (i.e. 1 per second) votes were recieved during the last tick.
+                // We can be pretty sure that we are done syncing.
+                LogPrintf("CMasternodeSync::ProcessTick -- nTick %d nRequestedMasternodeAssets %d -- asked for all objects, nothing to do\n", nTick, nRequestedMasternodeAssets);
+                // reset nTimeNoObjectsLeft to be able to use the same condition on resync
+                nTimeNoObjectsLeft = 0;
+                CompleteAsset(MASTERNODE_SYNC_GOVERNANCE, connman);
+                return false;
             }
+            nLastTick = nTick;
+            nLastVotes = governance.GetVoteCount();
         }
+        return false;
     }
-    // looped through all nodes, release them
-    connman.ReleaseNodeVector(vNodesCopy);
+
+    if(!fAllowRequest) return false;
+    if(pnode->nVersion < MIN_GOVERNANCE_PEER_PROTO_VERSION) return false;
+    netfulfilledman.AddFulfilledRequest(pnode->addr, "governance-sync");
+    assetGovernance.AddPeer(pnode);
+
+    SendGovernanceSyncRequest(pnode, connman);
+
+    return true;
 }
 
 void CMasternodeSync::SendGovernanceSyncRequest(CNode* pnode, CConnman& connman)
 {
-    if(pnode->nVersion >= GOVERNANCE_FILTER_PROTO_VERSION) {
+    if(pnode->nVersion >= GOVERNANCE_DIGEST_PROTO_VERSION) {
+        CBloomFilter filter;
+        filter.clear();
+
+        // let the peer tell us which of the objects we already have got new votes
+        connman.PushMessage(pnode, NetMsgType::MNGOVERNANCESYNC, uint256(), filter, governance.GetVoteDigests());
+    }
+    else if(pnode->nVersion >= GOVERNANCE_FILTER_PROTO_VERSION) {
         CBloomFilter filter;
         filter.clear();
 
@@ -24,23 +24,55 @@ static const int MASTERNODE_SYNC_FINISHED        = 999;
 
 static const int MASTERNODE_SYNC_TICK_SECONDS    = 6;
 static const int MASTERNODE_SYNC_TIMEOUT_SECONDS = 30; // our blocks are 2.5 minutes so 30 seconds should be fine
+static const int MASTERNODE_SYNC_MIN_TIMEOUT_SECONDS = 12; // never give up on an asset faster than two ticks
+static const int MASTERNODE_SYNC_TIMEOUT_PING_FACTOR = 50; // assume peers are done after this many round trips without new data
 
 static const int MASTERNODE_SYNC_ENOUGH_PEERS    = 6;
 
 extern CMasternodeSync masternodeSync;
 
 //
-// CMasternodeSync : Sync masternode assets in stages
+// CMasternodeSyncAsset : Progress of a single masternode asset
+//
+
+class CMasternodeSyncAsset
+{
+public:
+    // Count peers we've requested the asset from
+    int nAttempt;
+    // Time when the asset sync started
+    int64_t nTimeStarted;
+    // ... last bumped
+    int64_t nTimeLastBumped;
+    // Slowest ping among the peers we've requested the asset from
+    int64_t nMaxPingUsec;
+    bool fSynced;
+
+    CMasternodeSyncAsset() { Reset(); }
+
+    void Reset();
+    void AddPeer(const CNode* pnode);
+    int64_t GetTimeout() const;
+    bool IsTimedOut() const { return GetTime() - nTimeLastBumped > GetTimeout(); }
+};
+
+//
+// CMasternodeSync : Sync masternode assets in stages,
+// payment votes and governance objects are requested in parallel once the masternode list is synced
 //
 
 class CMasternodeSync
 {
 private:
-    // Keep track of current asset
+    // Keep track of the first asset which is not synced yet
     int nRequestedMasternodeAssets;
-    // Count peers we've requested the asset from
+    // Count peers we've requested the asset from (regtest only, see CMasternodeSyncAsset)
     int nRequestedMasternodeAttempt;
 
+    CMasternodeSyncAsset assetList;
+    CMasternodeSyncAsset assetWinners;
+    CMasternodeSyncAsset assetGovernance;
+
     // Time when current masternode asset sync started
     int64_t nTimeAssetSyncStarted;
     // ... last bumped
@@ -51,6 +83,12 @@ private:
     void Fail();
     void ClearFulfilledRequests(CConnman& connman);
 
+    CMasternodeSyncAsset* GetAsset(int nAsset);
+    void CompleteAsset(int nAsset, CConnman& connman);
+    bool CheckParallelTimeouts(int nTick, CConnman& connman);
+    bool SyncWinners(CNode* pnode, int nTick, CConnman& connman);
+    bool SyncGovernance(CNode* pnode, int nTick, bool fAllowRequest, CConnman& connman);
+
 public:
     CMasternodeSync() { Reset(); }
 
@@ -64,8 +102,9 @@ public:
     bool IsSynced() { return nRequestedMasternodeAssets == MASTERNODE_SYNC_FINISHED; }
 
     int GetAssetID() { return nRequestedMasternodeAssets; }
-    int GetAttempt() { return nRequestedMasternodeAttempt; }
-    void BumpAssetLastTime(std::string strFuncName);
+    int GetAttempt();
+    void BumpAssetLastTime(std::string strFuncName) { BumpAssetLastTime(nRequestedMasternodeAssets, strFuncName); }
+    void BumpAssetLastTime(int nAsset, std::string strFuncName);
     int64_t GetAssetStartTime() { return nTimeAssetSyncStarted; }
     std::string GetAssetName();
     std::string GetSyncStatus();
@@ -42,7 +42,8 @@ CMasternode::CMasternode(const CMasternode& other) :
     nPoSeBanScore(other.nPoSeBanScore),
     nPoSeBanHeight(other.nPoSeBanHeight),
     fAllowMixingTx(other.fAllowMixingTx),
-    fUnitTest(other.fUnitTest)
+    fUnitTest(other.fUnitTest),
+    fCollateralChecked(other.fCollateralChecked)
 {}
 
 CMasternode::CMasternode(const CMasternodeBroadcast& mnb) :
@@ -145,11 +146,15 @@ void CMasternode::Check(bool fForce)
         TRY_LOCK(cs_main, lockMain);
         if(!lockMain) return;
 
-        CollateralStatus err = CheckCollateral(vin.prevout);
-        if (err == COLLATERAL_UTXO_NOT_FOUND) {
-            nActiveState = MASTERNODE_OUTPOINT_SPENT;
-            LogPrint("masternode", "CMasternode::Check -- Failed to find Masternode UTXO, masternode=%s\n", vin.prevout.ToStringShort());
-            return;
+        // look collateral up only once, CMasternodeMan::BlockConnected/BlockDisconnected take care of the rest
+        if(!fCollateralChecked) {
+            CollateralStatus err = CheckCollateral(vin.prevout);
+            fCollateralChecked = true;
+            if (err == COLLATERAL_UTXO_NOT_FOUND) {
+                nActiveState = MASTERNODE_OUTPOINT_SPENT;
+                LogPrint("masternode", "CMasternode::Check -- Failed to find Masternode UTXO, masternode=%s\n", vin.prevout.ToStringShort());
+                return;
+            }
         }
 
         nHeight = chainActive.Height();
@@ -269,6 +274,26 @@ bool CMasternode::IsInputAssociatedWithPubkey()
     return false;
 }
 
+void CMasternode::SetCollateralSpent()
+{
+    LOCK(cs);
+    fCollateralChecked = true;
+    if(IsOutpointSpent()) return;
+    nActiveState = MASTERNODE_OUTPOINT_SPENT;
+    LogPrint("masternode", "CMasternode::SetCollateralSpent -- Masternode UTXO spent, masternode=%s\n", vin.prevout.ToStringShort());
+}
+
+void CMasternode::RecheckCollateral()
+{
+    {
+        LOCK(cs);
+        fCollateralChecked = false;
+        // Check() stops at spent masternodes, give it a chance to find the collateral again
+        if(IsOutpointSpent()) nActiveState = MASTERNODE_PRE_ENABLED;
+    }
+    Check(true);
+}
+
 bool CMasternode::IsValidNetAddr()
 {
     return IsValidNetAddr(addr);
@@ -171,6 +171,8 @@ public:
     int nPoSeBanHeight{};
     bool fAllowMixingTx{};
     bool fUnitTest = false;
+    // collateral was looked up in the UTXO set, spends are reported by CMasternodeMan from then on (not serialized)
+    bool fCollateralChecked = false;
 
     // KEEP TRACK OF GOVERNANCE ITEMS EACH MASTERNODE HAS VOTE UPON FOR RECALCULATION
     std::map<uint256, int> mapGovernanceObjectsVotedOn;
@@ -216,6 +218,11 @@ public:
     static CollateralStatus CheckCollateral(const COutPoint& outpoint, int& nHeightRet);
     void Check(bool fForce = false);
 
+    /// Collateral was spent by a block connected to the active chain
+    void SetCollateralSpent();
+    /// A disconnected block created or spent the collateral, look it up again
+    void RecheckCollateral();
+
     bool IsBroadcastedWithin(int nSeconds) { return GetAdjustedTime() - sigTime < nSeconds; }
 
     bool IsPingedWithin(int nSeconds, int64_t nTimeToCheckAt = -1)
@@ -302,6 +309,7 @@ public:
         nPoSeBanHeight = from.nPoSeBanHeight;
         fAllowMixingTx = from.fAllowMixingTx;
         fUnitTest = from.fUnitTest;
+        fCollateralChecked = from.fCollateralChecked;
         mapGovernanceObjectsVotedOn = from.mapGovernanceObjectsVotedOn;
         return *this;
     }
@@ -64,6 +64,9 @@ CMasternodeMan::CMasternodeMan()
   fMasternodesRemoved(false),
   vecDirtyGovernanceObjectHashes(),
   nLastWatchdogVoteTime(0),
+  nListVersion(0),
+  csDsegSnapshot(),
+  dsegSnapshot(),
   mapSeenMasternodeBroadcast(),
   mapSeenMasternodePing(),
   nDsqCount(0)
@@ -78,6 +81,7 @@ bool CMasternodeMan::Add(CMasternode &mn)
     LogPrint("masternode", "CMasternodeMan::Add -- Adding new Masternode: addr=%s, %i now\n", mn.addr.ToString(), size() + 1);
     mapMasternodes[mn.vin.prevout] = mn;
     fMasternodesAdded = true;
+    nListVersion++;
     return true;
 }
 
@@ -159,29 +163,35 @@ void CMasternodeMan::Check()
     }
 }
 
-void CMasternodeMan::CheckAndRemove(CConnman& connman)
+void CMasternodeMan::CheckAndRemove(CConnman& connman, int nMaxMasternodes)
 {
     if(!masternodeSync.IsMasternodeListSynced()) return;
 
-    LogPrintf("CMasternodeMan::CheckAndRemove\n");
-
+    bool fSweepDone;
     {
         // Need LOCK2 here to ensure consistent locking order because code below locks cs_main
         // in CheckMnbAndUpdateMasternodeList()
         LOCK2(cs_main, cs);
 
-        Check();
+        // a sliced run only checks the masternodes of its slice, below
+        if(nMaxMasternodes <= 0) {
+            Check();
+        }
 
         // Remove spent masternodes, prepare structures and make requests to reasure the state of inactive ones
         rank_pair_vec_t vecMasternodeRanks;
         // ask for up to MNB_RECOVERY_MAX_ASK_ENTRIES masternode entries at a time
         int nAskForMnbRecovery = MNB_RECOVERY_MAX_ASK_ENTRIES;
-        std::map<COutPoint, CMasternode>::iterator it = mapMasternodes.begin();
-        while (it != mapMasternodes.end()) {
-            CMasternodeBroadcast mnb = CMasternodeBroadcast(it->second);
-            uint256 hash = mnb.GetHash();
+        std::map<COutPoint, CMasternode>::iterator it = (nMaxMasternodes > 0 && !outpointCleanupNext.IsNull()) ? mapMasternodes.lower_bound(outpointCleanupNext) : mapMasternodes.begin();
+        int nChecked = 0;
+        while (it != mapMasternodes.end() && (nMaxMasternodes <= 0 || nChecked < nMaxMasternodes)) {
+            nChecked++;
+            if(nMaxMasternodes > 0) {
+                it->second.Check();
+            }
             // If collateral was spent ...
             if (it->second.IsOutpointSpent()) {
+                uint256 hash = CMasternodeBroadcast(it->second).GetHash();
                 LogPrint("masternode", "CMasternodeMan::CheckAndRemove -- Removing Masternode: %s  addr=%s  %i now\n", it->second.GetStateString(), it->second.addr.ToString(), size() - 1);
 
                 // erase all of the broadcasts we've seen from this txin, ...
@@ -192,11 +202,17 @@ void CMasternodeMan::CheckAndRemove(CConnman& connman)
                 it->second.FlagGovernanceItemsAsDirty();
                 mapMasternodes.erase(it++);
                 fMasternodesRemoved = true;
+                nListVersion++;
             } else {
                 bool fAsk = (nAskForMnbRecovery > 0) &&
                             masternodeSync.IsSynced() &&
-                            it->second.IsNewStartRequired() &&
-                            !IsMnbRecoveryRequested(hash);
+                            it->second.IsNewStartRequired();
+                // hashing the broadcast is the expensive part, only do it for masternodes that need it
+                uint256 hash;
+                if(fAsk) {
+                    hash = CMasternodeBroadcast(it->second).GetHash();
+                    fAsk = !IsMnbRecoveryRequested(hash);
+                }
                 if(fAsk) {
                     // this mn is in a non-recoverable state and we haven't asked other nodes yet
                     std::set<CNetAddr> setRequested;
@@ -227,6 +243,13 @@ void CMasternodeMan::CheckAndRemove(CConnman& connman)
             }
         }
 
+        fSweepDone = it == mapMasternodes.end();
+        if(fSweepDone) {
+            outpointCleanupNext.SetNull();
+        } else {
+            outpointCleanupNext = it->first;
+        }
+
         // proces replies for MASTERNODE_NEW_START_REQUIRED masternodes
         LogPrint("masternode", "CMasternodeMan::CheckAndRemove -- mMnbRecoveryGoodReplies size=%d\n", (int)mMnbRecoveryGoodReplies.size());
         std::map<uint256, std::vector<CMasternodeBroadcast> >::iterator itMnbReplies = mMnbRecoveryGoodReplies.begin();
@@ -248,7 +271,8 @@ void CMasternodeMan::CheckAndRemove(CConnman& connman)
             }
         }
     }
-    {
+    // the remaining maps are swept once per pass over the masternode list
+    if(fSweepDone) {
         // no need for cm_main below
         LOCK(cs);
 
@@ -353,6 +377,8 @@ void CMasternodeMan::Clear()
     mapSeenMasternodePing.clear();
     nDsqCount = 0;
     nLastWatchdogVoteTime = 0;
+    outpointCleanupNext.SetNull();
+    nListVersion++;
 }
 
 int CMasternodeMan::CountMasternodes(int nProtocolVersion)
@@ -421,6 +447,43 @@ void CMasternodeMan::DsegUpdate(CNode* pnode, CConnman& connman)
     LogPrint("masternode", "CMasternodeMan::DsegUpdate -- asked %s for the list\n", pnode->addr.ToString());
 }
 
+CMasternodeMan::dseg_snapshot_sptr CMasternodeMan::GetDsegSnapshot()
+{
+    LOCK(csDsegSnapshot);
+
+    if(dsegSnapshot && dsegSnapshot->nListVersion == nListVersion &&
+        GetTime() - dsegSnapshot->nTimeCreated < DSEG_SNAPSHOT_SECONDS) {
+        return dsegSnapshot;
+    }
+
+    boost::shared_ptr<CDsegSnapshot> snapshot(new CDsegSnapshot());
+    {
+        LOCK(cs);
+        snapshot->nListVersion = nListVersion;
+        snapshot->nTimeCreated = GetTime();
+        snapshot->vecInv.reserve(mapMasternodes.size());
+
+        for (auto& mnpair : mapMasternodes) {
+            if (mnpair.second.addr.IsRFC1918() || mnpair.second.addr.IsLocal()) continue; // do not send local network masternode
+            if (mnpair.second.IsUpdateRequired()) continue; // do not send outdated masternodes
+
+            CMasternodeBroadcast mnb = CMasternodeBroadcast(mnpair.second);
+            const CMasternodePing& mnp = mnpair.second.lastPing;
+            uint256 hashMNB = mnb.GetHash();
+            uint256 hashMNP = mnp.GetHash();
+            snapshot->vecInv.push_back(std::make_pair(CInv(MSG_MASTERNODE_ANNOUNCE, hashMNB), CInv(MSG_MASTERNODE_PING, hashMNP)));
+
+            // so that we can answer getdata for everything we announce
+            mapSeenMasternodeBroadcast.insert(std::make_pair(hashMNB, std::make_pair(GetTime(), mnb)));
+            mapSeenMasternodePing.insert(std::make_pair(hashMNP, mnp));
+        }
+    }
+
+    LogPrint("masternode", "CMasternodeMan::GetDsegSnapshot -- rebuilt, version=%d, entries=%d\n", snapshot->nListVersion, (int)snapshot->vecInv.size());
+    dsegSnapshot = snapshot;
+    return dsegSnapshot;
+}
+
 CMasternode* CMasternodeMan::Find(const COutPoint &outpoint)
 {
     LOCK(cs);
@@ -825,13 +888,12 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
 
         LogPrint("masternode", "DSEG -- Masternode list, masternode=%s\n", vin.prevout.ToStringShort());
 
-        LOCK(cs);
-
         if(vin == CTxIn()) { //only should ask for this once
             //local network
             bool isLocal = (pfrom->addr.IsRFC1918() || pfrom->addr.IsLocal());
 
             if(!isLocal && Params().NetworkIDString() == CBaseChainParams::MAIN) {
+                LOCK(cs);
                 std::map<CNetAddr, int64_t>::iterator it = mAskedUsForMasternodeList.find(pfrom->addr);
                 if (it != mAskedUsForMasternodeList.end() && it->second > GetTime()) {
                     Misbehaving(pfrom->GetId(), 34);
@@ -841,38 +903,41 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
                 int64_t askAgain = GetTime() + DSEG_UPDATE_SECONDS;
                 mAskedUsForMasternodeList[pfrom->addr] = askAgain;
             }
-        } //else, asking for a specific node which is ok
 
-        int nInvCount = 0;
+            // Peers syncing at the same time share one snapshot instead of
+            // rebuilding and rehashing every mnb and mnp under cs each time
+            dseg_snapshot_sptr snapshot = GetDsegSnapshot();
+            for (const auto& invpair : snapshot->vecInv) {
+                pfrom->PushInventory(invpair.first);
+                pfrom->PushInventory(invpair.second);
+            }
+
+            int nInvCount = snapshot->vecInv.size();
+            connman.PushMessage(pfrom, NetMsgType::SYNCSTATUSCOUNT, MASTERNODE_SYNC_LIST, nInvCount);
+            LogPrintf("DSEG -- Sent %d Masternode invs to peer %d\n", nInvCount, pfrom->id);
+            return;
+        }
 
-        for (auto& mnpair : mapMasternodes) {
-            if (vin != CTxIn() && vin != mnpair.second.vin) continue; // asked for specific vin but we are not there yet
-            if (mnpair.second.addr.IsRFC1918() || mnpair.second.addr.IsLocal()) continue; // do not send local network masternode
-            if (mnpair.second.IsUpdateRequired()) continue; // do not send outdated masternodes
+        // asking for a specific node which is ok
+        LOCK(cs);
 
-            LogPrint("masternode", "DSEG -- Sending Masternode entry: masternode=%s  addr=%s\n", mnpair.first.ToStringShort(), mnpair.second.addr.ToString());
-            CMasternodeBroadcast mnb = CMasternodeBroadcast(mnpair.second);
-            CMasternodePing mnp = mnpair.second.lastPing;
+        CMasternode* pmn = Find(vin.prevout);
+        if(pmn && !pmn->addr.IsRFC1918() && !pmn->addr.IsLocal() && !pmn->IsUpdateRequired()) {
+            LogPrint("masternode", "DSEG -- Sending Masternode entry: masternode=%s  addr=%s\n", vin.prevout.ToStringShort(), pmn->addr.ToString());
+            CMasternodeBroadcast mnb = CMasternodeBroadcast(*pmn);
+            CMasternodePing mnp = pmn->lastPing;
             uint256 hashMNB = mnb.GetHash();
             uint256 hashMNP = mnp.GetHash();
             pfrom->PushInventory(CInv(MSG_MASTERNODE_ANNOUNCE, hashMNB));
             pfrom->PushInventory(CInv(MSG_MASTERNODE_PING, hashMNP));
-            nInvCount++;
 
             mapSeenMasternodeBroadcast.insert(std::make_pair(hashMNB, std::make_pair(GetTime(), mnb)));
             mapSeenMasternodePing.insert(std::make_pair(hashMNP, mnp));
 
-            if (vin.prevout == mnpair.first) {
-                LogPrintf("DSEG -- Sent 1 Masternode inv to peer %d\n", pfrom->id);
-                return;
-            }
-        }
-
-        if(vin == CTxIn()) {
-            connman.PushMessage(pfrom, NetMsgType::SYNCSTATUSCOUNT, MASTERNODE_SYNC_LIST, nInvCount);
-            LogPrintf("DSEG -- Sent %d Masternode invs to peer %d\n", nInvCount, pfrom->id);
+            LogPrintf("DSEG -- Sent 1 Masternode inv to peer %d\n", pfrom->id);
             return;
         }
+
         // smth weird happen - someone asked us for vin we have no idea about?
         LogPrint("masternode", "DSEG -- No invs sent to peer %d\n", pfrom->id);
 
@@ -1345,6 +1410,7 @@ void CMasternodeMan::UpdateMasternodeList(CMasternodeBroadcast mnb, CConnman& co
         if(pmn->UpdateFromNewBroadcast(mnb, connman)) {
             masternodeSync.BumpAssetLastTime("CMasternodeMan::UpdateMasternodeList - seen");
             mapSeenMasternodeBroadcast.erase(mnbOld.GetHash());
+            nListVersion++;
         }
     }
 }
@@ -1410,6 +1476,7 @@ bool CMasternodeMan::CheckMnbAndUpdateMasternodeList(CNode* pfrom, CMasternodeBr
             }
             if(hash != mnbOld.GetHash()) {
                 mapSeenMasternodeBroadcast.erase(mnbOld.GetHash());
+                nListVersion++;
             }
             return true;
         }
@@ -1554,6 +1621,48 @@ void CMasternodeMan::UpdatedBlockTip(const CBlockIndex *pindex)
     }
 }
 
+void CMasternodeMan::BlockConnected(const CBlock& block)
+{
+    LOCK(cs);
+
+    if(mapMasternodes.empty()) return;
+
+    for (const auto& tx : block.vtx) {
+        if(tx.IsCoinBase()) continue;
+        for (const auto& txin : tx.vin) {
+            std::map<COutPoint, CMasternode>::iterator it = mapMasternodes.find(txin.prevout);
+            if(it == mapMasternodes.end()) continue;
+            LogPrint("masternode", "CMasternodeMan::BlockConnected -- collateral spent by tx %s, masternode=%s\n", tx.GetHash().ToString(), it->first.ToStringShort());
+            it->second.SetCollateralSpent();
+        }
+    }
+}
+
+void CMasternodeMan::BlockDisconnected(const CBlock& block)
+{
+    LOCK(cs);
+
+    if(mapMasternodes.empty()) return;
+
+    for (const auto& tx : block.vtx) {
+        // outputs of this tx are gone from the UTXO set now ...
+        uint256 hash = tx.GetHash();
+        std::map<COutPoint, CMasternode>::iterator it = mapMasternodes.lower_bound(COutPoint(hash, 0));
+        for (; it != mapMasternodes.end() && it->first.hash == hash; ++it) {
+            LogPrint("masternode", "CMasternodeMan::BlockDisconnected -- collateral tx disconnected, masternode=%s\n", it->first.ToStringShort());
+            it->second.RecheckCollateral();
+        }
+        if(tx.IsCoinBase()) continue;
+        // ... while the outputs it spent are back
+        for (const auto& txin : tx.vin) {
+            it = mapMasternodes.find(txin.prevout);
+            if(it == mapMasternodes.end()) continue;
+            LogPrint("masternode", "CMasternodeMan::BlockDisconnected -- collateral unspent again, masternode=%s\n", it->first.ToStringShort());
+            it->second.RecheckCollateral();
+        }
+    }
+}
+
 void CMasternodeMan::NotifyMasternodeUpdates(CConnman& connman)
 {
     // Avoid double locking
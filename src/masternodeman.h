@@ -9,6 +9,10 @@
 #include "masternode.h"
 #include "sync.h"
 
+#include <atomic>
+
+#include <boost/shared_ptr.hpp>
+
 using namespace std;
 
 class CMasternodeMan;
@@ -16,6 +20,9 @@ class CConnman;
 
 extern CMasternodeMan mnodeman;
 
+//! how many masternodes CheckAndRemove looks at per call when it runs in slices
+static const int MNODEMAN_CLEANUP_SLICE_SIZE = 500;
+
 class CMasternodeMan
 {
 public:
@@ -28,6 +35,7 @@ private:
     static const std::string SERIALIZATION_VERSION_STRING;
 
     static const int DSEG_UPDATE_SECONDS        = 3 * 60 * 60;
+    static const int DSEG_SNAPSHOT_SECONDS      = 60;
 
     static const int LAST_PAID_SCAN_BLOCKS      = 100;
 
@@ -49,6 +57,9 @@ private:
     // Keep track of current block height
     int nCachedBlockHeight;
 
+    // Masternode CheckAndRemove continues from when it runs in slices
+    COutPoint outpointCleanupNext;
+
     // map to hold all MNs
     std::map<COutPoint, CMasternode> mapMasternodes;
     // who's asked for the Masternode list and the last time
@@ -75,6 +86,26 @@ private:
 
     int64_t nLastWatchdogVoteTime;
 
+    /// Inventory of a full DSEG reply, built once and shared by every peer asking for the list
+    struct CDsegSnapshot
+    {
+        int nListVersion;
+        int64_t nTimeCreated;
+        // mnb and mnp invs of every masternode we announce
+        std::vector<std::pair<CInv, CInv> > vecInv;
+    };
+    typedef boost::shared_ptr<const CDsegSnapshot> dseg_snapshot_sptr;
+
+    /// Bumped under cs whenever masternodes are added, removed or replaced by a new broadcast
+    std::atomic<int> nListVersion;
+
+    // protects dsegSnapshot, must be taken before cs
+    CCriticalSection csDsegSnapshot;
+    dseg_snapshot_sptr dsegSnapshot;
+
+    /// Return the current DSEG snapshot, rebuilding it if the list changed or it got too old
+    dseg_snapshot_sptr GetDsegSnapshot();
+
     friend class CMasternodeSync;
     /// Find an entry
     CMasternode* Find(const COutPoint& outpoint);
@@ -138,8 +169,8 @@ public:
     /// Check all Masternodes
     void Check();
 
-    /// Check all Masternodes and remove inactive
-    void CheckAndRemove(CConnman& connman);
+    /// Check all Masternodes and remove inactive, with nMaxMasternodes > 0 only that many per call
+    void CheckAndRemove(CConnman& connman, int nMaxMasternodes = 0);
     /// This is dummy overload to be used for dumping/loading mncache.dat
     void CheckAndRemove() {}
 
@@ -230,6 +261,11 @@ public:
 
     void UpdatedBlockTip(const CBlockIndex *pindex);
 
+    /// Mark masternodes whose collateral is spent by the block
+    void BlockConnected(const CBlock& block);
+    /// Recheck masternodes whose collateral was created or spent by the block
+    void BlockDisconnected(const CBlock& block);
+
     /**
      * Called to notify CGovernanceManager that the masternode index has been updated.
      * Must be called while not holding the CMasternodeMan::cs mutex
@@ -10,6 +10,7 @@
 #include "init.h"
 #include "masternode-sync.h"
 #include "masternodeman.h"
+#include "policy/policy.h"
 #include "script/interpreter.h"
 #include "txmempool.h"
 #include "util.h"
@@ -254,6 +255,12 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, std::string& strCommand, C
         int nTxInIndex = 0;
         int nTxInsCount = (int)vecTxIn.size();
 
+        if(!IsInputScriptSigsValid(vecTxIn)) {
+            LogPrint("privatesend", "DSSIGNFINALTX -- IsInputScriptSigsValid() failed, session: %d\n", nSessionID);
+            RelayStatus(STATUS_REJECTED, connman);
+            return;
+        }
+
         BOOST_FOREACH(const CTxIn txin, vecTxIn) {
             nTxInIndex++;
             if(!AddScriptSig(txin)) {
@@ -535,45 +542,58 @@ void CPrivateSendServer::CheckForCompleteQueue(CConnman& connman)
 }
 
 // Check to make sure a given input matches an input in the pool and its scriptSig is valid
-bool CPrivateSendServer::IsInputScriptSigValid(const CTxIn& txin)
+bool CPrivateSendServer::IsInputScriptSigsValid(const std::vector<CTxIn>& vecTxIn)
 {
-    CMutableTransaction txNew;
-    txNew.vin.clear();
-    txNew.vout.clear();
-
-    int i = 0;
-    int nTxInIndex = -1;
-    CScript sigPubKey = CScript();
-
-    BOOST_FOREACH(CDarkSendEntry& entry, vecEntries) {
+    // Clients sign the final transaction, so verify against it. Signature hashes
+    // don't cover scriptSigs, so the other inputs being unsigned yet doesn't matter.
+    CMutableTransaction txNew = finalMutableTransaction;
+    std::vector<std::pair<unsigned int, CScript> > vecInputs; // input index - prevPubKey
 
-        for (const auto& txout : entry.vecTxOut)
-            txNew.vout.push_back(txout);
-
-        BOOST_FOREACH(const CTxDSIn& txdsin, entry.vecTxDSIn) {
-            txNew.vin.push_back(txdsin);
+    BOOST_FOREACH(const CTxIn& txin, vecTxIn) {
+        int nTxInIndex = -1;
+        CScript sigPubKey = CScript();
 
-            if(txdsin.prevout == txin.prevout) {
+        BOOST_FOREACH(const CDarkSendEntry& entry, vecEntries) {
+            BOOST_FOREACH(const CTxDSIn& txdsin, entry.vecTxDSIn) {
+                if(txdsin.prevout == txin.prevout) {
+                    sigPubKey = txdsin.prevPubKey;
+                }
+            }
+        }
+        for(unsigned int i = 0; i < txNew.vin.size(); i++) {
+            if(txNew.vin[i].prevout == txin.prevout && txNew.vin[i].nSequence == txin.nSequence) {
                 nTxInIndex = i;
-                sigPubKey = txdsin.prevPubKey;
+                break;
             }
-            i++;
         }
-    }
 
-    if(nTxInIndex >= 0) { //might have to do this one input at a time?
-        txNew.vin[nTxInIndex].scriptSig = txin.scriptSig;
-        LogPrint("privatesend", "CPrivateSendServer::IsInputScriptSigValid -- verifying scriptSig %s\n", ScriptToAsmStr(txin.scriptSig).substr(0,24));
-        if(!VerifyScript(txNew.vin[nTxInIndex].scriptSig, sigPubKey, SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC, MutableTransactionSignatureChecker(&txNew, nTxInIndex))) {
-            LogPrint("privatesend", "CPrivateSendServer::IsInputScriptSigValid -- VerifyScript() failed on input %d\n", nTxInIndex);
+        if(nTxInIndex < 0 || sigPubKey.empty()) {
+            LogPrint("privatesend", "CPrivateSendServer::IsInputScriptSigsValid -- Failed to find matching input in pool, %s\n", txin.ToString());
             return false;
         }
-    } else {
-        LogPrint("privatesend", "CPrivateSendServer::IsInputScriptSigValid -- Failed to find matching input in pool, %s\n", txin.ToString());
+
+        txNew.vin[nTxInIndex].scriptSig = txin.scriptSig;
+        vecInputs.push_back(std::make_pair(nTxInIndex, sigPubKey));
+    }
+
+    // Verify all inputs at once on the script check threads. Valid signatures are
+    // stored in the signature cache, so AcceptToMemoryPool() of the final transaction
+    // in CommitFinalTransaction() doesn't verify them again.
+    const CTransaction txFinal(txNew);
+    std::vector<CScriptCheck> vChecks;
+    for(unsigned int i = 0; i < vecInputs.size(); i++) {
+        vChecks.push_back(CScriptCheck());
+        CScriptCheck check(vecInputs[i].second, 0, txFinal, vecInputs[i].first, STANDARD_SCRIPT_VERIFY_FLAGS, true);
+        check.swap(vChecks.back());
+    }
+
+    LogPrint("privatesend", "CPrivateSendServer::IsInputScriptSigsValid -- verifying %d scriptSigs\n", (int)vChecks.size());
+    if(!RunScriptChecks(vChecks)) {
+        LogPrint("privatesend", "CPrivateSendServer::IsInputScriptSigsValid -- script verification failed\n");
         return false;
     }
 
-    LogPrint("privatesend", "CPrivateSendServer::IsInputScriptSigValid -- Successfully validated input and scriptSig\n");
+    LogPrint("privatesend", "CPrivateSendServer::IsInputScriptSigsValid -- Successfully validated inputs and scriptSigs\n");
     return true;
 }
 
@@ -639,11 +659,6 @@ bool CPrivateSendServer::AddScriptSig(const CTxIn& txinNew)
         }
     }
 
-    if(!IsInputScriptSigValid(txinNew)) {
-        LogPrint("privatesend", "CPrivateSendServer::AddScriptSig -- Invalid scriptSig\n");
-        return false;
-    }
-
     LogPrint("privatesend", "CPrivateSendServer::AddScriptSig -- scriptSig=%s new\n", ScriptToAsmStr(txinNew.scriptSig).substr(0,24));
 
     BOOST_FOREACH(CTxIn& txin, finalMutableTransaction.vin) {
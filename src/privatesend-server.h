@@ -27,7 +27,7 @@ private:
 
     /// Add a clients entry to the pool
     bool AddEntry(const CDarkSendEntry& entryNew, PoolMessage& nMessageIDRet);
-    /// Add signature to a txin
+    /// Add signature to a txin, the signature must have been checked with IsInputScriptSigsValid
     bool AddScriptSig(const CTxIn& txin);
 
     /// Charge fees to bad actors (Charge clients a fee if they're abusive)
@@ -50,8 +50,8 @@ private:
 
     /// Check that all inputs are signed. (Are all inputs signed?)
     bool IsSignaturesComplete();
-    /// Check to make sure a given input matches an input in the pool and its scriptSig is valid
-    bool IsInputScriptSigValid(const CTxIn& txin);
+    /// Check to make sure given inputs match inputs in the pool and their scriptSigs are valid
+    bool IsInputScriptSigsValid(const std::vector<CTxIn>& vecTxIn);
     /// Are these outputs compatible with other client in the pool?
     bool IsOutputsCompatibleWithSessionDenom(const std::vector<CTxOut>& vecTxOut);
 
@@ -361,6 +361,4 @@ public:
     static void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
 };
 
-void ThreadCheckPrivateSend(CConnman& connman);
-
 #endif
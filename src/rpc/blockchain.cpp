@@ -11,6 +11,7 @@
 #include "checkpoints.h"
 #include "coins.h"
 #include "consensus/validation.h"
+#include "indexbuilder.h"
 #include "validation.h"
 #include "policy/policy.h"
 #include "primitives/transaction.h"
@@ -1128,3 +1129,64 @@ UniValue reconsiderblock(const UniValue& params, bool fHelp)
 
     return NullUniValue;
 }
+
+UniValue getindexbuildinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getindexbuildinfo\n"
+            "\nReturns the progress of building the address, spent and timestamp indexes for an existing chain.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"addressindex\": true|false,   (boolean) Whether the address index is available\n"
+            "  \"spentindex\": true|false,     (boolean) Whether the spent index is available\n"
+            "  \"timestampindex\": true|false, (boolean) Whether the timestamp index is available\n"
+            "  \"building\": [\"name\",...],    (array) The indexes being built or left unfinished\n"
+            "  \"active\": true|false,         (boolean) Whether the build is running\n"
+            "  \"height\": xxxxx,              (numeric) The last block height the indexes were built for\n"
+            "  \"blocks\": xxxxx,              (numeric) The current number of blocks processed in the server\n"
+            "  \"progress\": xxx.xxx,          (numeric) Fraction of the chain indexed\n"
+            "  \"blockspersecond\": xxx.xxx,   (numeric) Blocks indexed per second since the build started\n"
+            "  \"error\": \"xxxx\"              (string, optional) Why the build stopped\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getindexbuildinfo", "")
+            + HelpExampleRpc("getindexbuildinfo", "")
+        );
+
+    int nIndexes, nHeight, nStartHeight;
+    bool fActive;
+    int64_t nStartTime;
+    std::string strError;
+    indexBuilder.GetStatus(nIndexes, fActive, nHeight, nStartHeight, nStartTime, strError);
+
+    LOCK(cs_main);
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("addressindex", fAddressIndex));
+    obj.push_back(Pair("spentindex", fSpentIndex));
+    obj.push_back(Pair("timestampindex", fTimestampIndex));
+
+    UniValue building(UniValue::VARR);
+    if (nIndexes & BUILD_ADDRESSINDEX && !fAddressIndex)
+        building.push_back("addressindex");
+    if (nIndexes & BUILD_SPENTINDEX && !fSpentIndex)
+        building.push_back("spentindex");
+    if (nIndexes & BUILD_TIMESTAMPINDEX && !fTimestampIndex)
+        building.push_back("timestampindex");
+    obj.push_back(Pair("building", building));
+    obj.push_back(Pair("active", fActive));
+
+    if (!building.empty()) {
+        int nBlocks = chainActive.Height();
+        int64_t nElapsed = GetTime() - nStartTime;
+        obj.push_back(Pair("height", nHeight));
+        obj.push_back(Pair("blocks", nBlocks));
+        obj.push_back(Pair("progress", nBlocks > 0 ? std::min(1.0, (double)nHeight / nBlocks) : 1.0));
+        obj.push_back(Pair("blockspersecond", nElapsed > 0 ? (double)(nHeight - nStartHeight) / nElapsed : 0.0));
+    }
+    if (!strError.empty())
+        obj.push_back(Pair("error", strError));
+
+    return obj;
+}
@@ -21,6 +21,8 @@
 #include "wallet/walletdb.h"
 #endif
 
+#include "instantx.h"
+#include "maintenance.h"
 #include "masternode-sync.h"
 #include "spork.h"
 
@@ -28,6 +30,7 @@
 
 #include <boost/assign/list_of.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
 
 #include <univalue.h>
 
@@ -181,6 +184,142 @@ UniValue mnsync(const UniValue& params, bool fHelp)
     return "failure";
 }
 
+UniValue getmaintenanceinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getmaintenanceinfo\n"
+            "Returns runtime statistics of the periodic masternode, governance and InstantSend maintenance tasks.\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"name\": \"xxxx\",         (string) The task name\n"
+            "    \"interval\": n,          (numeric) Seconds between runs, not counting jitter\n"
+            "    \"runs\": n,              (numeric) How many times the task ran\n"
+            "    \"lastrun\": ttt,         (numeric) The time of the last run in seconds since epoch (Jan 1 1970 GMT)\n"
+            "    \"lastms\": x.xxx,        (numeric) Duration of the last run in milliseconds\n"
+            "    \"avgms\": x.xxx,         (numeric) Average duration in milliseconds\n"
+            "    \"maxms\": x.xxx          (numeric) Longest duration in milliseconds\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getmaintenanceinfo", "")
+            + HelpExampleRpc("getmaintenanceinfo", "")
+        );
+
+    UniValue ret(UniValue::VARR);
+    BOOST_FOREACH(const CMaintenanceTaskStats& stats, maintenanceScheduler.GetStats()) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("name", stats.strName));
+        obj.push_back(Pair("interval", stats.nInterval));
+        obj.push_back(Pair("runs", stats.nRuns));
+        obj.push_back(Pair("lastrun", stats.nTimeLastRun));
+        obj.push_back(Pair("lastms", stats.nLastMicros * 0.001));
+        obj.push_back(Pair("avgms", stats.nRuns > 0 ? stats.nTotalMicros * 0.001 / stats.nRuns : 0.0));
+        obj.push_back(Pair("maxms", stats.nMaxMicros * 0.001));
+        ret.push_back(obj);
+    }
+    return ret;
+}
+
+UniValue getinstantsendinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1)
+        throw runtime_error(
+            "getinstantsendinfo ( \"txid\" )\n"
+            "Returns statistics of InstantSend lock vote processing.\n"
+            "\nArguments:\n"
+            "1. \"txid\"   (string, optional) Return the stage timestamps of this transaction lock instead\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"votesqueued\": n,        (numeric) Lock votes received and queued for validation\n"
+            "  \"votesdropped\": n,       (numeric) Lock votes dropped because the queue was full\n"
+            "  \"votesinvalid\": n,       (numeric) Queued lock votes that failed validation\n"
+            "  \"votesprocessed\": n,     (numeric) Valid lock votes applied\n"
+            "  \"queuesize\": n,          (numeric) Lock votes currently waiting for validation\n"
+            "  \"queuesizemax\": n,       (numeric) Largest number of lock votes waiting at once\n"
+            "  \"batches\": n,            (numeric) How many batches of votes were processed\n"
+            "  \"csmainavgms\": x.xxx,    (numeric) Average time cs_main was held per batch in milliseconds\n"
+            "  \"csmainmaxms\": x.xxx,    (numeric) Longest time cs_main was held for a batch in milliseconds\n"
+            "  \"lockscompleted\": n,     (numeric) Transaction locks completed\n"
+            "  \"lockavgms\": x.xxx,      (numeric) Average time from the first lock request or vote to lock completion in milliseconds\n"
+            "  \"lockmaxms\": x.xxx,      (numeric) Longest time from the first lock request or vote to lock completion in milliseconds\n"
+            "  \"trace\": {               (json object) Latency histograms per processing stage\n"
+            "    \"stage\": {             (json object) Stage name (mempool, rank, signature, relay, finalize, firstvote, ready, lock)\n"
+            "      \"count\": n,          (numeric) Number of samples\n"
+            "      \"avgms\": x.xxx,      (numeric) Average in milliseconds\n"
+            "      \"p50ms\": x.xxx,      (numeric) Median in milliseconds\n"
+            "      \"p99ms\": x.xxx,      (numeric) 99th percentile in milliseconds\n"
+            "      \"maxms\": x.xxx       (numeric) Maximum in milliseconds\n"
+            "    }, ...\n"
+            "  }\n"
+            "}\n"
+            "\nResult (for txid):\n"
+            "{\n"
+            "  \"txid\": \"hash\",          (string) The transaction id\n"
+            "  \"request\": n,            (numeric) Time the lock request was received in microseconds since epoch, 0 if not seen\n"
+            "  \"acceptedms\": x.xxx,     (numeric) Milliseconds from the request to mempool acceptance\n"
+            "  \"firstvotems\": x.xxx,    (numeric) Milliseconds from the request to the first vote\n"
+            "  \"readyms\": x.xxx,        (numeric) Milliseconds from the request to all inputs having enough votes\n"
+            "  \"lockedms\": x.xxx        (numeric) Milliseconds from the request to the lock\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getinstantsendinfo", "")
+            + HelpExampleCli("getinstantsendinfo", "\"txid\"")
+            + HelpExampleRpc("getinstantsendinfo", "")
+        );
+
+    if (params.size() == 1) {
+        uint256 txHash = ParseHashV(params[0], "txid");
+        CTxLockTrace trace;
+        if (!instantsend.GetTxLockTrace(txHash, trace))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No InstantSend lock candidate for this transaction");
+
+        // stages are reported relative to the lock request, or the first vote if the request was not seen
+        int64_t nTimeStart = trace.nTimeRequest > 0 ? trace.nTimeRequest : trace.nTimeFirstVote;
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("txid", txHash.GetHex()));
+        obj.push_back(Pair("request", trace.nTimeRequest));
+        obj.push_back(Pair("acceptedms", trace.nTimeAccepted > 0 ? (trace.nTimeAccepted - nTimeStart) * 0.001 : 0.0));
+        obj.push_back(Pair("firstvotems", trace.nTimeFirstVote > 0 ? (trace.nTimeFirstVote - nTimeStart) * 0.001 : 0.0));
+        obj.push_back(Pair("readyms", trace.nTimeReady > 0 ? (trace.nTimeReady - nTimeStart) * 0.001 : 0.0));
+        obj.push_back(Pair("lockedms", trace.nTimeLocked > 0 ? (trace.nTimeLocked - nTimeStart) * 0.001 : 0.0));
+        return obj;
+    }
+
+    CInstantSendVoteStats stats = instantsend.GetVoteStats();
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("votesqueued", stats.nVotesQueued));
+    obj.push_back(Pair("votesdropped", stats.nVotesDropped));
+    obj.push_back(Pair("votesinvalid", stats.nVotesInvalid));
+    obj.push_back(Pair("votesprocessed", stats.nVotesProcessed));
+    obj.push_back(Pair("queuesize", (uint64_t)stats.nQueueSize));
+    obj.push_back(Pair("queuesizemax", (uint64_t)stats.nQueueSizeMax));
+    obj.push_back(Pair("batches", stats.nBatches));
+    obj.push_back(Pair("csmainavgms", stats.nBatches > 0 ? stats.nMainLockMicrosTotal * 0.001 / stats.nBatches : 0.0));
+    obj.push_back(Pair("csmainmaxms", stats.nMainLockMicrosMax * 0.001));
+    obj.push_back(Pair("lockscompleted", stats.nLocksCompleted));
+    obj.push_back(Pair("lockavgms", stats.nLocksCompleted > 0 ? stats.nLockLatencyMicrosTotal * 0.001 / stats.nLocksCompleted : 0.0));
+    obj.push_back(Pair("lockmaxms", stats.nLockLatencyMicrosMax * 0.001));
+
+    std::vector<CLatencyHistogram> vecHist = instantsend.GetTraceHistograms();
+    UniValue trace(UniValue::VOBJ);
+    for (int i = 0; i < (int)vecHist.size(); i++) {
+        const CLatencyHistogram& hist = vecHist[i];
+        UniValue stage(UniValue::VOBJ);
+        stage.push_back(Pair("count", hist.GetCount()));
+        stage.push_back(Pair("avgms", hist.GetCount() > 0 ? hist.GetTotal() * 0.001 / hist.GetCount() : 0.0));
+        stage.push_back(Pair("p50ms", hist.GetPercentile(50) * 0.001));
+        stage.push_back(Pair("p99ms", hist.GetPercentile(99) * 0.001));
+        stage.push_back(Pair("maxms", hist.GetMax() * 0.001));
+        trace.push_back(Pair(GetInstantSendTraceStageName(i), stage));
+    }
+    obj.push_back(Pair("trace", trace));
+    return obj;
+}
+
 #ifdef ENABLE_WALLET
 class DescribeAddressVisitor : public boost::static_visitor<UniValue>
 {
@@ -590,6 +729,146 @@ bool timestampSort(std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> a,
     return a.second.time < b.second.time;
 }
 
+bool collectAddressUnspent(std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > *unspentOutputs,
+                           const CAddressUnspentKey &key, const CAddressUnspentValue &value)
+{
+    unspentOutputs->push_back(std::make_pair(key, value));
+    return true;
+}
+
+bool pushAddressDelta(UniValue *result, const CAddressIndexKey &key, CAmount amount)
+{
+    std::string address;
+    if (!getAddressFromIndex(key.type, key.hashBytes, address)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
+    }
+
+    UniValue delta(UniValue::VOBJ);
+    delta.push_back(Pair("satoshis", amount));
+    delta.push_back(Pair("txid", key.txhash.GetHex()));
+    delta.push_back(Pair("index", (int)key.index));
+    delta.push_back(Pair("blockindex", (int)key.txindex));
+    delta.push_back(Pair("height", key.blockHeight));
+    delta.push_back(Pair("address", address));
+    result->push_back(delta);
+    return true;
+}
+
+bool collectAddressTxid(std::set<std::pair<int, std::string> > *txids, UniValue *result,
+                        const CAddressIndexKey &key, CAmount amount)
+{
+    std::string txid = key.txhash.GetHex();
+    if (txids->insert(std::make_pair(key.blockHeight, txid)).second && result) {
+        result->push_back(txid);
+    }
+    return true;
+}
+
+/**
+ * Hands out one page of address index entries. When only txids are wanted the
+ * adjacent entries of one transaction count as a single item.
+ */
+class CAddressIndexPager
+{
+private:
+    UniValue &result;
+    bool fTxids;
+    size_t nOffset;
+    size_t nLimit;
+    size_t nSkipped;
+    size_t nEmitted;
+    bool fMore;
+    bool fHaveLast;
+    CAddressIndexKey keyLast;
+
+public:
+    CAddressIndexPager(UniValue &resultIn, bool fTxidsIn, size_t nOffsetIn, size_t nLimitIn) :
+        result(resultIn), fTxids(fTxidsIn), nOffset(nOffsetIn), nLimit(nLimitIn),
+        nSkipped(0), nEmitted(0), fMore(false), fHaveLast(false) {}
+
+    bool operator()(const CAddressIndexKey &key, CAmount amount)
+    {
+        bool fNewItem = !fTxids || !fHaveLast || key.txhash != keyLast.txhash || key.hashBytes != keyLast.hashBytes;
+        if (fNewItem) {
+            if (nLimit > 0 && nEmitted == nLimit) {
+                // One more item exists past this page
+                fMore = true;
+                return false;
+            }
+            if (nSkipped < nOffset) {
+                nSkipped++;
+            } else if (fTxids) {
+                result.push_back(key.txhash.GetHex());
+                nEmitted++;
+            } else {
+                pushAddressDelta(&result, key, amount);
+                nEmitted++;
+            }
+        }
+        keyLast = key;
+        fHaveLast = true;
+        return true;
+    }
+
+    /** Continuation token for the next page, or null when this was the last page */
+    UniValue GetCursor() const
+    {
+        if (!fMore)
+            return NullUniValue;
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey << keyLast;
+        return HexStr(ssKey.begin(), ssKey.end());
+    }
+};
+
+/** Parse the optional reverse/offset/limit/cursor paging fields. Returns true if a page (rather than the full history) was requested. */
+bool getAddressPagingFromParams(const UniValue& params, bool &fReverse, size_t &nOffset, size_t &nLimit,
+                                bool &fResume, CAddressIndexKey &keyResume)
+{
+    fReverse = false;
+    nOffset = 0;
+    nLimit = 0;
+    fResume = false;
+    if (!params[0].isObject()) {
+        return false;
+    }
+
+    UniValue reverseValue = find_value(params[0].get_obj(), "reverse");
+    UniValue offsetValue = find_value(params[0].get_obj(), "offset");
+    UniValue limitValue = find_value(params[0].get_obj(), "limit");
+    UniValue cursorValue = find_value(params[0].get_obj(), "cursor");
+
+    if (reverseValue.isBool()) {
+        fReverse = reverseValue.get_bool();
+    }
+    if (offsetValue.isNum()) {
+        if (offsetValue.get_int() < 0) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Offset must be non-negative");
+        }
+        nOffset = offsetValue.get_int();
+    }
+    if (limitValue.isNum()) {
+        if (limitValue.get_int() <= 0) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Limit must be positive");
+        }
+        nLimit = limitValue.get_int();
+    }
+    if (cursorValue.isStr()) {
+        if (!IsHex(cursorValue.get_str())) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+        }
+        CDataStream ssKey(ParseHex(cursorValue.get_str()), SER_DISK, CLIENT_VERSION);
+        try {
+            ssKey >> keyResume;
+        } catch (const std::exception&) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+        }
+        fResume = true;
+    }
+
+    return nLimit > 0 || fResume;
+}
+
 UniValue getaddressmempool(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -699,10 +978,8 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
 
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressUnspent((*it).first, (*it).second, unspentOutputs)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-        }
+    if (!GetAddressUnspent(addresses, boost::bind(collectAddressUnspent, &unspentOutputs, _1, _2))) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
     }
 
     std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
@@ -743,8 +1020,13 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
             "    ]\n"
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
+            "  \"reverse\" (boolean, optional) Return the newest changes first\n"
+            "  \"limit\" (number, optional) Return a single page of at most this many changes\n"
+            "  \"offset\" (number, optional) Skip this many changes first\n"
+            "  \"cursor\" (string, optional) Continue after the page that returned this cursor\n"
             "}\n"
-            "\nResult:\n"
+            "\nResult (when a limit or cursor is given the array is returned as \"deltas\" in an object\n"
+            "together with \"cursor\", which is null on the last page):\n"
             "[\n"
             "  {\n"
             "    \"satoshis\"  (number) The difference of pips\n"
@@ -781,36 +1063,23 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        }
-    }
+    bool fReverse, fResume;
+    size_t nOffset, nLimit;
+    CAddressIndexKey keyResume;
+    bool fPaged = getAddressPagingFromParams(params, fReverse, nOffset, nLimit, fResume, keyResume);
 
     UniValue result(UniValue::VARR);
+    CAddressIndexPager pager(result, false, nOffset, nLimit);
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        std::string address;
-        if (!getAddressFromIndex(it->first.type, it->first.hashBytes, address)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
-        }
+    if (!GetAddressIndex(addresses, boost::ref(pager), start, end, fReverse, fResume ? &keyResume : NULL)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+    }
 
-        UniValue delta(UniValue::VOBJ);
-        delta.push_back(Pair("satoshis", it->second));
-        delta.push_back(Pair("txid", it->first.txhash.GetHex()));
-        delta.push_back(Pair("index", (int)it->first.index));
-        delta.push_back(Pair("blockindex", (int)it->first.txindex));
-        delta.push_back(Pair("height", it->first.blockHeight));
-        delta.push_back(Pair("address", address));
-        result.push_back(delta);
+    if (fPaged) {
+        UniValue page(UniValue::VOBJ);
+        page.push_back(Pair("deltas", result));
+        page.push_back(Pair("cursor", pager.GetCursor()));
+        return page;
     }
 
     return result;
@@ -834,6 +1103,7 @@ UniValue getaddressbalance(const UniValue& params, bool fHelp)
             "{\n"
             "  \"balance\"  (string) The current balance in pips\n"
             "  \"received\"  (string) The total number of pips received (including change)\n"
+            "  \"txcount\"  (number) The number of transactions involving the address(es), counted once per address\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressbalance", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
@@ -846,27 +1116,27 @@ UniValue getaddressbalance(const UniValue& params, bool fHelp)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-        }
-    }
+    std::sort(addresses.begin(), addresses.end());
+    addresses.erase(std::unique(addresses.begin(), addresses.end()), addresses.end());
 
     CAmount balance = 0;
     CAmount received = 0;
+    int64_t txcount = 0;
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        if (it->second > 0) {
-            received += it->second;
+    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+        CAddressBalanceValue value;
+        if (!GetAddressBalance((*it).first, (*it).second, value)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
-        balance += it->second;
+        balance += value.balance;
+        received += value.received;
+        txcount += value.txCount;
     }
 
     UniValue result(UniValue::VOBJ);
     result.push_back(Pair("balance", balance));
     result.push_back(Pair("received", received));
+    result.push_back(Pair("txcount", txcount));
 
     return result;
 
@@ -887,8 +1157,15 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
             "    ]\n"
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
+            "  \"reverse\" (boolean, optional) Return the newest transactions first\n"
+            "  \"limit\" (number, optional) Return a single page of at most this many txids\n"
+            "  \"offset\" (number, optional) Skip this many txids first\n"
+            "  \"cursor\" (string, optional) Continue after the page that returned this cursor\n"
             "}\n"
-            "\nResult:\n"
+            "\nResult (when a limit or cursor is given the array is returned as \"txids\" in an object\n"
+            "together with \"cursor\", which is null on the last page; with a limit, offset or cursor the\n"
+            "addresses are listed one after another, so a transaction involving several of them is listed\n"
+            "once per address):\n"
             "[\n"
             "  \"transactionid\"  (string) The transaction id\n"
             "  ,...\n"
@@ -915,39 +1192,45 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
         }
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    bool fReverse, fResume;
+    size_t nOffset, nLimit;
+    CAddressIndexKey keyResume;
+    UniValue result(UniValue::VARR);
+
+    bool fPaged = getAddressPagingFromParams(params, fReverse, nOffset, nLimit, fResume, keyResume);
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
+    if (fPaged || nOffset > 0) {
+        CAddressIndexPager pager(result, true, nOffset, nLimit);
+        if (!GetAddressIndex(addresses, boost::ref(pager), start, end, fReverse, fResume ? &keyResume : NULL)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
+
+        if (!fPaged)
+            return result;
+
+        UniValue page(UniValue::VOBJ);
+        page.push_back(Pair("txids", result));
+        page.push_back(Pair("cursor", pager.GetCursor()));
+        return page;
     }
 
     std::set<std::pair<int, std::string> > txids;
-    UniValue result(UniValue::VARR);
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        int height = it->first.blockHeight;
-        std::string txid = it->first.txhash.GetHex();
-
-        if (addresses.size() > 1) {
-            txids.insert(std::make_pair(height, txid));
-        } else {
-            if (txids.insert(std::make_pair(height, txid)).second) {
-                result.push_back(txid);
-            }
-        }
+    // With a single address the index already yields txids in height order, so they can go straight into the result
+    UniValue* presult = addresses.size() > 1 ? NULL : &result;
+    if (!GetAddressIndex(addresses, boost::bind(collectAddressTxid, &txids, presult, _1, _2), start, end, fReverse)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
     }
 
     if (addresses.size() > 1) {
-        for (std::set<std::pair<int, std::string> >::const_iterator it=txids.begin(); it!=txids.end(); it++) {
-            result.push_back(it->second);
+        if (fReverse) {
+            for (std::set<std::pair<int, std::string> >::const_reverse_iterator it=txids.rbegin(); it!=txids.rend(); it++) {
+                result.push_back(it->second);
+            }
+        } else {
+            for (std::set<std::pair<int, std::string> >::const_iterator it=txids.begin(); it!=txids.end(); it++) {
+                result.push_back(it->second);
+            }
         }
     }
 
@@ -309,6 +309,7 @@ static const CRPCCommand vRPCCommands[] =
     { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true  },
     { "blockchain",         "verifychain",            &verifychain,            true  },
     { "blockchain",         "getspentinfo",           &getspentinfo,           false },
+    { "blockchain",         "getindexbuildinfo",      &getindexbuildinfo,      true  },
 
     /* Mining */
     { "mining",             "getblocktemplate",       &getblocktemplate,       true  },
@@ -366,6 +367,8 @@ static const CRPCCommand vRPCCommands[] =
     { "zixx",               "getsuperblockbudget",    &getsuperblockbudget,    true  },
     { "zixx",               "voteraw",                &voteraw,                true  },
     { "zixx",               "mnsync",                 &mnsync,                 true  },
+    { "zixx",               "getmaintenanceinfo",     &getmaintenanceinfo,     true  },
+    { "zixx",               "getinstantsendinfo",     &getinstantsendinfo,     true  },
     { "zixx",               "spork",                  &spork,                  true  },
     { "zixx",               "getpoolinfo",            &getpoolinfo,            true  },
     { "zixx",               "sentinelping",           &sentinelping,           true  },
@@ -391,6 +394,7 @@ static const CRPCCommand vRPCCommands[] =
     { "wallet",             "getreceivedbyaddress",   &getreceivedbyaddress,   false },
     { "wallet",             "gettransaction",         &gettransaction,         false },
     { "wallet",             "abandontransaction",     &abandontransaction,     false },
+    { "wallet",             "abortrescan",            &abortrescan,            true  },
     { "wallet",             "getunconfirmedbalance",  &getunconfirmedbalance,  false },
     { "wallet",             "getwalletinfo",          &getwalletinfo,          false },
     { "wallet",             "importprivkey",          &importprivkey,          true  },
@@ -369,5 +369,39 @@ struct CAddressIndexIteratorHeightKey {
     }
 };
 
+struct CAddressBalanceValue {
+    CAmount balance;
+    CAmount received;
+    uint32_t txCount;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(balance);
+        READWRITE(received);
+        READWRITE(VARINT(txCount));
+    }
+
+    CAddressBalanceValue(CAmount balanceIn, CAmount receivedIn, uint32_t txCountIn) {
+        balance = balanceIn;
+        received = receivedIn;
+        txCount = txCountIn;
+    }
+
+    CAddressBalanceValue() {
+        SetNull();
+    }
+
+    void SetNull() {
+        balance = 0;
+        received = 0;
+        txCount = 0;
+    }
+
+    bool IsNull() const {
+        return (balance == 0 && received == 0 && txCount == 0);
+    }
+};
 
 #endif // BITCOIN_SPENTINDEX_H
@@ -0,0 +1,267 @@
+// Copyright (c) 2018-2018 The Zixx developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "arith_uint256.h"
+#include "indexbuilder.h"
+#include "primitives/block.h"
+#include "txdb.h"
+#include "undo.h"
+#include "uint256.h"
+#include "utilstrencodings.h"
+#include "validation.h"
+
+#include "test/test_zixx.h"
+
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+
+static bool CollectAddressIndex(std::vector<std::pair<CAddressIndexKey, CAmount> > *entries, size_t nLimit,
+                                const CAddressIndexKey &key, CAmount amount)
+{
+    entries->push_back(std::make_pair(key, amount));
+    return nLimit == 0 || entries->size() < nLimit;
+}
+
+static bool CollectAddressUnspent(std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > *entries,
+                                  const CAddressUnspentKey &key, const CAddressUnspentValue &value)
+{
+    entries->push_back(std::make_pair(key, value));
+    return true;
+}
+
+BOOST_FIXTURE_TEST_SUITE(addressindex_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(addressindex_batch_read)
+{
+    uint160 hashA = uint160(ParseHex("1111111111111111111111111111111111111111"));
+    uint160 hashB = uint160(ParseHex("2222222222222222222222222222222222222222"));
+    uint160 hashC = uint160(ParseHex("3333333333333333333333333333333333333333"));
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vIndex;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vUnspent;
+    for (int nHeight = 1; nHeight <= 10; nHeight++) {
+        uint256 txid = ArithToUint256(arith_uint256(nHeight));
+        vIndex.push_back(std::make_pair(CAddressIndexKey(1, hashA, nHeight, 0, txid, 0, false), nHeight * COIN));
+        vIndex.push_back(std::make_pair(CAddressIndexKey(2, hashB, nHeight, 0, txid, 0, false), nHeight));
+        // same hash as A but a different address type must not leak into A's results
+        vIndex.push_back(std::make_pair(CAddressIndexKey(2, hashA, nHeight, 0, txid, 0, false), -1));
+        vUnspent.push_back(std::make_pair(CAddressUnspentKey(1, hashA, txid, 0), CAddressUnspentValue(nHeight, CScript(), nHeight)));
+    }
+    BOOST_CHECK(pblocktree->WriteAddressIndex(vIndex));
+    BOOST_CHECK(pblocktree->UpdateAddressUnspentIndex(vUnspent));
+
+    // Requested out of key order, with a duplicate and an address that has no entries
+    std::vector<std::pair<uint160, int> > addresses;
+    addresses.push_back(std::make_pair(hashB, 2));
+    addresses.push_back(std::make_pair(hashC, 1));
+    addresses.push_back(std::make_pair(hashA, 1));
+    addresses.push_back(std::make_pair(hashB, 2));
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > result;
+    BOOST_CHECK(pblocktree->ReadAddressIndex(addresses, boost::bind(CollectAddressIndex, &result, 0, _1, _2)));
+    BOOST_CHECK_EQUAL(result.size(), 20U);
+    for (size_t i = 0; i < result.size(); i++) {
+        // type 1 sorts before type 2, heights ascend within each address
+        BOOST_CHECK_EQUAL(result[i].first.type, i < 10 ? 1U : 2U);
+        BOOST_CHECK(result[i].first.hashBytes == (i < 10 ? hashA : hashB));
+        BOOST_CHECK_EQUAL(result[i].first.blockHeight, (int)(i % 10) + 1);
+    }
+
+    // Height range applies to every address in the batch
+    result.clear();
+    BOOST_CHECK(pblocktree->ReadAddressIndex(addresses, boost::bind(CollectAddressIndex, &result, 0, _1, _2), 4, 6));
+    BOOST_CHECK_EQUAL(result.size(), 6U);
+    BOOST_CHECK_EQUAL(result.front().first.blockHeight, 4);
+    BOOST_CHECK_EQUAL(result.back().first.blockHeight, 6);
+
+    // The visitor can stop the sweep early
+    result.clear();
+    BOOST_CHECK(pblocktree->ReadAddressIndex(addresses, boost::bind(CollectAddressIndex, &result, 3, _1, _2)));
+    BOOST_CHECK_EQUAL(result.size(), 3U);
+
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspent;
+    BOOST_CHECK(pblocktree->ReadAddressUnspentIndex(addresses, boost::bind(CollectAddressUnspent, &unspent, _1, _2)));
+    BOOST_CHECK_EQUAL(unspent.size(), 10U);
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_reverse_resume)
+{
+    uint160 hashA = uint160(ParseHex("5555555555555555555555555555555555555555"));
+    uint160 hashB = uint160(ParseHex("6666666666666666666666666666666666666666"));
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vIndex;
+    for (int nHeight = 1; nHeight <= 10; nHeight++) {
+        uint256 txid = ArithToUint256(arith_uint256(nHeight));
+        vIndex.push_back(std::make_pair(CAddressIndexKey(1, hashA, nHeight, 0, txid, 0, false), nHeight));
+        vIndex.push_back(std::make_pair(CAddressIndexKey(1, hashB, nHeight, 0, txid, 0, false), nHeight));
+    }
+    BOOST_CHECK(pblocktree->WriteAddressIndex(vIndex));
+
+    std::vector<std::pair<uint160, int> > addresses;
+    addresses.push_back(std::make_pair(hashA, 1));
+    addresses.push_back(std::make_pair(hashB, 1));
+
+    // Reverse walks the addresses back to front and heights newest first
+    std::vector<std::pair<CAddressIndexKey, CAmount> > result;
+    BOOST_CHECK(pblocktree->ReadAddressIndex(addresses, boost::bind(CollectAddressIndex, &result, 0, _1, _2), 0, 0, true));
+    BOOST_CHECK_EQUAL(result.size(), 20U);
+    for (size_t i = 0; i < result.size(); i++) {
+        BOOST_CHECK(result[i].first.hashBytes == (i < 10 ? hashB : hashA));
+        BOOST_CHECK_EQUAL(result[i].first.blockHeight, 10 - (int)(i % 10));
+    }
+
+    // Reverse within a height range
+    result.clear();
+    BOOST_CHECK(pblocktree->ReadAddressIndex(addresses, boost::bind(CollectAddressIndex, &result, 0, _1, _2), 3, 5, true));
+    BOOST_CHECK_EQUAL(result.size(), 6U);
+    BOOST_CHECK_EQUAL(result.front().first.blockHeight, 5);
+    BOOST_CHECK_EQUAL(result.back().first.blockHeight, 3);
+
+    // Resuming after a key continues with the entry that follows it, across addresses
+    for (int i = 0; i < 2; i++) {
+        bool fReverse = i == 1;
+        std::vector<std::pair<CAddressIndexKey, CAmount> > all, page;
+        BOOST_CHECK(pblocktree->ReadAddressIndex(addresses, boost::bind(CollectAddressIndex, &all, 0, _1, _2), 0, 0, fReverse));
+        size_t nPos = 0;
+        while (nPos < all.size()) {
+            page.clear();
+            const CAddressIndexKey *pkeyResume = nPos > 0 ? &all[nPos - 1].first : NULL;
+            BOOST_CHECK(pblocktree->ReadAddressIndex(addresses, boost::bind(CollectAddressIndex, &page, 7, _1, _2), 0, 0, fReverse, pkeyResume));
+            BOOST_CHECK(!page.empty());
+            for (size_t j = 0; j < page.size(); j++) {
+                BOOST_CHECK(page[j].first.hashBytes == all[nPos + j].first.hashBytes);
+                BOOST_CHECK_EQUAL(page[j].first.blockHeight, all[nPos + j].first.blockHeight);
+            }
+            nPos += page.size();
+        }
+        BOOST_CHECK_EQUAL(nPos, 20U);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_balance)
+{
+    uint160 hashA = uint160(ParseHex("4444444444444444444444444444444444444444"));
+    uint256 txid1 = ArithToUint256(arith_uint256(1));
+    uint256 txid2 = ArithToUint256(arith_uint256(2));
+    uint256 hashBlock1 = ArithToUint256(arith_uint256(101));
+    uint256 hashBlock2 = ArithToUint256(arith_uint256(102));
+
+    // Block 1 pays the address twice in one transaction
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vBlock1;
+    vBlock1.push_back(std::make_pair(CAddressIndexKey(1, hashA, 1, 1, txid1, 0, false), 5 * COIN));
+    vBlock1.push_back(std::make_pair(CAddressIndexKey(1, hashA, 1, 1, txid1, 1, false), 3 * COIN));
+    // Block 2 spends one output and sends change back
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vBlock2;
+    vBlock2.push_back(std::make_pair(CAddressIndexKey(1, hashA, 2, 1, txid2, 0, true), -5 * COIN));
+    vBlock2.push_back(std::make_pair(CAddressIndexKey(1, hashA, 2, 1, txid2, 0, false), 1 * COIN));
+
+    CAddressBalanceValue value;
+    BOOST_CHECK(pblocktree->ReadAddressBalance(hashA, 1, value));
+    BOOST_CHECK(value.IsNull());
+
+    BOOST_CHECK(pblocktree->UpdateAddressBalanceIndex(vBlock1, true, hashBlock1));
+    BOOST_CHECK(pblocktree->UpdateAddressBalanceIndex(vBlock2, true, hashBlock2));
+    BOOST_CHECK(pblocktree->ReadAddressBalance(hashA, 1, value));
+    BOOST_CHECK_EQUAL(value.balance, 4 * COIN);
+    BOOST_CHECK_EQUAL(value.received, 9 * COIN);
+    BOOST_CHECK_EQUAL(value.txCount, 2U);
+
+    uint256 hashBest;
+    BOOST_CHECK(pblocktree->ReadAddressBalanceBestBlock(hashBest));
+    BOOST_CHECK(hashBest == hashBlock2);
+
+    // Disconnecting block 2 restores the previous totals
+    BOOST_CHECK(pblocktree->UpdateAddressBalanceIndex(vBlock2, false, hashBlock1));
+    BOOST_CHECK(pblocktree->ReadAddressBalance(hashA, 1, value));
+    BOOST_CHECK_EQUAL(value.balance, 8 * COIN);
+    BOOST_CHECK_EQUAL(value.received, 8 * COIN);
+    BOOST_CHECK_EQUAL(value.txCount, 1U);
+
+    // Rebuilding from the address index yields the same totals and ignores blocks past the tip
+    BOOST_CHECK(pblocktree->WriteAddressIndex(vBlock1));
+    BOOST_CHECK(pblocktree->WriteAddressIndex(vBlock2));
+    BOOST_CHECK(pblocktree->UpdateAddressBalanceIndex(vBlock1, false, uint256()));
+    BOOST_CHECK(pblocktree->ReadAddressBalance(hashA, 1, value));
+    BOOST_CHECK(value.IsNull());
+    BOOST_CHECK(pblocktree->BuildAddressBalanceIndex(1, hashBlock1));
+    BOOST_CHECK(pblocktree->ReadAddressBalance(hashA, 1, value));
+    BOOST_CHECK_EQUAL(value.balance, 8 * COIN);
+    BOOST_CHECK_EQUAL(value.received, 8 * COIN);
+    BOOST_CHECK_EQUAL(value.txCount, 1U);
+    BOOST_CHECK(pblocktree->BuildAddressBalanceIndex(2, hashBlock2));
+    BOOST_CHECK(pblocktree->ReadAddressBalance(hashA, 1, value));
+    BOOST_CHECK_EQUAL(value.balance, 4 * COIN);
+    BOOST_CHECK_EQUAL(value.txCount, 2U);
+}
+
+BOOST_AUTO_TEST_CASE(indexbuilder_block_entries)
+{
+    uint160 hashA = uint160(ParseHex("7777777777777777777777777777777777777777"));
+    uint160 hashB = uint160(ParseHex("8888888888888888888888888888888888888888"));
+    CScript scriptA = CScript() << OP_DUP << OP_HASH160 << ToByteVector(hashA) << OP_EQUALVERIFY << OP_CHECKSIG;
+    CScript scriptB = CScript() << OP_HASH160 << ToByteVector(hashB) << OP_EQUAL;
+    COutPoint prevout(ArithToUint256(arith_uint256(99)), 1);
+
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout.SetNull();
+    coinbase.vout.push_back(CTxOut(50 * COIN, scriptA));
+    CMutableTransaction spend;
+    spend.vin.push_back(CTxIn(prevout));
+    spend.vout.push_back(CTxOut(30 * COIN, scriptB));
+    spend.vout.push_back(CTxOut(10 * COIN, CScript() << OP_RETURN));
+
+    CBlock block;
+    block.vtx.push_back(coinbase);
+    block.vtx.push_back(spend);
+    CBlockUndo blockundo;
+    blockundo.vtxundo.resize(1);
+    blockundo.vtxundo[0].vprevout.push_back(Coin(CTxOut(40 * COIN, scriptA), 5, false));
+
+    // The coinbase output, the spent input and the P2SH output; the OP_RETURN output is not indexed
+    CBlockIndexEntries connect;
+    BOOST_CHECK(GetBlockIndexEntries(block, blockundo, 10, BUILD_ADDRESSINDEX | BUILD_SPENTINDEX, true, connect));
+    BOOST_CHECK_EQUAL(connect.addressIndex.size(), 3U);
+    BOOST_CHECK_EQUAL(connect.addressUnspentIndex.size(), 3U);
+    BOOST_CHECK_EQUAL(connect.spentIndex.size(), 1U);
+    BOOST_CHECK(connect.addressIndex[1].first.spending);
+    BOOST_CHECK_EQUAL(connect.addressIndex[1].second, -40 * COIN);
+    BOOST_CHECK(connect.addressUnspentIndex[1].second.IsNull());
+    BOOST_CHECK_EQUAL(connect.spentIndex[0].second.satoshis, 40 * COIN);
+    BOOST_CHECK_EQUAL(connect.spentIndex[0].second.addressType, 1);
+    BOOST_CHECK_EQUAL(connect.spentIndex[0].second.blockHeight, 10);
+
+    // Disconnecting yields the same address entries in reverse and restores the spent output
+    CBlockIndexEntries disconnect;
+    BOOST_CHECK(GetBlockIndexEntries(block, blockundo, 10, BUILD_ADDRESSINDEX | BUILD_SPENTINDEX, false, disconnect));
+    BOOST_CHECK_EQUAL(disconnect.addressIndex.size(), 3U);
+    for (size_t i = 0; i < disconnect.addressIndex.size(); i++) {
+        BOOST_CHECK(disconnect.addressIndex[i].first.txhash == connect.addressIndex[2 - i].first.txhash);
+        BOOST_CHECK_EQUAL(disconnect.addressIndex[i].first.spending, connect.addressIndex[2 - i].first.spending);
+    }
+    BOOST_CHECK(disconnect.addressUnspentIndex[0].second.IsNull());
+    BOOST_CHECK_EQUAL(disconnect.addressUnspentIndex[1].second.satoshis, 40 * COIN);
+    BOOST_CHECK_EQUAL(disconnect.addressUnspentIndex[1].second.blockHeight, 5);
+    BOOST_CHECK(disconnect.spentIndex[0].second.IsNull());
+
+    // The progress record is written in the same batch as the entries
+    uint256 hashBlock = ArithToUint256(arith_uint256(1000));
+    BOOST_CHECK(pblocktree->WriteIndexBuildBatch(connect.addressIndex, connect.addressUnspentIndex, connect.spentIndex,
+                                                 std::vector<CTimestampIndexKey>(), BUILD_ADDRESSINDEX | BUILD_SPENTINDEX, hashBlock));
+    int nIndexes = 0;
+    uint256 hashBest;
+    BOOST_CHECK(pblocktree->ReadIndexBuildProgress(nIndexes, hashBest));
+    BOOST_CHECK_EQUAL(nIndexes, BUILD_ADDRESSINDEX | BUILD_SPENTINDEX);
+    BOOST_CHECK(hashBest == hashBlock);
+
+    CSpentIndexKey spentKey(prevout.hash, prevout.n);
+    CSpentIndexValue spentValue;
+    BOOST_CHECK(pblocktree->ReadSpentIndex(spentKey, spentValue));
+    BOOST_CHECK(spentValue.txid == block.vtx[1].GetHash());
+
+    BOOST_CHECK(pblocktree->EraseIndexBuildProgress());
+    BOOST_CHECK(!pblocktree->ReadIndexBuildProgress(nIndexes, hashBest));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
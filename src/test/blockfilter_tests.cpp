@@ -0,0 +1,164 @@
+// Copyright (c) 2018-2018 The Zixx developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+
+#include "clientversion.h"
+#include "coins.h"
+#include "key.h"
+#include "primitives/block.h"
+#include "random.h"
+#include "script/standard.h"
+#include "streams.h"
+#include "undo.h"
+#include "test/test_zixx.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockfilter_tests, BasicTestingSetup)
+
+static CBlockFilter::Element RandomElement()
+{
+    uint256 hash = GetRandHash();
+    return CBlockFilter::Element(hash.begin(), hash.begin() + 25);
+}
+
+static CBlockFilter::Element ScriptElement(const CScript& script)
+{
+    return CBlockFilter::Element(script.begin(), script.end());
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_match)
+{
+    CBlockFilter::ElementSet included, excluded;
+    for (int i = 0; i < 1000; i++)
+        included.insert(RandomElement());
+    for (int i = 0; i < 100; i++)
+        excluded.insert(RandomElement());
+
+    CBlockFilter filter(GetRandHash(), included);
+    BOOST_CHECK_EQUAL(filter.GetN(), included.size());
+
+    // no false negatives
+    for (const CBlockFilter::Element& element : included)
+        BOOST_CHECK(filter.Match(element));
+    BOOST_CHECK(filter.MatchAny(included));
+
+    // a false positive rate of 1/784931 makes a hit among 100 elements very unlikely
+    BOOST_CHECK(!filter.MatchAny(excluded));
+
+    CBlockFilter::ElementSet mixed = excluded;
+    mixed.insert(*included.rbegin());
+    BOOST_CHECK(filter.MatchAny(mixed));
+
+    BOOST_CHECK(!filter.MatchAny(CBlockFilter::ElementSet()));
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_empty)
+{
+    CBlockFilter filter(GetRandHash(), CBlockFilter::ElementSet());
+    BOOST_CHECK_EQUAL(filter.GetN(), 0U);
+    BOOST_CHECK(filter.GetEncoded().empty());
+    BOOST_CHECK(!filter.Match(RandomElement()));
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_serialize)
+{
+    CBlockFilter::ElementSet elements;
+    for (int i = 0; i < 100; i++)
+        elements.insert(RandomElement());
+
+    uint256 hashBlock = GetRandHash();
+    CBlockFilter filter(hashBlock, elements);
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << filter;
+
+    // the block hash is not serialized, it is the database key
+    CBlockFilter filter2(hashBlock);
+    ss >> filter2;
+    BOOST_CHECK_EQUAL(filter2.GetN(), filter.GetN());
+    BOOST_CHECK(filter2.GetEncoded() == filter.GetEncoded());
+    BOOST_CHECK(filter2.MatchAny(elements));
+
+    // a truncated filter can not rule anything out
+    uint64_t nN = filter.GetN();
+    std::vector<unsigned char> vchTruncated(filter.GetEncoded().begin(), filter.GetEncoded().begin() + 1);
+    CDataStream ssTruncated(SER_DISK, CLIENT_VERSION);
+    ssTruncated << COMPACTSIZE(nN) << vchTruncated;
+    CBlockFilter filter3(hashBlock);
+    ssTruncated >> filter3;
+    BOOST_CHECK(filter3.Match(RandomElement()));
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_block)
+{
+    CKey keyOut, keySpent, keyOther;
+    keyOut.MakeNewKey(true);
+    keySpent.MakeNewKey(true);
+    keyOther.MakeNewKey(true);
+
+    CScript scriptOut = GetScriptForDestination(keyOut.GetPubKey().GetID());
+    CScript scriptSpent = GetScriptForDestination(keySpent.GetPubKey().GetID());
+    CScript scriptOther = GetScriptForDestination(keyOther.GetPubKey().GetID());
+    CScript scriptData = CScript() << OP_RETURN << std::vector<unsigned char>(20, 1);
+
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vout.resize(1);
+    coinbase.vout[0].scriptPubKey = scriptOut;
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(GetRandHash(), 0);
+    tx.vout.resize(2);
+    tx.vout[0].scriptPubKey = scriptData;
+    tx.vout[1].scriptPubKey = scriptOut;
+
+    CBlock block;
+    block.vtx.push_back(coinbase);
+    block.vtx.push_back(tx);
+
+    CBlockUndo blockundo;
+    blockundo.vtxundo.resize(1);
+    blockundo.vtxundo[0].vprevout.push_back(Coin(CTxOut(1 * COIN, scriptSpent), 1, false));
+
+    CBlockFilter filter(block, blockundo);
+    BOOST_CHECK(filter.GetBlockHash() == block.GetHash());
+    // scriptOut is only counted once, OP_RETURN outputs are left out
+    BOOST_CHECK_EQUAL(filter.GetN(), 2U);
+    BOOST_CHECK(filter.Match(ScriptElement(scriptOut)));
+    BOOST_CHECK(filter.Match(ScriptElement(scriptSpent)));
+    BOOST_CHECK(!filter.Match(ScriptElement(scriptOther)));
+    BOOST_CHECK(!filter.Match(ScriptElement(scriptData)));
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_multisig)
+{
+    CKey key1, key2;
+    key1.MakeNewKey(true);
+    key2.MakeNewKey(false);
+
+    std::vector<CPubKey> keys;
+    keys.push_back(key1.GetPubKey());
+    keys.push_back(key2.GetPubKey());
+    CScript scriptMultisig = GetScriptForMultisig(1, keys);
+
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vout.resize(1);
+    coinbase.vout[0].scriptPubKey = scriptMultisig;
+
+    CBlock block;
+    block.vtx.push_back(coinbase);
+
+    // the keys of a bare multisig output match on their own
+    CBlockFilter filter(block, CBlockUndo());
+    BOOST_CHECK_EQUAL(filter.GetN(), 3U);
+    BOOST_CHECK(filter.Match(ScriptElement(scriptMultisig)));
+    BOOST_CHECK(filter.Match(CBlockFilter::Element(keys[0].begin(), keys[0].end())));
+    BOOST_CHECK(filter.Match(CBlockFilter::Element(keys[1].begin(), keys[1].end())));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
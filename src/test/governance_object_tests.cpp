@@ -0,0 +1,132 @@
+// Copyright (c) 2018-2018 The Zixx developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "governance-object.h"
+#include "governance-vote.h"
+#include "key.h"
+#include "masternodeman.h"
+#include "timedata.h"
+#include "version.h"
+
+#include "test/governance_test_util.h"
+#include "test/test_zixx.h"
+
+#include <boost/test/unit_test.hpp>
+
+class CGovernanceObjectTest : public CGovernanceObject
+{
+public:
+    bool ProcessVote(const CGovernanceVote& vote, CConnman& connman)
+    {
+        CGovernanceException exception;
+        return CGovernanceObject::ProcessVote(NULL, vote, exception, connman);
+    }
+
+    void ClearMasternodeVotes()
+    {
+        CGovernanceObject::ClearMasternodeVotes();
+    }
+};
+
+struct GovernanceVoteTestingSetup : public TestingSetup {
+    std::vector<CKey> vecKeys;
+    std::vector<CMasternode> vecMasternodes;
+
+    GovernanceVoteTestingSetup()
+    {
+        for(int i = 0; i < 3; ++i) {
+            CKey key;
+            key.MakeNewKey(true);
+            vecKeys.push_back(key);
+            vecMasternodes.push_back(CMasternode(CService(), MasternodeOutpoint(i), key.GetPubKey(), key.GetPubKey(), PROTOCOL_VERSION));
+            mnodeman.Add(vecMasternodes.back());
+        }
+    }
+
+    ~GovernanceVoteTestingSetup()
+    {
+        mnodeman.Clear();
+    }
+
+    CGovernanceVote MakeSignedVote(int nMasternode, vote_signal_enum_t eSignal, vote_outcome_enum_t eOutcome, int64_t nTime)
+    {
+        CGovernanceVote vote = MakeVote(nMasternode, eSignal, eOutcome, nTime);
+        CPubKey pubKey = vecKeys[nMasternode].GetPubKey();
+        BOOST_CHECK(vote.Sign(vecKeys[nMasternode], pubKey));
+        return vote;
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(governance_object_tests, GovernanceVoteTestingSetup)
+
+BOOST_AUTO_TEST_CASE(vote_digest_equal_votes)
+{
+    int64_t nTime = GetAdjustedTime();
+    std::vector<CGovernanceVote> vecVotes;
+    vecVotes.push_back(MakeSignedVote(0, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES, nTime));
+    vecVotes.push_back(MakeSignedVote(1, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_NO, nTime + 1));
+    vecVotes.push_back(MakeSignedVote(1, VOTE_SIGNAL_DELETE, VOTE_OUTCOME_ABSTAIN, nTime + 2));
+    vecVotes.push_back(MakeSignedVote(2, VOTE_SIGNAL_VALID, VOTE_OUTCOME_YES, nTime + 3));
+
+    CGovernanceObjectTest govobj1, govobj2;
+    BOOST_CHECK(govobj1.GetVoteDigest() == govobj2.GetVoteDigest());
+
+    // the digest does not depend on the order the votes arrived in
+    for(size_t i = 0; i < vecVotes.size(); ++i) {
+        BOOST_CHECK(govobj1.ProcessVote(vecVotes[i], *connman));
+        BOOST_CHECK(govobj2.ProcessVote(vecVotes[vecVotes.size() - 1 - i], *connman));
+    }
+    BOOST_CHECK(govobj1.GetVoteDigest() == govobj2.GetVoteDigest());
+
+    // a different outcome or vote time gives a different digest
+    CGovernanceObjectTest govobj3, govobj4;
+    for(size_t i = 0; i + 1 < vecVotes.size(); ++i) {
+        BOOST_CHECK(govobj3.ProcessVote(vecVotes[i], *connman));
+        BOOST_CHECK(govobj4.ProcessVote(vecVotes[i], *connman));
+    }
+    BOOST_CHECK(govobj3.ProcessVote(MakeSignedVote(2, VOTE_SIGNAL_VALID, VOTE_OUTCOME_NO, nTime + 3), *connman));
+    BOOST_CHECK(govobj4.ProcessVote(MakeSignedVote(2, VOTE_SIGNAL_VALID, VOTE_OUTCOME_YES, nTime + 4), *connman));
+    BOOST_CHECK(govobj3.GetVoteDigest() != govobj1.GetVoteDigest());
+    BOOST_CHECK(govobj4.GetVoteDigest() != govobj1.GetVoteDigest());
+    BOOST_CHECK(govobj3.GetVoteDigest() != govobj4.GetVoteDigest());
+}
+
+BOOST_AUTO_TEST_CASE(vote_digest_invalidation)
+{
+    int64_t nTime = GetAdjustedTime();
+    CGovernanceObjectTest govobj;
+    uint256 hashEmpty = govobj.GetVoteDigest();
+
+    // ProcessVote drops the cached digest
+    BOOST_CHECK(govobj.ProcessVote(MakeSignedVote(0, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES, nTime), *connman));
+    uint256 hashOne = govobj.GetVoteDigest();
+    BOOST_CHECK(hashOne != hashEmpty);
+    BOOST_CHECK(govobj.GetVoteDigest() == hashOne);
+
+    BOOST_CHECK(govobj.ProcessVote(MakeSignedVote(1, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_NO, nTime), *connman));
+    uint256 hashTwo = govobj.GetVoteDigest();
+    BOOST_CHECK(hashTwo != hashOne);
+
+    // so does a newer vote replacing an older one
+    BOOST_CHECK(govobj.ProcessVote(MakeSignedVote(1, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES, nTime + 1), *connman));
+    uint256 hashChanged = govobj.GetVoteDigest();
+    BOOST_CHECK(hashChanged != hashTwo);
+
+    // a rejected vote leaves it alone
+    BOOST_CHECK(!govobj.ProcessVote(MakeSignedVote(1, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_NO, nTime), *connman));
+    BOOST_CHECK(govobj.GetVoteDigest() == hashChanged);
+
+    // ClearMasternodeVotes drops it once the votes of a removed masternode are gone
+    govobj.ClearMasternodeVotes();
+    BOOST_CHECK(govobj.GetVoteDigest() == hashChanged);
+    mnodeman.Clear();
+    mnodeman.Add(vecMasternodes[0]);
+    govobj.ClearMasternodeVotes();
+    BOOST_CHECK(govobj.GetVoteDigest() == hashOne);
+    mnodeman.Clear();
+    govobj.ClearMasternodeVotes();
+    BOOST_CHECK(govobj.GetVoteDigest() == hashEmpty);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
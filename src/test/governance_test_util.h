@@ -0,0 +1,26 @@
+// Copyright (c) 2018-2018 The Zixx developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_TEST_GOVERNANCE_TEST_UTIL_H
+#define BITCOIN_TEST_GOVERNANCE_TEST_UTIL_H
+
+#include "governance-vote.h"
+#include "tinyformat.h"
+#include "uint256.h"
+
+/** Collateral outpoint of the n-th test masternode */
+inline COutPoint MasternodeOutpoint(int n)
+{
+    return COutPoint(uint256S(strprintf("%064x", n + 1)), n);
+}
+
+/** Unsigned vote of the n-th test masternode on a fixed parent object */
+inline CGovernanceVote MakeVote(int nMasternode, vote_signal_enum_t eSignal, vote_outcome_enum_t eOutcome, int64_t nTime)
+{
+    CGovernanceVote vote(MasternodeOutpoint(nMasternode), uint256S("0xabcdef"), eSignal, eOutcome);
+    vote.SetTime(nTime);
+    return vote;
+}
+
+#endif // BITCOIN_TEST_GOVERNANCE_TEST_UTIL_H
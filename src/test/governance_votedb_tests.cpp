@@ -0,0 +1,74 @@
+// Copyright (c) 2018-2018 The Zixx developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "clientversion.h"
+#include "governance-votedb.h"
+#include "streams.h"
+
+#include "test/governance_test_util.h"
+#include "test/test_zixx.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(governance_votedb_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(votedb_add_remove)
+{
+    CGovernanceObjectVoteFile fileVotes;
+    std::vector<CGovernanceVote> vecAdded;
+    for(int i = 0; i < 5; ++i) {
+        vecAdded.push_back(MakeVote(i, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES, 1500000000 + i));
+        vecAdded.push_back(MakeVote(i, VOTE_SIGNAL_DELETE, VOTE_OUTCOME_NO, 1500000000 + i));
+    }
+    for(size_t i = 0; i < vecAdded.size(); ++i) {
+        fileVotes.AddVote(vecAdded[i]);
+    }
+    BOOST_CHECK_EQUAL(fileVotes.GetVoteCount(), 10);
+    BOOST_CHECK_EQUAL(fileVotes.GetVoteHashes().size(), 10U);
+    BOOST_CHECK_EQUAL(fileVotes.GetVotes(MasternodeOutpoint(2)).size(), 2U);
+
+    // removing a masternode in the middle moves other votes around, all of them must stay reachable
+    fileVotes.RemoveVotesFromMasternode(MasternodeOutpoint(1));
+    fileVotes.RemoveVotesFromMasternode(MasternodeOutpoint(9));
+    BOOST_CHECK_EQUAL(fileVotes.GetVoteCount(), 8);
+    BOOST_CHECK(fileVotes.GetVotes(MasternodeOutpoint(1)).empty());
+    for(size_t i = 0; i < vecAdded.size(); ++i) {
+        bool fRemoved = vecAdded[i].GetMasternodeOutpoint() == MasternodeOutpoint(1);
+        CGovernanceVote vote;
+        BOOST_CHECK_EQUAL(fileVotes.HasVote(vecAdded[i].GetHash()), !fRemoved);
+        BOOST_CHECK_EQUAL(fileVotes.GetVote(vecAdded[i].GetHash(), vote), !fRemoved);
+        if(!fRemoved) {
+            BOOST_CHECK(vote.GetHash() == vecAdded[i].GetHash());
+        }
+    }
+    std::vector<CGovernanceVote> vecVotes = fileVotes.GetVotes(MasternodeOutpoint(4));
+    BOOST_CHECK_EQUAL(vecVotes.size(), 2U);
+    for(size_t i = 0; i < vecVotes.size(); ++i) {
+        BOOST_CHECK(vecVotes[i].GetMasternodeOutpoint() == MasternodeOutpoint(4));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(votedb_serialize)
+{
+    CGovernanceObjectVoteFile fileVotes;
+    for(int i = 0; i < 4; ++i) {
+        fileVotes.AddVote(MakeVote(i, VOTE_SIGNAL_VALID, VOTE_OUTCOME_ABSTAIN, 1500000000 + i));
+    }
+
+    // a duplicate in the stream is dropped when the indexes are rebuilt
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    std::vector<CGovernanceVote> vecVotes = fileVotes.GetVotes();
+    vecVotes.push_back(vecVotes.front());
+    ss << (int)vecVotes.size() << vecVotes;
+
+    CGovernanceObjectVoteFile fileLoaded;
+    ss >> fileLoaded;
+    BOOST_CHECK_EQUAL(fileLoaded.GetVoteCount(), 4);
+    for(int i = 0; i < 4; ++i) {
+        BOOST_CHECK(fileLoaded.HasVote(MakeVote(i, VOTE_SIGNAL_VALID, VOTE_OUTCOME_ABSTAIN, 1500000000 + i).GetHash()));
+        BOOST_CHECK_EQUAL(fileLoaded.GetVotes(MasternodeOutpoint(i)).size(), 1U);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
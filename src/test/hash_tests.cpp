@@ -66,6 +66,19 @@ BOOST_AUTO_TEST_CASE(siphash)
 
     BOOST_CHECK_EQUAL(SipHashUint256(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL, uint256S("1f1e1d1c1b1a191817161514131211100f0e0d0c0b0a09080706050403020100")), 0x7127512f72f27cceull);
 
+    // Same data written one byte at a time, lengths 1 and 15 are vectors from the SipHash paper
+    CSipHasher hasher2(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL);
+    for (uint8_t x = 0; x < 16; ++x) {
+        if (x == 1)
+            BOOST_CHECK_EQUAL(hasher2.Finalize(),  0x74f839c593dc67fdull);
+        if (x == 8)
+            BOOST_CHECK_EQUAL(hasher2.Finalize(),  0x93f5f5799a932462ull);
+        if (x == 15)
+            BOOST_CHECK_EQUAL(hasher2.Finalize(),  0xa129ca6149be45e5ull);
+        hasher2.Write(&x, 1);
+    }
+    BOOST_CHECK_EQUAL(hasher2.Finalize(),  0x3f2acc7f57c29bdbull);
+
     // Check consistency between CSipHasher and SipHashUint256[Extra].
     // TODO reenable when backporting Bitcoin #10321
     /*FastRandomContext ctx;
@@ -5,6 +5,7 @@
 
 #include "txdb.h"
 
+#include "blockfilter.h"
 #include "chainparams.h"
 #include "hash.h"
 #include "pow.h"
@@ -14,6 +15,10 @@
 
 #include <stdint.h>
 
+#include <algorithm>
+#include <limits>
+#include <set>
+
 #include <boost/thread.hpp>
 
 using namespace std;
@@ -26,6 +31,10 @@ static const char DB_ADDRESSINDEX = 'a';
 static const char DB_ADDRESSUNSPENTINDEX = 'u';
 static const char DB_TIMESTAMPINDEX = 's';
 static const char DB_SPENTINDEX = 'p';
+static const char DB_ADDRESSBALANCEINDEX = 'A';
+static const char DB_ADDRESSBALANCE_BEST = 'E';
+static const char DB_INDEXBUILD = 'I';
+static const char DB_BLOCK_FILTER = 'G';
 static const char DB_BLOCK_INDEX = 'b';
 
 static const char DB_BEST_BLOCK = 'B';
@@ -55,6 +64,31 @@ struct CoinEntry {
     }
 };
 
+/** Order (hash, type) address keys the way they are laid out on disk: type byte first, then hash bytes. */
+struct CAddressKeyDiskOrder
+{
+    bool operator()(const std::pair<uint160, int> &a, const std::pair<uint160, int> &b) const {
+        if (a.second != b.second)
+            return a.second < b.second;
+        return a.first < b.first;
+    }
+};
+
+bool IsSameAddressIndexKey(const CAddressIndexKey &a, const CAddressIndexKey &b)
+{
+    return a.type == b.type && a.hashBytes == b.hashBytes && a.blockHeight == b.blockHeight &&
+           a.txindex == b.txindex && a.txhash == b.txhash && a.index == b.index && a.spending == b.spending;
+}
+
+/** Return the requested addresses sorted in key order with duplicates removed, so a single forward sweep visits them all. */
+std::vector<std::pair<uint160, int> > SortAddressKeys(const std::vector<std::pair<uint160, int> > &addresses)
+{
+    std::vector<std::pair<uint160, int> > sorted(addresses);
+    std::sort(sorted.begin(), sorted.end(), CAddressKeyDiskOrder());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+    return sorted;
+}
+
 }
 
 CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true) 
@@ -260,6 +294,37 @@ bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
     return true;
 }
 
+bool CBlockTreeDB::ReadAddressUnspentIndex(const std::vector<std::pair<uint160, int> > &addresses,
+                                           boost::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)> visitor) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    std::vector<std::pair<uint160, int> > sorted = SortAddressKeys(addresses);
+    for (std::vector<std::pair<uint160, int> >::const_iterator it = sorted.begin(); it != sorted.end(); it++) {
+        // Keys are visited in ascending order, so each seek only moves the iterator forward
+        pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(it->second, it->first)));
+
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            std::pair<char,CAddressUnspentKey> key;
+            if (!pcursor->GetKey(key) || key.first != DB_ADDRESSUNSPENTINDEX ||
+                key.second.type != (unsigned int)it->second || key.second.hashBytes != it->first) {
+                break;
+            }
+            CAddressUnspentValue nValue;
+            if (!pcursor->GetValue(nValue)) {
+                return error("failed to get address unspent value");
+            }
+            if (!visitor(key.second, nValue)) {
+                return true;
+            }
+            pcursor->Next();
+        }
+    }
+
+    return true;
+}
+
 bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
     CDBBatch batch(*this);
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
@@ -308,12 +373,225 @@ bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
     return true;
 }
 
+bool CBlockTreeDB::ReadAddressIndex(const std::vector<std::pair<uint160, int> > &addresses,
+                                    boost::function<bool(const CAddressIndexKey&, CAmount)> visitor,
+                                    int start, int end, bool fReverse, const CAddressIndexKey *pkeyResume) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    // A height range only applies when both bounds are given
+    const bool fRange = start > 0 && end > 0;
+
+    std::vector<std::pair<uint160, int> > sorted = SortAddressKeys(addresses);
+    if (fReverse) {
+        std::reverse(sorted.begin(), sorted.end());
+    }
+
+    CAddressKeyDiskOrder order;
+    for (std::vector<std::pair<uint160, int> >::const_iterator it = sorted.begin(); it != sorted.end(); it++) {
+        bool fResume = false;
+        if (pkeyResume) {
+            std::pair<uint160, int> resumeAddress(pkeyResume->hashBytes, pkeyResume->type);
+            // Addresses swept before the one the previous page ended in are done
+            if (fReverse ? order(resumeAddress, *it) : order(*it, resumeAddress)) {
+                continue;
+            }
+            fResume = !order(resumeAddress, *it) && !order(*it, resumeAddress);
+        }
+
+        // Keys are visited in sweep order, so each seek only moves the iterator one way
+        if (!fReverse) {
+            if (fResume) {
+                pcursor->Seek(make_pair(DB_ADDRESSINDEX, *pkeyResume));
+                std::pair<char,CAddressIndexKey> key;
+                if (pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX && IsSameAddressIndexKey(key.second, *pkeyResume)) {
+                    pcursor->Next();
+                }
+            } else if (fRange) {
+                pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(it->second, it->first, start)));
+            } else {
+                pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(it->second, it->first)));
+            }
+        } else {
+            // Seek just past the newest wanted entry and step back onto it
+            if (fResume) {
+                pcursor->Seek(make_pair(DB_ADDRESSINDEX, *pkeyResume));
+            } else {
+                int nUpper = fRange ? end + 1 : std::numeric_limits<int>::max();
+                pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(it->second, it->first, nUpper)));
+            }
+            if (pcursor->Valid()) {
+                pcursor->Prev();
+            } else {
+                pcursor->SeekToLast();
+            }
+        }
+
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            std::pair<char,CAddressIndexKey> key;
+            if (!pcursor->GetKey(key) || key.first != DB_ADDRESSINDEX ||
+                key.second.type != (unsigned int)it->second || key.second.hashBytes != it->first) {
+                break;
+            }
+            if (fRange && (fReverse ? key.second.blockHeight < start : key.second.blockHeight > end)) {
+                break;
+            }
+            CAmount nValue;
+            if (!pcursor->GetValue(nValue)) {
+                return error("failed to get address index value");
+            }
+            if (!visitor(key.second, nValue)) {
+                return true;
+            }
+            if (fReverse) {
+                pcursor->Prev();
+            } else {
+                pcursor->Next();
+            }
+        }
+    }
+
+    return true;
+}
+
+bool CBlockTreeDB::ReadAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &value) {
+    value.SetNull();
+    if (!Read(make_pair(DB_ADDRESSBALANCEINDEX, CAddressIndexIteratorKey(type, addressHash)), value)) {
+        // Addresses without any history have no entry
+        value.SetNull();
+        return !Exists(make_pair(DB_ADDRESSBALANCEINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    }
+    return true;
+}
+
+bool CBlockTreeDB::ReadAddressBalanceBestBlock(uint256 &hashBlock) {
+    return Read(DB_ADDRESSBALANCE_BEST, hashBlock);
+}
+
+bool CBlockTreeDB::UpdateAddressBalanceIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool fConnect, const uint256 &hashBlock) {
+    // Aggregate the block's deltas per address first so each balance is read and written once
+    std::map<std::pair<uint160, int>, CAddressBalanceValue, CAddressKeyDiskOrder> mapDeltas;
+    std::set<std::pair<std::pair<uint160, int>, uint256> > setAddressTxs;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        std::pair<uint160, int> address(it->first.hashBytes, it->first.type);
+        CAddressBalanceValue &delta = mapDeltas[address];
+        delta.balance += it->second;
+        if (it->second > 0) {
+            delta.received += it->second;
+        }
+        if (setAddressTxs.insert(make_pair(address, it->first.txhash)).second) {
+            delta.txCount++;
+        }
+    }
+
+    CDBBatch batch(*this);
+    for (std::map<std::pair<uint160, int>, CAddressBalanceValue, CAddressKeyDiskOrder>::const_iterator it=mapDeltas.begin(); it!=mapDeltas.end(); it++) {
+        CAddressIndexIteratorKey key(it->first.second, it->first.first);
+        CAddressBalanceValue value;
+        if (!ReadAddressBalance(it->first.first, it->first.second, value)) {
+            return error("failed to read address balance value");
+        }
+        if (fConnect) {
+            value.balance += it->second.balance;
+            value.received += it->second.received;
+            value.txCount += it->second.txCount;
+        } else {
+            value.balance -= it->second.balance;
+            value.received -= it->second.received;
+            value.txCount -= std::min(value.txCount, it->second.txCount);
+        }
+        if (value.IsNull()) {
+            batch.Erase(make_pair(DB_ADDRESSBALANCEINDEX, key));
+        } else {
+            batch.Write(make_pair(DB_ADDRESSBALANCEINDEX, key), value);
+        }
+    }
+    // Written in the same batch as the balances, so a replayed block can be detected and skipped
+    batch.Write(DB_ADDRESSBALANCE_BEST, hashBlock);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::BuildAddressBalanceIndex(int nMaxHeight, const uint256 &hashBlock) {
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey()));
+
+    // Entries are sorted by address and then by height and position in the block,
+    // so all entries of one transaction are adjacent and a single pass suffices.
+    CDBBatch batch(*this);
+    std::pair<uint160, int> current;
+    uint256 txhashLast;
+    CAddressBalanceValue value;
+    bool fHaveCurrent = false;
+    size_t nAddresses = 0;
+
+    while (true) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressIndexKey> key;
+        bool fValid = pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX;
+        if (fHaveCurrent && (!fValid || key.second.type != (unsigned int)current.second || key.second.hashBytes != current.first)) {
+            if (!value.IsNull()) {
+                batch.Write(make_pair(DB_ADDRESSBALANCEINDEX, CAddressIndexIteratorKey(current.second, current.first)), value);
+                if (++nAddresses % 10000 == 0) {
+                    if (!WriteBatch(batch)) {
+                        return error("failed to write address balance index");
+                    }
+                    batch.Clear();
+                }
+            }
+            fHaveCurrent = false;
+        }
+        if (!fValid) {
+            break;
+        }
+        if (!fHaveCurrent) {
+            current = make_pair(key.second.hashBytes, (int)key.second.type);
+            txhashLast.SetNull();
+            value.SetNull();
+            fHaveCurrent = true;
+        }
+        // Skip entries of blocks beyond the tip, they will be applied when the block is connected
+        if (key.second.blockHeight <= nMaxHeight) {
+            CAmount nValue;
+            if (!pcursor->GetValue(nValue)) {
+                return error("failed to get address index value");
+            }
+            value.balance += nValue;
+            if (nValue > 0) {
+                value.received += nValue;
+            }
+            if (key.second.txhash != txhashLast) {
+                value.txCount++;
+                txhashLast = key.second.txhash;
+            }
+        }
+        pcursor->Next();
+    }
+
+    batch.Write(DB_ADDRESSBALANCE_BEST, hashBlock);
+    if (!WriteBatch(batch, true)) {
+        return error("failed to write address balance index");
+    }
+    LogPrintf("%s: built balances for %u addresses\n", __func__, nAddresses);
+    return true;
+}
+
 bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex) {
     CDBBatch batch(*this);
     batch.Write(make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
     return WriteBatch(batch);
 }
 
+bool CBlockTreeDB::WriteBlockFilter(const CBlockFilter &filter) {
+    return Write(make_pair(DB_BLOCK_FILTER, filter.GetBlockHash()), filter);
+}
+
+bool CBlockTreeDB::ReadBlockFilter(const uint256 &hash, CBlockFilter &filter) {
+    filter = CBlockFilter(hash);
+    return Read(make_pair(DB_BLOCK_FILTER, hash), filter);
+}
+
 bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes) {
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
@@ -334,6 +612,43 @@ bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned i
     return true;
 }
 
+bool CBlockTreeDB::WriteIndexBuildBatch(const std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                                        const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &addressUnspentIndex,
+                                        const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > &spentIndex,
+                                        const std::vector<CTimestampIndexKey> &timestampIndex,
+                                        int nIndexes, const uint256 &hashBlock) {
+    CDBBatch batch(*this);
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++)
+        batch.Write(make_pair(DB_ADDRESSINDEX, it->first), it->second);
+    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=addressUnspentIndex.begin(); it!=addressUnspentIndex.end(); it++) {
+        if (it->second.IsNull()) {
+            batch.Erase(make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
+        } else {
+            batch.Write(make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
+        }
+    }
+    for (std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >::const_iterator it=spentIndex.begin(); it!=spentIndex.end(); it++)
+        batch.Write(make_pair(DB_SPENTINDEX, it->first), it->second);
+    for (std::vector<CTimestampIndexKey>::const_iterator it=timestampIndex.begin(); it!=timestampIndex.end(); it++)
+        batch.Write(make_pair(DB_TIMESTAMPINDEX, *it), 0);
+    // The progress record is committed together with the entries it covers
+    batch.Write(DB_INDEXBUILD, make_pair(nIndexes, hashBlock));
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadIndexBuildProgress(int &nIndexes, uint256 &hashBlock) {
+    std::pair<int, uint256> progress;
+    if (!Read(DB_INDEXBUILD, progress))
+        return false;
+    nIndexes = progress.first;
+    hashBlock = progress.second;
+    return true;
+}
+
+bool CBlockTreeDB::EraseIndexBuildProgress() {
+    return Erase(DB_INDEXBUILD);
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
     return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
 }
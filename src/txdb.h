@@ -18,6 +18,7 @@
 
 #include <boost/function.hpp>
 
+class CBlockFilter;
 class CBlockIndex;
 class CCoinsViewDBCursor;
 class uint256;
@@ -133,8 +134,27 @@ public:
     bool ReadAddressIndex(uint160 addressHash, int type,
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                           int start = 0, int end = 0);
+    bool ReadAddressIndex(const std::vector<std::pair<uint160, int> > &addresses,
+                          boost::function<bool(const CAddressIndexKey&, CAmount)> visitor,
+                          int start = 0, int end = 0, bool fReverse = false,
+                          const CAddressIndexKey *pkeyResume = NULL);
+    bool ReadAddressUnspentIndex(const std::vector<std::pair<uint160, int> > &addresses,
+                                 boost::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)> visitor);
+    bool ReadAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &value);
+    bool ReadAddressBalanceBestBlock(uint256 &hashBlock);
+    bool UpdateAddressBalanceIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool fConnect, const uint256 &hashBlock);
+    bool BuildAddressBalanceIndex(int nMaxHeight, const uint256 &hashBlock);
     bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
     bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &vect);
+    bool WriteBlockFilter(const CBlockFilter &filter);
+    bool ReadBlockFilter(const uint256 &hash, CBlockFilter &filter);
+    bool WriteIndexBuildBatch(const std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                              const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &addressUnspentIndex,
+                              const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > &spentIndex,
+                              const std::vector<CTimestampIndexKey> &timestampIndex,
+                              int nIndexes, const uint256 &hashBlock);
+    bool ReadIndexBuildProgress(int &nIndexes, uint256 &hashBlock);
+    bool EraseIndexBuildProgress();
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
     bool LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex);
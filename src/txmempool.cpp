@@ -76,8 +76,8 @@ bool CTxMemPool::UpdateForDescendants(txiter updateIt, int maxDescendantsToVisit
     // (will bail out if it exceeds maxDescendantsToVisit)
     int nChildrenToVisit = 0;
 
-    setEntries stageEntries, setAllDescendants;
-    stageEntries = GetMemPoolChildren(updateIt);
+    const vecEntries &children = GetMemPoolChildren(updateIt);
+    setEntries stageEntries(children.begin(), children.end()), setAllDescendants;
 
     while (!stageEntries.empty()) {
         const txiter cit = *stageEntries.begin();
@@ -87,7 +87,7 @@ bool CTxMemPool::UpdateForDescendants(txiter updateIt, int maxDescendantsToVisit
         }
         setAllDescendants.insert(cit);
         stageEntries.erase(cit);
-        const setEntries &setChildren = GetMemPoolChildren(cit);
+        const vecEntries &setChildren = GetMemPoolChildren(cit);
         BOOST_FOREACH(const txiter childEntry, setChildren) {
             cacheMap::iterator cacheIt = cachedDescendants.find(childEntry);
             if (cacheIt != cachedDescendants.end()) {
@@ -203,7 +203,8 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
         // If we're not searching for parents, we require this to be an
         // entry in the mempool already.
         txiter it = mapTx.iterator_to(entry);
-        parentHashes = GetMemPoolParents(it);
+        const vecEntries &parents = GetMemPoolParents(it);
+        parentHashes.insert(parents.begin(), parents.end());
     }
 
     size_t totalSizeWithAncestors = entry.GetTxSize();
@@ -226,7 +227,7 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
             return false;
         }
 
-        const setEntries & setMemPoolParents = GetMemPoolParents(stageit);
+        const vecEntries & setMemPoolParents = GetMemPoolParents(stageit);
         BOOST_FOREACH(const txiter &phash, setMemPoolParents) {
             // If this is a new ancestor, add it.
             if (setAncestors.count(phash) == 0) {
@@ -244,7 +245,7 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
 
 void CTxMemPool::UpdateAncestorsOf(bool add, txiter it, setEntries &setAncestors)
 {
-    setEntries parentIters = GetMemPoolParents(it);
+    const vecEntries &parentIters = GetMemPoolParents(it);
     // add or remove this tx as a child of each parent
     BOOST_FOREACH(txiter piter, parentIters) {
         UpdateChild(piter, it, add);
@@ -259,7 +260,7 @@ void CTxMemPool::UpdateAncestorsOf(bool add, txiter it, setEntries &setAncestors
 
 void CTxMemPool::UpdateChildrenForRemoval(txiter it)
 {
-    const setEntries &setMemPoolChildren = GetMemPoolChildren(it);
+    const vecEntries &setMemPoolChildren = GetMemPoolChildren(it);
     BOOST_FOREACH(txiter updateIt, setMemPoolChildren) {
         UpdateParent(updateIt, it, false);
     }
@@ -594,7 +595,7 @@ void CTxMemPool::CalculateDescendants(txiter entryit, setEntries &setDescendants
         setDescendants.insert(it);
         stage.erase(it);
 
-        const setEntries &setChildren = GetMemPoolChildren(it);
+        const vecEntries &setChildren = GetMemPoolChildren(it);
         BOOST_FOREACH(const txiter &childiter, setChildren) {
             if (!setDescendants.count(childiter)) {
                 stage.insert(childiter);
@@ -789,7 +790,8 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
             assert(it3->second.n == i);
             i++;
         }
-        assert(setParentCheck == GetMemPoolParents(it));
+        const vecEntries &parents = GetMemPoolParents(it);
+        assert(setParentCheck == setEntries(parents.begin(), parents.end()));
         // Check children against mapNextTx
         CTxMemPool::setEntries setChildrenCheck;
         std::map<COutPoint, CInPoint>::const_iterator iter = mapNextTx.lower_bound(COutPoint(it->GetTx().GetHash(), 0));
@@ -803,7 +805,8 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
                 childModFee += childit->GetModifiedFee();
             }
         }
-        assert(setChildrenCheck == GetMemPoolChildren(it));
+        const vecEntries &children = GetMemPoolChildren(it);
+        assert(setChildrenCheck == setEntries(children.begin(), children.end()));
         // Also check to make sure size is greater than sum with immediate children.
         // just a sanity check, not definitive that this calc is correct...
         if (!it->IsDirty()) {
@@ -1031,27 +1034,42 @@ bool CTxMemPool::addUnchecked(const uint256&hash, const CTxMemPoolEntry &entry,
     return addUnchecked(hash, entry, setAncestors, fCurrentEstimate);
 }
 
-void CTxMemPool::UpdateChild(txiter entry, txiter child, bool add)
+void CTxMemPool::UpdateLink(vecEntries &links, txiter link, bool add)
 {
-    setEntries s;
-    if (add && mapLinks[entry].children.insert(child).second) {
-        cachedInnerUsage += memusage::IncrementalDynamicUsage(s);
-    } else if (!add && mapLinks[entry].children.erase(child)) {
-        cachedInnerUsage -= memusage::IncrementalDynamicUsage(s);
+    vecEntries::iterator pos = std::lower_bound(links.begin(), links.end(), link, CompareIteratorByHash());
+    bool fPresent = pos != links.end() && *pos == link;
+    if (add && !fPresent) {
+        size_t nUsageBefore = memusage::DynamicUsage(links);
+        links.insert(pos, link);
+        cachedInnerUsage += memusage::DynamicUsage(links) - nUsageBefore;
+    } else if (!add && fPresent) {
+        // The capacity is kept, so the usage only drops once the entry owning the links is removed
+        links.erase(pos);
     }
 }
 
+void CTxMemPool::UpdateChild(txiter entry, txiter child, bool add)
+{
+    UpdateLink(mapLinks[entry].children, child, add);
+}
+
 void CTxMemPool::UpdateParent(txiter entry, txiter parent, bool add)
 {
-    setEntries s;
-    if (add && mapLinks[entry].parents.insert(parent).second) {
-        cachedInnerUsage += memusage::IncrementalDynamicUsage(s);
-    } else if (!add && mapLinks[entry].parents.erase(parent)) {
-        cachedInnerUsage -= memusage::IncrementalDynamicUsage(s);
-    }
+    UpdateLink(mapLinks[entry].parents, parent, add);
+}
+
+size_t CTxMemPool::GetRemovalUsage(txiter entry) const
+{
+    txlinksMap::const_iterator it = mapLinks.find(entry);
+    assert(it != mapLinks.end());
+    // Mirrors what removeUnchecked() takes out of DynamicMemoryUsage()
+    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) + entry->DynamicMemoryUsage() +
+           memusage::DynamicUsage(it->second.parents) + memusage::DynamicUsage(it->second.children) +
+           memusage::IncrementalDynamicUsage(mapLinks) +
+           memusage::IncrementalDynamicUsage(mapNextTx) * entry->GetTx().vin.size();
 }
 
-const CTxMemPool::setEntries & CTxMemPool::GetMemPoolParents(txiter entry) const
+const CTxMemPool::vecEntries & CTxMemPool::GetMemPoolParents(txiter entry) const
 {
     assert (entry != mapTx.end());
     txlinksMap::const_iterator it = mapLinks.find(entry);
@@ -1059,7 +1077,7 @@ const CTxMemPool::setEntries & CTxMemPool::GetMemPoolParents(txiter entry) const
     return it->second.parents;
 }
 
-const CTxMemPool::setEntries & CTxMemPool::GetMemPoolChildren(txiter entry) const
+const CTxMemPool::vecEntries & CTxMemPool::GetMemPoolChildren(txiter entry) const
 {
     assert (entry != mapTx.end());
     txlinksMap::const_iterator it = mapLinks.find(entry);
@@ -1112,20 +1130,45 @@ void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpends
 
     unsigned nTxnRemoved = 0;
     CFeeRate maxFeeRateRemoved(0);
-    while (DynamicMemoryUsage() > sizelimit) {
-        indexed_transaction_set::nth_index<1>::type::iterator it = mapTx.get<1>().begin();
-
-        // We set the new mempool min fee to the feerate of the removed set, plus the
-        // "minimum reasonable fee rate" (ie some value under which we consider txn
-        // to have 0 fee). This way, we don't allow txn to enter mempool with feerate
-        // equal to txn which were removed with no block in between.
-        CFeeRate removed(it->GetModFeesWithDescendants(), it->GetSizeWithDescendants());
-        removed += minReasonableRelayFee;
-        trackPackageRemoved(removed);
-        maxFeeRateRemoved = std::max(maxFeeRateRemoved, removed);
-
+    size_t nUsage = DynamicMemoryUsage();
+    while (nUsage > sizelimit) {
+        // Stage several packages per pass and remove them together. Removing a package none of
+        // whose members has a parent outside of it leaves the descendant state of every other
+        // entry untouched, so the next entries in descendant score order are exactly the ones
+        // that would be evicted next. The first package with outside parents ends the pass.
         setEntries stage;
-        CalculateDescendants(mapTx.project<0>(it), stage);
+        size_t nUsageStaged = 0;
+        indexed_transaction_set::nth_index<1>::type::iterator it = mapTx.get<1>().begin();
+        while (it != mapTx.get<1>().end() && nUsage > sizelimit + nUsageStaged) {
+            txiter rootit = mapTx.project<0>(it++);
+            if (stage.count(rootit))
+                continue;
+
+            // We set the new mempool min fee to the feerate of the removed set, plus the
+            // "minimum reasonable fee rate" (ie some value under which we consider txn
+            // to have 0 fee). This way, we don't allow txn to enter mempool with feerate
+            // equal to txn which were removed with no block in between.
+            CFeeRate removed(rootit->GetModFeesWithDescendants(), rootit->GetSizeWithDescendants());
+            removed += minReasonableRelayFee;
+            trackPackageRemoved(removed);
+            maxFeeRateRemoved = std::max(maxFeeRateRemoved, removed);
+
+            setEntries package;
+            CalculateDescendants(rootit, package);
+            bool fClosed = true;
+            BOOST_FOREACH(txiter packageit, package) {
+                nUsageStaged += GetRemovalUsage(packageit);
+                BOOST_FOREACH(txiter parentit, GetMemPoolParents(packageit)) {
+                    if (!package.count(parentit))
+                        fClosed = false;
+                }
+            }
+            stage.insert(package.begin(), package.end());
+            if (!fClosed)
+                break;
+        }
+        if (stage.empty())
+            break;
         nTxnRemoved += stage.size();
 
         std::vector<CTransaction> txn;
@@ -1143,6 +1186,7 @@ void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpends
                 }
             }
         }
+        nUsage = DynamicMemoryUsage();
     }
 
     if (maxFeeRateRemoved > CFeeRate(0))
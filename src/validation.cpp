@@ -9,6 +9,7 @@
 
 #include "alert.h"
 #include "arith_uint256.h"
+#include "blockfilter.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
@@ -74,9 +75,10 @@ int nScriptCheckThreads = 0;
 bool fImporting = false;
 bool fReindex = false;
 bool fTxIndex = true;
-bool fAddressIndex = false;
-bool fTimestampIndex = false;
-bool fSpentIndex = false;
+std::atomic<bool> fAddressIndex(false);
+std::atomic<bool> fTimestampIndex(false);
+std::atomic<bool> fSpentIndex(false);
+bool fBlockFilterIndex = DEFAULT_BLOCKFILTERINDEX;
 bool fHavePruned = false;
 bool fPruneMode = false;
 bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
@@ -1152,6 +1154,42 @@ bool GetAddressUnspent(uint160 addressHash, int type,
     return true;
 }
 
+bool GetAddressIndex(const std::vector<std::pair<uint160, int> > &addresses,
+                     boost::function<bool(const CAddressIndexKey&, CAmount)> visitor, int start, int end,
+                     bool fReverse, const CAddressIndexKey *pkeyResume)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!pblocktree->ReadAddressIndex(addresses, visitor, start, end, fReverse, pkeyResume))
+        return error("unable to get txids for addresses");
+
+    return true;
+}
+
+bool GetAddressUnspent(const std::vector<std::pair<uint160, int> > &addresses,
+                       boost::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)> visitor)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!pblocktree->ReadAddressUnspentIndex(addresses, visitor))
+        return error("unable to get txids for addresses");
+
+    return true;
+}
+
+bool GetAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &value)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!pblocktree->ReadAddressBalance(addressHash, type, value))
+        return error("unable to get balance for address");
+
+    return true;
+}
+
 /** Return transaction in tx, and if it was found inside a block, its hash is placed in hashBlock */
 bool GetTransaction(const uint256 &hash, CTransaction &txOut, const Consensus::Params& consensusParams, uint256 &hashBlock, bool fAllowSlow)
 {
@@ -1648,6 +1686,8 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
     return true;
 }
 
+} // anon namespace
+
 bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock)
 {
     // Open history file to read
@@ -1674,6 +1714,8 @@ bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uin
     return true;
 }
 
+namespace {
+
 /** Abort with a message */
 bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
 {
@@ -1731,6 +1773,22 @@ int ApplyTxInUndo(Coin&& undo, CCoinsViewCache& view, const COutPoint& out)
     return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
 }
 
+/**
+ * Whether the address deltas of pindex are already reflected in the address balance index.
+ * Blocks are replayed after an unclean shutdown and reconnected by -reindex-chainstate
+ * and VerifyDB, so unlike the other indexes the running balances must not be applied twice.
+ */
+bool IsAddressBalanceApplied(const CBlockIndex* pindex)
+{
+    uint256 hashBalanceBest;
+    if (!pblocktree->ReadAddressBalanceBestBlock(hashBalanceBest))
+        return false;
+    BlockMap::iterator mi = mapBlockIndex.find(hashBalanceBest);
+    if (mi == mapBlockIndex.end())
+        return false;
+    return mi->second->GetAncestor(pindex->nHeight) == pindex;
+}
+
 /** Undo the effects of this block (with given index) on the UTXO set represented by coins.
  *  When UNCLEAN or FAILED is returned, view is left in an indeterminate state. */
 static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& state, const CBlockIndex* pindex, CCoinsViewCache& view)
@@ -1875,6 +1933,11 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
             AbortNode(state, "Failed to write address unspent index");
             return DISCONNECT_FAILED;
         }
+        if (IsAddressBalanceApplied(pindex) &&
+            !pblocktree->UpdateAddressBalanceIndex(addressIndex, false, pindex->pprev->GetBlockHash())) {
+            AbortNode(state, "Failed to write address balance index");
+            return DISCONNECT_FAILED;
+        }
     }
 
     return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
@@ -1912,6 +1975,20 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+bool RunScriptChecks(std::vector<CScriptCheck>& vChecks)
+{
+    if (!nScriptCheckThreads) {
+        BOOST_FOREACH(CScriptCheck& check, vChecks)
+            if (!check())
+                return false;
+        return true;
+    }
+
+    CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+    control.Add(vChecks);
+    return control.Wait();
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -2320,6 +2397,11 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
         if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
             return AbortNode(state, "Failed to write address unspent index");
         }
+
+        if (!IsAddressBalanceApplied(pindex) &&
+            !pblocktree->UpdateAddressBalanceIndex(addressIndex, true, pindex->GetBlockHash())) {
+            return AbortNode(state, "Failed to write address balance index");
+        }
     }
 
     if (fSpentIndex)
@@ -2330,6 +2412,11 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
         if (!pblocktree->WriteTimestampIndex(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash())))
             return AbortNode(state, "Failed to write timestamp index");
 
+    // a block's filter never changes, so it is kept when the block is disconnected
+    if (fBlockFilterIndex)
+        if (!pblocktree->WriteBlockFilter(CBlockFilter(block, blockundo)))
+            return AbortNode(state, "Failed to write block filter");
+
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
@@ -2562,6 +2649,7 @@ bool static DisconnectTip(CValidationState& state, const Consensus::Params& cons
     mempool.UpdateTransactionsFromBlock(vHashUpdate);
     // Update chainActive and related variables.
     UpdateTip(pindexDelete->pprev);
+    GetMainSignals().BlockDisconnected(block);
     // Let wallets know transactions went from 1-confirmed to
     // 0-confirmed or conflicted:
     BOOST_FOREACH(const CTransaction &tx, block.vtx) {
@@ -2620,6 +2708,7 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
     mempool.removeForBlock(pblock->vtx, pindexNew->nHeight, txConflicted, !IsInitialBlockDownload());
     // Update chainActive & related variables.
     UpdateTip(pindexNew);
+    GetMainSignals().BlockConnected(*pblock, pindexNew);
     // Tell wallet about transactions that went from mempool
     // to conflicted:
     BOOST_FOREACH(const CTransaction &tx, txConflicted) {
@@ -3850,15 +3939,21 @@ bool static LoadBlockIndexDB()
     LogPrintf("%s: transaction index %s\n", __func__, fTxIndex ? "enabled" : "disabled");
 
     // Check whether we have an address index
-    pblocktree->ReadFlag("addressindex", fAddressIndex);
+    bool fFlagAddressIndex = false;
+    pblocktree->ReadFlag("addressindex", fFlagAddressIndex);
+    fAddressIndex = fFlagAddressIndex;
     LogPrintf("%s: address index %s\n", __func__, fAddressIndex ? "enabled" : "disabled");
 
     // Check whether we have a timestamp index
-    pblocktree->ReadFlag("timestampindex", fTimestampIndex);
+    bool fFlagTimestampIndex = false;
+    pblocktree->ReadFlag("timestampindex", fFlagTimestampIndex);
+    fTimestampIndex = fFlagTimestampIndex;
     LogPrintf("%s: timestamp index %s\n", __func__, fTimestampIndex ? "enabled" : "disabled");
 
     // Check whether we have a spent index
-    pblocktree->ReadFlag("spentindex", fSpentIndex);
+    bool fFlagSpentIndex = false;
+    pblocktree->ReadFlag("spentindex", fFlagSpentIndex);
+    fSpentIndex = fFlagSpentIndex;
     LogPrintf("%s: spent index %s\n", __func__, fSpentIndex ? "enabled" : "disabled");
 
     // Load pointer to end of best chain
@@ -3867,6 +3962,19 @@ bool static LoadBlockIndexDB()
         return true;
     chainActive.SetTip(it->second);
 
+    // Databases created before the address balance index existed build it once from the address index
+    if (fAddressIndex) {
+        bool fAddressBalanceIndex = false;
+        pblocktree->ReadFlag("addressbalanceindex", fAddressBalanceIndex);
+        if (!fAddressBalanceIndex) {
+            LogPrintf("%s: building address balance index...\n", __func__);
+            uiInterface.InitMessage(_("Building address balance index..."));
+            if (!pblocktree->BuildAddressBalanceIndex(chainActive.Height(), chainActive.Tip()->GetBlockHash()))
+                return error("%s: failed to build address balance index", __func__);
+            pblocktree->WriteFlag("addressbalanceindex", true);
+        }
+    }
+
     PruneBlockIndexCandidates();
 
     LogPrintf("%s: hashBestChain=%s height=%d date=%s progress=%f\n", __func__,
@@ -4019,6 +4127,8 @@ bool InitBlockIndex(const CChainParams& chainparams)
     // Use the provided setting for -addressindex in the new database
     fAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
     pblocktree->WriteFlag("addressindex", fAddressIndex);
+    // Running balances are maintained as the chain is connected from genesis
+    pblocktree->WriteFlag("addressbalanceindex", fAddressIndex);
 
     // Use the provided setting for -timestampindex in the new database
     fTimestampIndex = GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
@@ -32,11 +32,13 @@
 
 #include <atomic>
 
+#include <boost/function.hpp>
 #include <boost/unordered_map.hpp>
 #include <boost/filesystem/path.hpp>
 
 class CBlockIndex;
 class CBlockTreeDB;
+class CBlockUndo;
 class CBloomFilter;
 class CChainParams;
 class CCoinsViewDB;
@@ -121,6 +123,7 @@ static const bool DEFAULT_TXINDEX = true;
 static const bool DEFAULT_ADDRESSINDEX = false;
 static const bool DEFAULT_TIMESTAMPINDEX = false;
 static const bool DEFAULT_SPENTINDEX = false;
+static const bool DEFAULT_BLOCKFILTERINDEX = false;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 
 static const bool DEFAULT_TESTSAFEMODE = false;
@@ -149,6 +152,11 @@ extern bool fImporting;
 extern bool fReindex;
 extern int nScriptCheckThreads;
 extern bool fTxIndex;
+/** The optional indexes can be enabled at runtime by the index builder, so RPCs read them without cs_main */
+extern std::atomic<bool> fAddressIndex;
+extern std::atomic<bool> fTimestampIndex;
+extern std::atomic<bool> fSpentIndex;
+extern bool fBlockFilterIndex;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern unsigned int nBytesPerSigOp;
@@ -334,6 +342,12 @@ unsigned int GetP2SHSigOpCount(const CTransaction& tx, const CCoinsViewCache& ma
 bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &view, bool fScriptChecks,
                  unsigned int flags, bool cacheStore, std::vector<CScriptCheck> *pvChecks = NULL);
 
+/**
+ * Run the given script checks on the script checking threads (inline if there are none)
+ * and return whether all of them passed. vChecks is consumed.
+ */
+bool RunScriptChecks(std::vector<CScriptCheck>& vChecks);
+
 /** Apply the effects of this transaction on the UTXO set represented by view */
 void UpdateCoins(const CTransaction& tx, CValidationState &state, CCoinsViewCache &inputs, int nHeight);
 
@@ -420,11 +434,28 @@ bool GetAddressIndex(uint160 addressHash, int type,
                      int start = 0, int end = 0);
 bool GetAddressUnspent(uint160 addressHash, int type,
                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs);
+bool GetAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &value);
+/** Whether the address deltas of pindex are already reflected in the address balance index */
+bool IsAddressBalanceApplied(const CBlockIndex* pindex);
+/**
+ * Batched variants: all addresses are read with a single sweep of the block tree
+ * database in key order and every entry is handed to visitor as it is read.
+ * The visitor returns false to stop the sweep early.
+ * With fReverse the sweep runs backwards, newest entries first. A sweep can be
+ * continued after the last entry of a previous one by passing it as pkeyResume.
+ */
+bool GetAddressIndex(const std::vector<std::pair<uint160, int> > &addresses,
+                     boost::function<bool(const CAddressIndexKey&, CAmount)> visitor,
+                     int start = 0, int end = 0, bool fReverse = false,
+                     const CAddressIndexKey *pkeyResume = NULL);
+bool GetAddressUnspent(const std::vector<std::pair<uint160, int> > &addresses,
+                       boost::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)> visitor);
 
 /** Functions for disk access for blocks */
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock);
 
 /** Functions for validating blocks and updating the block tree */
 
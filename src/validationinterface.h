@@ -15,6 +15,7 @@ class CBlockIndex;
 class CConnman;
 class CReserveScript;
 class CTransaction;
+class CTxLockTrace;
 class CValidationInterface;
 class CValidationState;
 class uint256;
@@ -34,7 +35,10 @@ protected:
     virtual void NotifyHeaderTip(const CBlockIndex *pindexNew, bool fInitialDownload) {}
     virtual void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) {}
     virtual void SyncTransaction(const CTransaction &tx, const CBlock *pblock) {}
+    virtual void BlockConnected(const CBlock &block, const CBlockIndex *pindex) {}
+    virtual void BlockDisconnected(const CBlock &block) {}
     virtual void NotifyTransactionLock(const CTransaction &tx) {}
+    virtual void NotifyTransactionLockTrace(const CTxLockTrace &trace) {}
     virtual void SetBestChain(const CBlockLocator &locator) {}
     virtual bool UpdatedTransaction(const uint256 &hash) { return false;}
     virtual void Inventory(const uint256 &hash) {}
@@ -56,8 +60,14 @@ struct CMainSignals {
     boost::signals2::signal<void (const CBlockIndex *, const CBlockIndex *, bool fInitialDownload)> UpdatedBlockTip;
     /** Notifies listeners of updated transaction data (transaction, and optionally the block it is found in. */
     boost::signals2::signal<void (const CTransaction &, const CBlock *)> SyncTransaction;
+    /** Notifies listeners of a block being connected to the active chain, after the coins view was updated */
+    boost::signals2::signal<void (const CBlock &, const CBlockIndex *)> BlockConnected;
+    /** Notifies listeners of a block being disconnected from the active chain, after the coins view was updated */
+    boost::signals2::signal<void (const CBlock &)> BlockDisconnected;
     /** Notifies listeners of an updated transaction lock without new data. */
     boost::signals2::signal<void (const CTransaction &)> NotifyTransactionLock;
+    /** Notifies listeners of the stage timings of a completed transaction lock. */
+    boost::signals2::signal<void (const CTxLockTrace &)> NotifyTransactionLockTrace;
     /** Notifies listeners of an updated transaction without new data (for now: a coinbase potentially becoming visible). */
     boost::signals2::signal<bool (const uint256 &)> UpdatedTransaction;
     /** Notifies listeners of a new active block chain. */
@@ -11,7 +11,7 @@
  * network protocol versioning
  */
 
-static const int PROTOCOL_VERSION = 70209;
+static const int PROTOCOL_VERSION = 70210;
 
 //! initial proto version, to be increased after version/verack negotiation
 static const int INIT_PROTO_VERSION = 209;
@@ -45,4 +45,7 @@ static const int SENDHEADERS_VERSION = 70201;
 //! DIP0001 was activated in this version
 static const int DIP0001_PROTOCOL_VERSION = 70208;
 
+//! "mnget" carries a filter of the payment votes the requesting node already has starting with this version
+static const int MNPAYMENTS_FILTER_VERSION = 70210;
+
 #endif // BITCOIN_VERSION_H
@@ -1941,6 +1941,33 @@ UniValue abandontransaction(const UniValue& params, bool fHelp)
     return NullUniValue;
 }
 
+UniValue abortrescan(const UniValue& params, bool fHelp)
+{
+    if (!EnsureWalletIsAvailable(fHelp))
+        return NullUniValue;
+
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "abortrescan\n"
+            "\nStops current wallet rescan triggered e.g. by an importprivkey call.\n"
+            "\nResult:\n"
+            "true|false    (boolean) Whether a rescan was running and has been asked to stop\n"
+            "\nExamples:\n"
+            "\nImport a private key\n"
+            + HelpExampleCli("importprivkey", "\"mykey\"") +
+            "\nAbort the running wallet rescan\n"
+            + HelpExampleCli("abortrescan", "") +
+            "\nAs a JSON-RPC call\n"
+            + HelpExampleRpc("abortrescan", "")
+        );
+
+    // no cs_wallet here, the rescan only takes it per block and checks the flag in between
+    if (!pwalletMain->IsScanning() || pwalletMain->IsAbortingRescan())
+        return false;
+    pwalletMain->AbortRescan();
+    return true;
+}
+
 
 UniValue backupwallet(const UniValue& params, bool fHelp)
 {
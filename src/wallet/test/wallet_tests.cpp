@@ -4,6 +4,15 @@
 
 #include "wallet/wallet.h"
 
+#include "init.h"
+#include "keystore.h"
+#include "privatesend-client.h"
+#include "random.h"
+#include "script/sign.h"
+#include "script/standard.h"
+#include "validation.h"
+
+#include <map>
 #include <set>
 #include <stdint.h>
 #include <utility>
@@ -361,4 +370,443 @@ BOOST_AUTO_TEST_CASE(ApproximateBestSubset)
     BOOST_CHECK_EQUAL(setCoinsRet.size(), 101);
 }
 
+/** A wallet that can be encrypted in memory, EncryptWallet also rewrites the database file */
+class CHDTestWallet : public CWallet
+{
+public:
+    CHDTestWallet(const std::string& strWalletFileIn) : CWallet(strWalletFileIn) {}
+
+    void EncryptInMemory()
+    {
+        CKeyingMaterial vMasterKey(WALLET_CRYPTO_KEY_SIZE);
+        GetRandBytes(&vMasterKey[0], WALLET_CRYPTO_KEY_SIZE);
+        BOOST_REQUIRE(EncryptKeys(vMasterKey));
+        BOOST_REQUIRE(EncryptHDChain(vMasterKey));
+        BOOST_REQUIRE(IsLocked());
+        BOOST_REQUIRE(CCryptoKeyStore::Unlock(vMasterKey));
+    }
+};
+
+static void TestHDKeyPoolTopUp(bool fEncrypt)
+{
+    // enough keys for the batch to be derived on several threads
+    const unsigned int nKeys = 1000;
+    const uint32_t nSkippedChild = 5;
+
+    CHDTestWallet hdwallet(fEncrypt ? "wallet_hd_crypted.dat" : "wallet_hd.dat");
+    LOCK(hdwallet.cs_wallet);
+
+    hdwallet.GenerateNewHDChain();
+    BOOST_REQUIRE(hdwallet.IsHDEnabled());
+    CHDChain hdChain;
+    BOOST_REQUIRE(hdwallet.GetHDChain(hdChain));
+
+    // a child key the wallet already holds is not handed out again
+    CExtKey extKeySkipped;
+    hdChain.DeriveChildExtKey(0, false, nSkippedChild, extKeySkipped);
+    BOOST_CHECK(hdwallet.AddKeyPubKey(extKeySkipped.key, extKeySkipped.key.GetPubKey()));
+
+    if (fEncrypt)
+        hdwallet.EncryptInMemory();
+
+    BOOST_CHECK(hdwallet.TopUpKeyPool(nKeys));
+    BOOST_CHECK_EQUAL(hdwallet.KeypoolCountExternalKeys(), nKeys);
+    BOOST_CHECK_EQUAL(hdwallet.KeypoolCountInternalKeys(), nKeys);
+
+    CHDChain hdChainNew;
+    CHDAccount acc;
+    BOOST_CHECK(hdwallet.GetHDChain(hdChainNew));
+    BOOST_CHECK(hdChainNew.GetAccount(0, acc));
+    BOOST_CHECK_EQUAL(acc.nExternalChainCounter, nKeys + 1);
+    BOOST_CHECK_EQUAL(acc.nInternalChainCounter, nKeys);
+
+    // every pool key is the child of the seed at its index, on its own chain
+    std::set<uint32_t> setChildren[2];
+    CWalletDB walletdb(hdwallet.strWalletFile);
+    for (int64_t nIndex = 1; nIndex <= 2 * nKeys; nIndex++) {
+        CKeyPool keypool;
+        BOOST_REQUIRE(walletdb.ReadPool(nIndex, keypool));
+        CKeyID keyid = keypool.vchPubKey.GetID();
+
+        std::map<CKeyID, CHDPubKey>::const_iterator it = hdwallet.mapHdPubKeys.find(keyid);
+        BOOST_REQUIRE(it != hdwallet.mapHdPubKeys.end());
+        BOOST_CHECK_EQUAL(it->second.nChangeIndex, keypool.fInternal ? 1U : 0U);
+        uint32_t nChild = it->second.extPubKey.nChild;
+        BOOST_CHECK(setChildren[keypool.fInternal].insert(nChild).second);
+
+        CExtKey extKey;
+        hdChain.DeriveChildExtKey(0, keypool.fInternal, nChild, extKey);
+        BOOST_CHECK(extKey.key.GetPubKey() == keypool.vchPubKey);
+
+        CKey key;
+        BOOST_CHECK(hdwallet.GetKey(keyid, key));
+        BOOST_CHECK(key == extKey.key);
+    }
+    BOOST_CHECK_EQUAL(setChildren[0].size(), nKeys);
+    BOOST_CHECK_EQUAL(setChildren[1].size(), nKeys);
+    BOOST_CHECK(!setChildren[0].count(nSkippedChild));
+    BOOST_CHECK_EQUAL(*setChildren[0].rbegin(), nKeys);
+    BOOST_CHECK_EQUAL(*setChildren[1].rbegin(), nKeys - 1);
+
+    // single keys continue where the batch stopped
+    CExtKey extKeyNext;
+    hdChain.DeriveChildExtKey(0, true, nKeys, extKeyNext);
+    BOOST_CHECK(hdwallet.GenerateNewKey(0, true) == extKeyNext.key.GetPubKey());
+    BOOST_CHECK(hdwallet.GetHDChain(hdChainNew));
+    BOOST_CHECK(hdChainNew.GetAccount(0, acc));
+    BOOST_CHECK_EQUAL(acc.nInternalChainCounter, nKeys + 1);
+}
+
+BOOST_AUTO_TEST_CASE(hd_keypool_topup)
+{
+    TestHDKeyPoolTopUp(false);
+}
+
+BOOST_AUTO_TEST_CASE(hd_keypool_topup_encrypted)
+{
+    TestHDKeyPoolTopUp(true);
+}
+
+static int RescanWallet(const std::string& strWalletFile, const std::vector<CKey>& keys, std::set<uint256>& setTxRet)
+{
+    CWallet rescanWallet(strWalletFile);
+    {
+        LOCK(rescanWallet.cs_wallet);
+        BOOST_FOREACH(const CKey& key, keys)
+            BOOST_CHECK(rescanWallet.AddKeyPubKey(key, key.GetPubKey()));
+    }
+
+    CWalletRescanReserver reserver(&rescanWallet);
+    BOOST_REQUIRE(reserver.Reserve());
+    int nFound = rescanWallet.ScanForWalletTransactions(chainActive.Genesis(), reserver);
+
+    LOCK(rescanWallet.cs_wallet);
+    BOOST_FOREACH(const PAIRTYPE(uint256, CWalletTx)& item, rescanWallet.mapWallet)
+        setTxRet.insert(item.first);
+    return nFound;
+}
+
+BOOST_FIXTURE_TEST_CASE(rescan_block_filters, TestChain100Setup)
+{
+    fBlockFilterIndex = true;
+
+    std::vector<CKey> keys(2);
+    keys[0].MakeNewKey(true);
+    keys[1].MakeNewKey(true);
+    std::vector<CPubKey> pubkeys;
+    pubkeys.push_back(keys[0].GetPubKey());
+    pubkeys.push_back(keys[1].GetPubKey());
+    CScript scriptCoinbase = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CScript scriptMultisig = GetScriptForMultisig(1, pubkeys);
+    CScript scriptKey = GetScriptForDestination(keys[0].GetPubKey().GetID());
+
+    // pay a bare multisig output of wallet keys, which the wallet does not know as a script
+    CMutableTransaction txMultisig;
+    txMultisig.vin.resize(1);
+    txMultisig.vin[0].prevout = COutPoint(coinbaseTxns[0].GetHash(), 0);
+    txMultisig.vout.resize(1);
+    txMultisig.vout[0].nValue = coinbaseTxns[0].vout[0].nValue;
+    txMultisig.vout[0].scriptPubKey = scriptMultisig;
+    {
+        std::vector<unsigned char> vchSig;
+        uint256 hash = SignatureHash(scriptCoinbase, txMultisig, 0, SIGHASH_ALL);
+        BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        txMultisig.vin[0].scriptSig = CScript() << vchSig;
+    }
+    CreateAndProcessBlock(std::vector<CMutableTransaction>(1, txMultisig), scriptCoinbase);
+
+    // a block that does not involve the wallet
+    CreateAndProcessBlock(std::vector<CMutableTransaction>(), scriptCoinbase);
+
+    // spend the multisig output, the block only refers to it through the spent coin
+    CMutableTransaction txSpend;
+    txSpend.vin.resize(1);
+    txSpend.vin[0].prevout = COutPoint(txMultisig.GetHash(), 0);
+    txSpend.vout.resize(1);
+    txSpend.vout[0].nValue = txMultisig.vout[0].nValue;
+    txSpend.vout[0].scriptPubKey = scriptCoinbase;
+    {
+        std::vector<unsigned char> vchSig;
+        uint256 hash = SignatureHash(scriptMultisig, txSpend, 0, SIGHASH_ALL);
+        BOOST_CHECK(keys[1].Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        txSpend.vin[0].scriptSig = CScript() << OP_0 << vchSig;
+    }
+    CreateAndProcessBlock(std::vector<CMutableTransaction>(1, txSpend), scriptKey);
+    BOOST_CHECK_EQUAL(chainActive.Height(), 103);
+
+    std::set<uint256> setTxFiltered, setTxFull;
+    int nFiltered = RescanWallet("wallet_rescan_filtered.dat", keys, setTxFiltered);
+    fBlockFilterIndex = false;
+    int nFull = RescanWallet("wallet_rescan_full.dat", keys, setTxFull);
+
+    // the payment to the multisig output, its spend and the coinbase paying scriptKey
+    BOOST_CHECK_EQUAL(nFull, 3);
+    BOOST_CHECK_EQUAL(nFiltered, nFull);
+    BOOST_CHECK(setTxFiltered == setTxFull);
+    BOOST_CHECK(setTxFull.count(txMultisig.GetHash()));
+    BOOST_CHECK(setTxFull.count(txSpend.GetHash()));
+}
+
+BOOST_AUTO_TEST_CASE(rescan_reserver)
+{
+    {
+        CWalletRescanReserver reserver(&wallet);
+        BOOST_CHECK(reserver.Reserve());
+        BOOST_CHECK(reserver.IsReserved());
+        BOOST_CHECK(wallet.IsScanning());
+
+        // a second rescan is refused while the first one runs
+        CWalletRescanReserver reserver2(&wallet);
+        BOOST_CHECK(!reserver2.Reserve());
+        BOOST_CHECK(!reserver2.IsReserved());
+
+        wallet.AbortRescan();
+        BOOST_CHECK(wallet.IsAbortingRescan());
+    }
+
+    // releasing the reservation clears the abort request as well
+    BOOST_CHECK(!wallet.IsScanning());
+    BOOST_CHECK(!wallet.IsAbortingRescan());
+
+    CWalletRescanReserver reserver(&wallet);
+    BOOST_CHECK(reserver.Reserve());
+}
+
+typedef std::vector<std::pair<CTransaction, unsigned int> > SpentOutputs;
+
+static CMutableTransaction CreateSpend(const CKeyStore& keystore, const SpentOutputs& vSpent, const std::vector<CTxOut>& vOutputs)
+{
+    CMutableTransaction tx;
+    BOOST_FOREACH(const PAIRTYPE(CTransaction, unsigned int)& spent, vSpent)
+        tx.vin.push_back(CTxIn(COutPoint(spent.first.GetHash(), spent.second)));
+    tx.vout = vOutputs;
+    for (unsigned int i = 0; i < vSpent.size(); i++)
+        BOOST_CHECK(SignSignature(keystore, vSpent[i].first, tx, i));
+    return tx;
+}
+
+BOOST_FIXTURE_TEST_CASE(import_key_wallet_utxo, TestChain100Setup)
+{
+    std::vector<CKey> keys(3);
+    for (size_t i = 0; i < keys.size(); i++)
+        keys[i].MakeNewKey(true);
+    CBasicKeyStore keystore;
+    keystore.AddKey(coinbaseKey);
+    CScript scriptCoinbase = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CScript scriptWatched = GetScriptForDestination(keys[2].GetPubKey().GetID());
+    {
+        LOCK(pwalletMain->cs_wallet);
+        BOOST_CHECK(pwalletMain->AddKeyPubKey(keys[0], keys[0].GetPubKey()));
+    }
+
+    // one output the wallet owns, one of a key it gets later and one of a script it watches later
+    std::vector<CTxOut> vOutputs;
+    vOutputs.push_back(CTxOut(10 * COIN, GetScriptForDestination(keys[0].GetPubKey().GetID())));
+    vOutputs.push_back(CTxOut(20 * COIN, GetScriptForDestination(keys[1].GetPubKey().GetID())));
+    vOutputs.push_back(CTxOut(30 * COIN, scriptWatched));
+    vOutputs.push_back(CTxOut(coinbaseTxns[0].vout[0].nValue - 60 * COIN, scriptCoinbase));
+    CMutableTransaction tx = CreateSpend(keystore, SpentOutputs(1, std::make_pair(coinbaseTxns[0], 0U)), vOutputs);
+    CreateAndProcessBlock(std::vector<CMutableTransaction>(1, tx), scriptCoinbase);
+
+    std::vector<COutput> vAvailable;
+    pwalletMain->AvailableCoins(vAvailable);
+    BOOST_CHECK_EQUAL(vAvailable.size(), 1U);
+    BOOST_CHECK_EQUAL(pwalletMain->GetBalance(), 10 * COIN);
+    BOOST_CHECK_EQUAL(pwalletMain->GetWatchOnlyBalance(), 0);
+
+    // importprivkey and importaddress without a rescan
+    {
+        LOCK2(cs_main, pwalletMain->cs_wallet);
+        BOOST_CHECK(pwalletMain->AddKeyPubKey(keys[1], keys[1].GetPubKey()));
+        BOOST_CHECK(pwalletMain->AddWatchOnly(scriptWatched));
+        pwalletMain->AddMissingWalletUTXOs();
+    }
+
+    pwalletMain->AvailableCoins(vAvailable);
+    BOOST_CHECK_EQUAL(vAvailable.size(), 3U);
+    int nSpendable = 0;
+    BOOST_FOREACH(const COutput& out, vAvailable)
+        if (out.fSpendable)
+            nSpendable++;
+    BOOST_CHECK_EQUAL(nSpendable, 2);
+    BOOST_CHECK_EQUAL(pwalletMain->GetBalance(), 30 * COIN);
+    BOOST_CHECK_EQUAL(pwalletMain->GetWatchOnlyBalance(), 30 * COIN);
+}
+
+static std::set<COutPoint> AvailableDenominatedOutpoints(int nRoundsMin, int nRoundsMax)
+{
+    std::vector<COutput> vCoins;
+    pwalletMain->AvailableDenominatedCoins(vCoins, CPrivateSend::GetStandardDenominations(), nRoundsMin, nRoundsMax);
+    std::set<COutPoint> setOutpoints;
+    BOOST_FOREACH(const COutput& out, vCoins)
+        BOOST_CHECK(setOutpoints.insert(COutPoint(out.tx->GetHash(), out.i)).second);
+    return setOutpoints;
+}
+
+BOOST_FIXTURE_TEST_CASE(denominated_wallet_utxo, TestChain100Setup)
+{
+    CPrivateSend::InitStandardDenominations();
+    int nPrivateSendRoundsPrev = privateSendClient.nPrivateSendRounds;
+    privateSendClient.nPrivateSendRounds = 16;
+    const CAmount nDenom = COIN + 1000;
+    BOOST_REQUIRE(CPrivateSend::IsDenominatedAmount(nDenom));
+
+    CKey key;
+    key.MakeNewKey(true);
+    CBasicKeyStore keystore;
+    keystore.AddKey(coinbaseKey);
+    keystore.AddKey(key);
+    CScript scriptCoinbase = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CScript scriptKey = GetScriptForDestination(key.GetPubKey().GetID());
+    {
+        LOCK(pwalletMain->cs_wallet);
+        BOOST_CHECK(pwalletMain->AddKeyPubKey(key, key.GetPubKey()));
+    }
+
+    // four denominations next to the change, none of them mixed yet
+    std::vector<CTxOut> vOutputs(4, CTxOut(nDenom, scriptKey));
+    vOutputs.push_back(CTxOut(coinbaseTxns[0].vout[0].nValue - 4 * nDenom, scriptKey));
+    CTransaction tx0 = CreateSpend(keystore, SpentOutputs(1, std::make_pair(coinbaseTxns[0], 0U)), vOutputs);
+    CreateAndProcessBlock(std::vector<CMutableTransaction>(1, tx0), scriptCoinbase);
+
+    // a round mixing two of them, then a second round for one of its outputs
+    SpentOutputs vSpent;
+    vSpent.push_back(std::make_pair(tx0, 0U));
+    vSpent.push_back(std::make_pair(tx0, 1U));
+    CTransaction tx1 = CreateSpend(keystore, vSpent, std::vector<CTxOut>(2, CTxOut(nDenom, scriptKey)));
+    CTransaction tx2 = CreateSpend(keystore, SpentOutputs(1, std::make_pair(tx1, 0U)), std::vector<CTxOut>(1, CTxOut(nDenom, scriptKey)));
+    std::vector<CMutableTransaction> vTxns;
+    vTxns.push_back(tx1);
+    vTxns.push_back(tx2);
+    CreateAndProcessBlock(vTxns, scriptCoinbase);
+
+    std::map<COutPoint, int> mapExpected;
+    mapExpected[COutPoint(tx0.GetHash(), 2)] = 0;
+    mapExpected[COutPoint(tx0.GetHash(), 3)] = 0;
+    mapExpected[COutPoint(tx1.GetHash(), 1)] = 1;
+    mapExpected[COutPoint(tx2.GetHash(), 0)] = 2;
+    BOOST_FOREACH(const PAIRTYPE(COutPoint, int)& expected, mapExpected)
+        BOOST_CHECK_EQUAL(pwalletMain->GetOutpointPrivateSendRounds(expected.first), expected.second);
+
+    // every bucket holds the outputs with its number of rounds, spent outputs are gone
+    std::set<COutPoint> setAll;
+    for (int nRounds = 0; nRounds <= privateSendClient.nPrivateSendRounds; nRounds++) {
+        std::set<COutPoint> setBucket = AvailableDenominatedOutpoints(nRounds, nRounds + 1);
+        BOOST_FOREACH(const COutPoint& outpoint, setBucket) {
+            BOOST_CHECK_EQUAL(pwalletMain->GetOutpointPrivateSendRounds(outpoint), nRounds);
+            setAll.insert(outpoint);
+        }
+    }
+    BOOST_CHECK_EQUAL(setAll.size(), mapExpected.size());
+    BOOST_FOREACH(const PAIRTYPE(COutPoint, int)& expected, mapExpected)
+        BOOST_CHECK(setAll.count(expected.first));
+
+    // the same coins as the selection over all outputs
+    std::vector<COutput> vCoins;
+    pwalletMain->AvailableCoins(vCoins, true, NULL, false, ONLY_DENOMINATED);
+    BOOST_CHECK_EQUAL(vCoins.size(), mapExpected.size());
+    for (int nRoundsMin = 0; nRoundsMin <= 3; nRoundsMin++) {
+        for (int nRoundsMax = nRoundsMin + 1; nRoundsMax <= 4; nRoundsMax++) {
+            std::set<COutPoint> setFiltered;
+            BOOST_FOREACH(const COutput& out, vCoins) {
+                COutPoint outpoint(out.tx->GetHash(), out.i);
+                int nRounds = pwalletMain->GetOutpointPrivateSendRounds(outpoint);
+                if (nRounds >= nRoundsMin && nRounds < nRoundsMax)
+                    setFiltered.insert(outpoint);
+            }
+            BOOST_CHECK(AvailableDenominatedOutpoints(nRoundsMin, nRoundsMax) == setFiltered);
+        }
+    }
+
+    privateSendClient.nPrivateSendRounds = nPrivateSendRoundsPrev;
+}
+
+static void CheckBalancesRecomputed()
+{
+    CWalletBalances cached = pwalletMain->GetBalances();
+    pwalletMain->MarkDirty();
+    CWalletBalances balances = pwalletMain->GetBalances();
+    BOOST_CHECK_EQUAL(cached.nBalance, balances.nBalance);
+    BOOST_CHECK_EQUAL(cached.nUnconfirmedBalance, balances.nUnconfirmedBalance);
+    BOOST_CHECK_EQUAL(cached.nImmatureBalance, balances.nImmatureBalance);
+    BOOST_CHECK_EQUAL(cached.nWatchOnlyBalance, balances.nWatchOnlyBalance);
+    BOOST_CHECK_EQUAL(cached.nUnconfirmedWatchOnlyBalance, balances.nUnconfirmedWatchOnlyBalance);
+    BOOST_CHECK_EQUAL(cached.nImmatureWatchOnlyBalance, balances.nImmatureWatchOnlyBalance);
+    BOOST_CHECK_EQUAL(cached.nAnonymizedBalance, balances.nAnonymizedBalance);
+    BOOST_CHECK_EQUAL(cached.nDenominatedConfirmedBalance, balances.nDenominatedConfirmedBalance);
+    BOOST_CHECK_EQUAL(cached.nDenominatedUnconfirmedBalance, balances.nDenominatedUnconfirmedBalance);
+}
+
+BOOST_FIXTURE_TEST_CASE(balances_cache, TestChain100Setup)
+{
+    std::vector<CKey> keys(2);
+    keys[0].MakeNewKey(true);
+    keys[1].MakeNewKey(true);
+    CBasicKeyStore keystore;
+    keystore.AddKey(coinbaseKey);
+    CScript scriptCoinbase = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    {
+        LOCK(pwalletMain->cs_wallet);
+        BOOST_CHECK(pwalletMain->AddKeyPubKey(keys[0], keys[0].GetPubKey()));
+    }
+
+    // a tip change: an immature coinbase of the wallet
+    CBlock blockCoinbase = CreateAndProcessBlock(std::vector<CMutableTransaction>(), GetScriptForDestination(keys[0].GetPubKey().GetID()));
+    CWalletBalances balances = pwalletMain->GetBalances();
+    CAmount nImmature = balances.nImmatureBalance;
+    BOOST_CHECK(nImmature > 0);
+    BOOST_CHECK_EQUAL(balances.nBalance, 0);
+    CheckBalancesRecomputed();
+
+    // a new wallet transaction at the same tip
+    std::vector<CTxOut> vOutputs(1, CTxOut(coinbaseTxns[0].vout[0].nValue, GetScriptForDestination(keys[1].GetPubKey().GetID())));
+    CMutableTransaction tx = CreateSpend(keystore, SpentOutputs(1, std::make_pair(coinbaseTxns[0], 0U)), vOutputs);
+    CBlock block = CreateAndProcessBlock(std::vector<CMutableTransaction>(1, tx), scriptCoinbase);
+    BOOST_CHECK_EQUAL(pwalletMain->GetBalances().nBalance, 0);
+    {
+        LOCK2(cs_main, pwalletMain->cs_wallet);
+        BOOST_CHECK(pwalletMain->AddKeyPubKey(keys[1], keys[1].GetPubKey()));
+        pwalletMain->SyncTransaction(tx, &block);
+    }
+    balances = pwalletMain->GetBalances();
+    BOOST_CHECK_EQUAL(balances.nBalance, tx.vout[0].nValue);
+    BOOST_CHECK_EQUAL(balances.nImmatureBalance, nImmature);
+    CheckBalancesRecomputed();
+
+    // locked coins still count
+    COutPoint outpoint(tx.GetHash(), 0);
+    {
+        LOCK(pwalletMain->cs_wallet);
+        pwalletMain->LockCoin(outpoint);
+    }
+    BOOST_CHECK_EQUAL(pwalletMain->GetBalances().nBalance, tx.vout[0].nValue);
+    CheckBalancesRecomputed();
+    {
+        LOCK(pwalletMain->cs_wallet);
+        pwalletMain->UnlockCoin(outpoint);
+    }
+    BOOST_CHECK_EQUAL(pwalletMain->GetBalances().nBalance, tx.vout[0].nValue);
+    CheckBalancesRecomputed();
+
+    // every new tip until the coinbase matures
+    int nBlocksToMaturity;
+    {
+        LOCK2(cs_main, pwalletMain->cs_wallet);
+        const CWalletTx* pcoinbase = pwalletMain->GetWalletTx(blockCoinbase.vtx[0].GetHash());
+        BOOST_REQUIRE(pcoinbase != NULL);
+        nBlocksToMaturity = pcoinbase->GetBlocksToMaturity();
+    }
+    BOOST_CHECK(nBlocksToMaturity > 0);
+    for (int i = 0; i < nBlocksToMaturity; i++) {
+        BOOST_CHECK_EQUAL(pwalletMain->GetBalances().nImmatureBalance, nImmature);
+        CreateAndProcessBlock(std::vector<CMutableTransaction>(), scriptCoinbase);
+    }
+    balances = pwalletMain->GetBalances();
+    BOOST_CHECK_EQUAL(balances.nImmatureBalance, 0);
+    BOOST_CHECK_EQUAL(balances.nBalance, tx.vout[0].nValue + nImmature);
+    CheckBalancesRecomputed();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -8,11 +8,13 @@
 #include "wallet/wallet.h"
 
 #include "base58.h"
+#include "blockfilter.h"
 #include "checkpoints.h"
 #include "chain.h"
 #include "coincontrol.h"
 #include "consensus/consensus.h"
 #include "consensus/validation.h"
+#include "init.h"
 #include "key.h"
 #include "keystore.h"
 #include "validation.h"
@@ -23,6 +25,7 @@
 #include "script/script.h"
 #include "script/sign.h"
 #include "timedata.h"
+#include "txdb.h"
 #include "txmempool.h"
 #include "util.h"
 #include "utilmoneystr.h"
@@ -36,6 +39,7 @@
 #include <assert.h>
 
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/thread.hpp>
 
@@ -115,8 +119,9 @@ CPubKey CWallet::GenerateNewKey(uint32_t nAccountIndex, bool fInternal)
     CPubKey pubkey;
     // use HD key derivation if HD was enabled during wallet creation
     if (IsHDEnabled()) {
-        DeriveNewChildKey(metadata, secret, nAccountIndex, fInternal);
-        pubkey = secret.GetPubKey();
+        std::vector<CPubKey> vPubKeys;
+        DeriveNewChildKeys(metadata, nAccountIndex, fInternal, 1, vPubKeys, NULL);
+        pubkey = vPubKeys[0];
     } else {
         secret.MakeNewKey(fCompressed);
 
@@ -138,45 +143,117 @@ CPubKey CWallet::GenerateNewKey(uint32_t nAccountIndex, bool fInternal)
     return pubkey;
 }
 
-void CWallet::DeriveNewChildKey(const CKeyMetadata& metadata, CKey& secretRet, uint32_t nAccountIndex, bool fInternal)
+/** Below this many keys per thread a batch of HD child keys is derived on fewer threads */
+static const unsigned int HD_DERIVE_MIN_KEYS_PER_THREAD = 64;
+static const int HD_DERIVE_MAX_THREADS = 8;
+
+static void DeriveExtPubKeyRange(const CExtPubKey& extPubKey, uint32_t nChildIndex, std::vector<CExtPubKey>& vExtPubKeys, size_t nBegin, size_t nEnd, int& fFailed)
 {
-    CHDChain hdChainTmp;
-    if (!GetHDChain(hdChainTmp)) {
-        throw std::runtime_error(std::string(__func__) + ": GetHDChain failed");
+    for (size_t i = nBegin; i < nEnd; i++) {
+        if (!extPubKey.Derive(vExtPubKeys[i], nChildIndex + i))
+            fFailed = 1;
     }
+}
 
+/** Derive the children nChildIndex .. nChildIndex + nCount - 1 of an extended public key, split over threads for large batches */
+static bool DeriveExtPubKeys(const CExtPubKey& extPubKey, uint32_t nChildIndex, unsigned int nCount, std::vector<CExtPubKey>& vExtPubKeysRet)
+{
+    vExtPubKeysRet.resize(nCount);
+
+    int nThreads = std::max(1, std::min(std::min(GetNumCores(), HD_DERIVE_MAX_THREADS), (int)(nCount / HD_DERIVE_MIN_KEYS_PER_THREAD)));
+    size_t nPerThread = (nCount + nThreads - 1) / nThreads;
+    std::vector<int> vfFailed(nThreads, 0);
+
+    boost::thread_group threadGroup;
+    for (int i = 1; i < nThreads; i++)
+        threadGroup.create_thread(boost::bind(&DeriveExtPubKeyRange, boost::cref(extPubKey), nChildIndex, boost::ref(vExtPubKeysRet),
+                                              std::min((size_t)nCount, i * nPerThread), std::min((size_t)nCount, (i + 1) * nPerThread), boost::ref(vfFailed[i])));
+    DeriveExtPubKeyRange(extPubKey, nChildIndex, vExtPubKeysRet, 0, std::min((size_t)nCount, nPerThread), vfFailed[0]);
+    threadGroup.join_all();
+
+    return std::count(vfFailed.begin(), vfFailed.end(), 1) == 0;
+}
+
+CExtPubKey CWallet::GetHDChainExtPubKey(const CHDChain& hdChain, uint32_t nAccountIndex, bool fInternal)
+{
+    AssertLockHeld(cs_wallet);
+
+    // cached keys belong to one seed
+    if (hdChain.GetID() != hdChainExtPubKeysID) {
+        mapHdChainExtPubKeys.clear();
+        hdChainExtPubKeysID = hdChain.GetID();
+    }
+
+    std::map<std::pair<uint32_t, bool>, CExtPubKey>::const_iterator it = mapHdChainExtPubKeys.find(std::make_pair(nAccountIndex, fInternal));
+    if (it != mapHdChainExtPubKeys.end())
+        return it->second;
+
+    CHDChain hdChainTmp(hdChain);
     if (!DecryptHDChain(hdChainTmp))
         throw std::runtime_error(std::string(__func__) + ": DecryptHDChainSeed failed");
     // make sure seed matches this chain
     if (hdChainTmp.GetID() != hdChainTmp.GetSeedHash())
         throw std::runtime_error(std::string(__func__) + ": Wrong HD chain!");
 
+    CExtKey chainKey;
+    hdChainTmp.DeriveChainExtKey(nAccountIndex, fInternal, chainKey);
+    CExtPubKey chainExtPubKey = chainKey.Neuter();
+
+    // children derived from the public key must be the ones GetKey derives from the seed
+    CExtKey childKey;
+    CExtPubKey childExtPubKey;
+    chainKey.Derive(childKey, 0);
+    if (!chainExtPubKey.Derive(childExtPubKey, 0) || childExtPubKey.pubkey != childKey.key.GetPubKey())
+        throw std::runtime_error(std::string(__func__) + ": Derive failed");
+
+    mapHdChainExtPubKeys[std::make_pair(nAccountIndex, fInternal)] = chainExtPubKey;
+    return chainExtPubKey;
+}
+
+void CWallet::DeriveNewChildKeys(const CKeyMetadata& metadata, uint32_t nAccountIndex, bool fInternal, unsigned int nCount, std::vector<CPubKey>& vPubKeysRet, CWalletDB* pwalletdb)
+{
+    AssertLockHeld(cs_wallet); // mapKeyMetadata, mapHdPubKeys
+
+    if (nCount == 0)
+        return;
+
+    CHDChain hdChainCurrent;
+    if (!GetHDChain(hdChainCurrent)) {
+        throw std::runtime_error(std::string(__func__) + ": GetHDChain failed");
+    }
+
     CHDAccount acc;
-    if (!hdChainTmp.GetAccount(nAccountIndex, acc))
+    if (!hdChainCurrent.GetAccount(nAccountIndex, acc))
         throw std::runtime_error(std::string(__func__) + ": Wrong HD account!");
 
-    // derive child key at next index, skip keys already known to the wallet
-    CExtKey childKey;
+    // only the chain key needs the seed, the child keys are derived from its public key
+    CExtPubKey chainExtPubKey = GetHDChainExtPubKey(hdChainCurrent, nAccountIndex, fInternal);
+
+    // derive child keys at next indexes, skip keys already known to the wallet
+    std::vector<CExtPubKey> vChildKeys;
     uint32_t nChildIndex = fInternal ? acc.nInternalChainCounter : acc.nExternalChainCounter;
-    do {
-        hdChainTmp.DeriveChildExtKey(nAccountIndex, fInternal, nChildIndex, childKey);
-        // increment childkey index
-        nChildIndex++;
-    } while (HaveKey(childKey.key.GetPubKey().GetID()));
-    secretRet = childKey.key;
+    while (vChildKeys.size() < nCount) {
+        std::vector<CExtPubKey> vDerived;
+        if (!DeriveExtPubKeys(chainExtPubKey, nChildIndex, nCount - vChildKeys.size(), vDerived))
+            throw std::runtime_error(std::string(__func__) + ": Derive failed");
+        BOOST_FOREACH(const CExtPubKey& childKey, vDerived) {
+            // increment childkey index
+            nChildIndex++;
+            if (!HaveKey(childKey.pubkey.GetID()))
+                vChildKeys.push_back(childKey);
+        }
+    }
 
-    CPubKey pubkey = secretRet.GetPubKey();
-    assert(secretRet.VerifyPubKey(pubkey));
+    BOOST_FOREACH(const CExtPubKey& childKey, vChildKeys)
+        vPubKeysRet.push_back(childKey.pubkey);
 
     // store metadata
-    mapKeyMetadata[pubkey.GetID()] = metadata;
+    BOOST_FOREACH(const CExtPubKey& childKey, vChildKeys)
+        mapKeyMetadata[childKey.pubkey.GetID()] = metadata;
     if (!nTimeFirstKey || metadata.nCreateTime < nTimeFirstKey)
         nTimeFirstKey = metadata.nCreateTime;
 
-    // update the chain model in the database
-    CHDChain hdChainCurrent;
-    GetHDChain(hdChainCurrent);
-
+    // update the chain model in the database, once for the whole batch
     if (fInternal) {
         acc.nInternalChainCounter = nChildIndex;
     }
@@ -188,16 +265,22 @@ void CWallet::DeriveNewChildKey(const CKeyMetadata& metadata, CKey& secretRet, u
         throw std::runtime_error(std::string(__func__) + ": SetAccount failed");
 
     if (IsCrypted()) {
-        if (!SetCryptedHDChain(hdChainCurrent, false))
+        if (!SetCryptedHDChain(hdChainCurrent, pwalletdb != NULL))
             throw std::runtime_error(std::string(__func__) + ": SetCryptedHDChain failed");
+        if (pwalletdb && (!fFileBacked || !pwalletdb->WriteCryptedHDChain(hdChainCurrent)))
+            throw std::runtime_error(std::string(__func__) + ": WriteCryptedHDChain failed");
     }
     else {
-        if (!SetHDChain(hdChainCurrent, false))
+        if (!SetHDChain(hdChainCurrent, pwalletdb != NULL))
             throw std::runtime_error(std::string(__func__) + ": SetHDChain failed");
+        if (pwalletdb && !pwalletdb->WriteHDChain(hdChainCurrent))
+            throw std::runtime_error(std::string(__func__) + ": WriteHDChain failed");
     }
 
-    if (!AddHDPubKey(childKey.Neuter(), fInternal))
-        throw std::runtime_error(std::string(__func__) + ": AddHDPubKey failed");
+    BOOST_FOREACH(const CExtPubKey& childKey, vChildKeys) {
+        if (!AddHDPubKey(childKey, fInternal, pwalletdb))
+            throw std::runtime_error(std::string(__func__) + ": AddHDPubKey failed");
+    }
 }
 
 bool CWallet::GetPubKey(const CKeyID &address, CPubKey& vchPubKeyOut) const
@@ -258,7 +341,7 @@ bool CWallet::LoadHDPubKey(const CHDPubKey &hdPubKey)
     return true;
 }
 
-bool CWallet::AddHDPubKey(const CExtPubKey &extPubKey, bool fInternal)
+bool CWallet::AddHDPubKey(const CExtPubKey &extPubKey, bool fInternal, CWalletDB* pwalletdb)
 {
     AssertLockHeld(cs_wallet);
 
@@ -275,14 +358,16 @@ bool CWallet::AddHDPubKey(const CExtPubKey &extPubKey, bool fInternal)
     CScript script;
     script = GetScriptForDestination(extPubKey.pubkey.GetID());
     if (HaveWatchOnly(script))
-        RemoveWatchOnly(script);
+        RemoveWatchOnly(script, pwalletdb);
     script = GetScriptForRawPubKey(extPubKey.pubkey);
     if (HaveWatchOnly(script))
-        RemoveWatchOnly(script);
+        RemoveWatchOnly(script, pwalletdb);
 
     if (!fFileBacked)
         return true;
 
+    if (pwalletdb)
+        return pwalletdb->WriteHDPubKey(hdPubKey, mapKeyMetadata[extPubKey.pubkey.GetID()]);
     return CWalletDB(strWalletFile).WriteHDPubKey(hdPubKey, mapKeyMetadata[extPubKey.pubkey.GetID()]);
 }
 
@@ -384,15 +469,23 @@ bool CWallet::AddWatchOnly(const CScript &dest)
 }
 
 bool CWallet::RemoveWatchOnly(const CScript &dest)
+{
+    return RemoveWatchOnly(dest, NULL);
+}
+
+bool CWallet::RemoveWatchOnly(const CScript &dest, CWalletDB* pwalletdb)
 {
     AssertLockHeld(cs_wallet);
     if (!CCryptoKeyStore::RemoveWatchOnly(dest))
         return false;
     if (!HaveWatchOnly())
         NotifyWatchonlyChanged(false);
-    if (fFileBacked)
+    if (fFileBacked) {
+        if (pwalletdb)
+            return pwalletdb->EraseWatchOnly(dest);
         if (!CWalletDB(strWalletFile).EraseWatchOnly(dest))
             return false;
+    }
 
     return true;
 }
@@ -702,7 +795,7 @@ bool CWallet::IsSpent(const uint256& hash, unsigned int n) const
 void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
 {
     mapTxSpends.insert(make_pair(outpoint, wtxid));
-    setWalletUTXO.erase(outpoint);
+    RemoveFromWalletUTXO(outpoint);
 
     pair<TxSpends::iterator, TxSpends::iterator> range;
     range = mapTxSpends.equal_range(outpoint);
@@ -710,6 +803,71 @@ void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
 }
 
 
+void CWallet::AddToWalletUTXO(const COutPoint& outpoint)
+{
+    if (!setWalletUTXO.insert(outpoint).second)
+        return;
+
+    std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
+    if (it == mapWallet.end() || outpoint.n >= it->second.vout.size())
+        return;
+
+    const CAmount nValue = it->second.vout[outpoint.n].nValue;
+    if (CPrivateSend::IsDenominatedAmount(nValue))
+        mapDenominatedUTXO[nValue][GetRealOutpointPrivateSendRounds(outpoint, 0)].insert(outpoint);
+}
+
+void CWallet::RemoveFromWalletUTXO(const COutPoint& outpoint)
+{
+    if (!setWalletUTXO.erase(outpoint))
+        return;
+
+    std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
+    if (it == mapWallet.end() || outpoint.n >= it->second.vout.size())
+        return;
+
+    const CAmount nValue = it->second.vout[outpoint.n].nValue;
+    std::map<CAmount, denom_rounds_m_t>::iterator itDenom = mapDenominatedUTXO.find(nValue);
+    if (itDenom == mapDenominatedUTXO.end())
+        return;
+
+    // rounds are memoized, so this is the bucket the outpoint was added to
+    denom_rounds_m_t::iterator itRounds = itDenom->second.find(GetRealOutpointPrivateSendRounds(outpoint, 0));
+    if (itRounds == itDenom->second.end())
+        return;
+    itRounds->second.erase(outpoint);
+    if (itRounds->second.empty())
+        itDenom->second.erase(itRounds);
+    if (itDenom->second.empty())
+        mapDenominatedUTXO.erase(itDenom);
+}
+
+void CWallet::UpdateWalletUTXO(const COutPoint& outpoint)
+{
+    std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
+    if (it == mapWallet.end() || outpoint.n >= it->second.vout.size())
+        return;
+
+    if (IsMine(it->second.vout[outpoint.n]) && !IsSpent(outpoint.hash, outpoint.n))
+        AddToWalletUTXO(outpoint);
+}
+
+void CWallet::GetWalletUTXOTxes(std::vector<const CWalletTx*>& vecTxesRet) const
+{
+    vecTxesRet.clear();
+
+    // setWalletUTXO is ordered by hash, so outputs of the same transaction are next to each other
+    const uint256* phashLast = NULL;
+    for (auto& outpoint : setWalletUTXO) {
+        if (phashLast != NULL && *phashLast == outpoint.hash) continue;
+        phashLast = &outpoint.hash;
+
+        std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
+        if (it != mapWallet.end())
+            vecTxesRet.push_back(&it->second);
+    }
+}
+
 void CWallet::AddToSpends(const uint256& wtxid)
 {
     assert(mapWallet.count(wtxid));
@@ -876,6 +1034,27 @@ void CWallet::MarkDirty()
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    fBalancesCached = false;
+}
+
+void CWallet::AddMissingWalletUTXOs()
+{
+    {
+        LOCK2(cs_main, cs_wallet);
+        for (auto& pair : mapWallet) {
+            for(size_t i = 0; i < pair.second.vout.size(); ++i) {
+                COutPoint outpoint(pair.first, i);
+                if (setWalletUTXO.count(outpoint))
+                    continue;
+                UpdateWalletUTXO(outpoint);
+                // the cached credit of the transaction doesn't include the new output yet
+                if (setWalletUTXO.count(outpoint))
+                    pair.second.MarkDirty();
+            }
+        }
+    }
+
+    fBalancesCached = false;
 }
 
 bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletDB* pwalletdb)
@@ -957,10 +1136,12 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
                              wtxIn.hashBlock.ToString());
             }
             AddToSpends(hash);
-            for(size_t i = 0; i < wtx.vout.size(); ++i) {
-                if (IsMine(wtx.vout[i]) && !IsSpent(hash, i)) {
-                    setWalletUTXO.insert(COutPoint(hash, i));
-                }
+        }
+
+        // Outputs of updated transactions can be ours now too, e.g. after importing a key
+        for(size_t i = 0; i < wtx.vout.size(); ++i) {
+            if (IsMine(wtx.vout[i]) && !IsSpent(hash, i)) {
+                AddToWalletUTXO(COutPoint(hash, i));
             }
         }
 
@@ -1016,6 +1197,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
 
         fAnonymizableTallyCached = false;
         fAnonymizableTallyCachedNonDenom = false;
+        fBalancesCached = false;
 
     }
     return true;
@@ -1113,14 +1295,17 @@ bool CWallet::AbandonTransaction(const uint256& hashTx)
             // available of the outputs it spends. So force those to be recomputed
             BOOST_FOREACH(const CTxIn& txin, wtx.vin)
             {
-                if (mapWallet.count(txin.prevout.hash))
+                if (mapWallet.count(txin.prevout.hash)) {
                     mapWallet[txin.prevout.hash].MarkDirty();
+                    UpdateWalletUTXO(txin.prevout);
+                }
             }
         }
     }
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    fBalancesCached = false;
 
     return true;
 }
@@ -1177,14 +1362,17 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
             // available of the outputs it spends. So force those to be recomputed
             BOOST_FOREACH(const CTxIn& txin, wtx.vin)
             {
-                if (mapWallet.count(txin.prevout.hash))
+                if (mapWallet.count(txin.prevout.hash)) {
                     mapWallet[txin.prevout.hash].MarkDirty();
+                    UpdateWalletUTXO(txin.prevout);
+                }
             }
         }
     }
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    fBalancesCached = false;
 }
 
 void CWallet::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
@@ -1205,6 +1393,7 @@ void CWallet::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    fBalancesCached = false;
 }
 
 
@@ -1242,7 +1431,7 @@ CAmount CWallet::GetDebit(const CTxIn &txin, const isminefilter& filter) const
 // Recursively determine the rounds of a given input (How deep is the PrivateSend chain for a given input)
 int CWallet::GetRealOutpointPrivateSendRounds(const COutPoint& outpoint, int nRounds) const
 {
-    static std::map<uint256, CMutableTransaction> mDenomWtxes;
+    LOCK(cs_wallet);
 
     if(nRounds >= 16) return 15; // 16 rounds max
 
@@ -1250,72 +1439,57 @@ int CWallet::GetRealOutpointPrivateSendRounds(const COutPoint& outpoint, int nRo
     unsigned int nout = outpoint.n;
 
     const CWalletTx* wtx = GetWalletTx(hash);
-    if(wtx != NULL)
-    {
-        std::map<uint256, CMutableTransaction>::const_iterator mdwi = mDenomWtxes.find(hash);
-        if (mdwi == mDenomWtxes.end()) {
-            // not known yet, let's add it
-            LogPrint("privatesend", "GetRealOutpointPrivateSendRounds INSERTING %s\n", hash.ToString());
-            mDenomWtxes[hash] = CMutableTransaction(*wtx);
-        } else if(mDenomWtxes[hash].vout[nout].nRounds != -10) {
-            // found and it's not an initial value, just return it
-            return mDenomWtxes[hash].vout[nout].nRounds;
-        }
-
+    if(wtx == NULL) return nRounds - 1;
 
-        // bounds check
-        if (nout >= wtx->vout.size()) {
-            // should never actually hit this
-            LogPrint("privatesend", "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, -4);
-            return -4;
-        }
+    // found and it's not an initial value, just return it
+    std::map<COutPoint, int>::const_iterator itCache = mapOutpointRoundsCache.find(outpoint);
+    if(itCache != mapOutpointRoundsCache.end()) return itCache->second;
 
-        if (CPrivateSend::IsCollateralAmount(wtx->vout[nout].nValue)) {
-            mDenomWtxes[hash].vout[nout].nRounds = -3;
-            LogPrint("privatesend", "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
-        }
+    // bounds check
+    if (nout >= wtx->vout.size()) {
+        // should never actually hit this
+        LogPrint("privatesend", "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, -4);
+        return -4;
+    }
 
+    int nRoundsRet;
+    if (CPrivateSend::IsCollateralAmount(wtx->vout[nout].nValue)) {
+        nRoundsRet = -3;
+    } else if (!CPrivateSend::IsDenominatedAmount(wtx->vout[nout].nValue)) {
         //make sure the final output is non-denominate
-        if (!CPrivateSend::IsDenominatedAmount(wtx->vout[nout].nValue)) { //NOT DENOM
-            mDenomWtxes[hash].vout[nout].nRounds = -2;
-            LogPrint("privatesend", "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
-        }
-
+        nRoundsRet = -2;
+    } else {
         bool fAllDenoms = true;
-        BOOST_FOREACH(CTxOut out, wtx->vout) {
+        BOOST_FOREACH(const CTxOut& out, wtx->vout) {
             fAllDenoms = fAllDenoms && CPrivateSend::IsDenominatedAmount(out.nValue);
         }
 
-        // this one is denominated but there is another non-denominated output found in the same tx
         if (!fAllDenoms) {
-            mDenomWtxes[hash].vout[nout].nRounds = 0;
-            LogPrint("privatesend", "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
-        }
-
-        int nShortest = -10; // an initial value, should be no way to get this by calculations
-        bool fDenomFound = false;
-        // only denoms here so let's look up
-        BOOST_FOREACH(CTxIn txinNext, wtx->vin) {
-            if (IsMine(txinNext)) {
-                int n = GetRealOutpointPrivateSendRounds(txinNext.prevout, nRounds + 1);
-                // denom found, find the shortest chain or initially assign nShortest with the first found value
-                if(n >= 0 && (n < nShortest || nShortest == -10)) {
-                    nShortest = n;
-                    fDenomFound = true;
+            // this one is denominated but there is another non-denominated output found in the same tx
+            nRoundsRet = 0;
+        } else {
+            int nShortest = -10; // an initial value, should be no way to get this by calculations
+            bool fDenomFound = false;
+            // only denoms here so let's look up
+            BOOST_FOREACH(const CTxIn& txinNext, wtx->vin) {
+                if (IsMine(txinNext)) {
+                    int n = GetRealOutpointPrivateSendRounds(txinNext.prevout, nRounds + 1);
+                    // denom found, find the shortest chain or initially assign nShortest with the first found value
+                    if(n >= 0 && (n < nShortest || nShortest == -10)) {
+                        nShortest = n;
+                        fDenomFound = true;
+                    }
                 }
             }
+            nRoundsRet = fDenomFound
+                    ? (nShortest >= 15 ? 16 : nShortest + 1) // good, we a +1 to the shortest one but only 16 rounds max allowed
+                    : 0;            // too bad, we are the fist one in that chain
         }
-        mDenomWtxes[hash].vout[nout].nRounds = fDenomFound
-                ? (nShortest >= 15 ? 16 : nShortest + 1) // good, we a +1 to the shortest one but only 16 rounds max allowed
-                : 0;            // too bad, we are the fist one in that chain
-        LogPrint("privatesend", "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-        return mDenomWtxes[hash].vout[nout].nRounds;
     }
 
-    return nRounds - 1;
+    mapOutpointRoundsCache.insert(std::make_pair(outpoint, nRoundsRet));
+    LogPrint("privatesend", "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, nRoundsRet);
+    return nRoundsRet;
 }
 
 // respect current settings
@@ -1672,49 +1846,289 @@ bool CWalletTx::WriteToDisk(CWalletDB *pwalletdb)
     return pwalletdb->WriteTx(GetHash(), *this);
 }
 
+namespace {
+
+/**
+ * Read-only copy of the wallet's keys, scripts and watch-only set, taken at
+ * the start of a rescan so that blocks can be matched without cs_wallet.
+ */
+class CRescanKeyStore : public CKeyStore
+{
+private:
+    std::set<CKeyID> setKeys;
+    ScriptMap mapScripts;
+    WatchOnlySet setWatchOnly;
+
+public:
+    CRescanKeyStore(const std::set<CKeyID>& setKeysIn, const ScriptMap& mapScriptsIn, const WatchOnlySet& setWatchOnlyIn) :
+        setKeys(setKeysIn), mapScripts(mapScriptsIn), setWatchOnly(setWatchOnlyIn) {}
+
+    bool AddKeyPubKey(const CKey& /*key*/, const CPubKey& /*pubkey*/) { return false; }
+    bool HaveKey(const CKeyID& address) const { return setKeys.count(address) > 0; }
+    bool GetKey(const CKeyID& /*address*/, CKey& /*keyOut*/) const { return false; }
+    void GetKeys(std::set<CKeyID>& setAddress) const { setAddress = setKeys; }
+    bool GetPubKey(const CKeyID& /*address*/, CPubKey& /*vchPubKeyOut*/) const { return false; }
+
+    bool AddCScript(const CScript& /*redeemScript*/) { return false; }
+    bool HaveCScript(const CScriptID& hash) const { return mapScripts.count(hash) > 0; }
+    bool GetCScript(const CScriptID& hash, CScript& redeemScriptOut) const
+    {
+        ScriptMap::const_iterator mi = mapScripts.find(hash);
+        if (mi == mapScripts.end())
+            return false;
+        redeemScriptOut = mi->second;
+        return true;
+    }
+
+    bool AddWatchOnly(const CScript& /*dest*/) { return false; }
+    bool RemoveWatchOnly(const CScript& /*dest*/) { return false; }
+    bool HaveWatchOnly(const CScript& dest) const { return setWatchOnly.count(dest) > 0; }
+    bool HaveWatchOnly() const { return !setWatchOnly.empty(); }
+};
+
+/**
+ * Reads and deserializes the blocks of a rescan ahead of the caller on
+ * worker threads, and flags which of their transactions pay to the
+ * snapshot keystore. Blocks are handed back in chain order by GetNext.
+ * When given the wallet's filter elements, blocks whose filter rules
+ * them all out are not read at all.
+ */
+class CRescanBlockReader
+{
+public:
+    struct CBlockResult
+    {
+        CBlock block;
+        std::vector<bool> vfMine;
+        bool fRead;
+        //! skipped because its block filter matched none of the wallet's scripts
+        bool fFiltered;
+
+        CBlockResult() : fRead(false), fFiltered(false) {}
+    };
+
+private:
+    static const int MAX_THREADS = 8;
+    static const size_t MAX_READ_AHEAD = 32;
+
+    const std::vector<CBlockIndex*>& vIndex;
+    const CKeyStore& keystore;
+    const CBlockFilter::ElementSet* pFilterElements;
+    const Consensus::Params& consensusParams;
+
+    boost::mutex mutex;
+    boost::condition_variable condWorker;
+    boost::condition_variable condReader;
+    //! position in vIndex of the next block to be picked up by a worker
+    size_t nNextRead;
+    //! position in vIndex of the next block to be returned by GetNext
+    size_t nNextReturn;
+    std::map<size_t, CBlockResult> mapResults;
+    bool fQuit;
+    boost::thread_group threadGroup;
+
+    void ThreadRead()
+    {
+        RenameThread("zixx-rescan");
+        while (true) {
+            size_t nPos;
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                while (!fQuit && (nNextRead >= vIndex.size() || nNextRead >= nNextReturn + MAX_READ_AHEAD))
+                    condWorker.wait(lock);
+                if (fQuit)
+                    return;
+                nPos = nNextRead++;
+            }
+
+            CBlockResult result;
+            if (pFilterElements) {
+                CBlockFilter filter;
+                if (pblocktree->ReadBlockFilter(vIndex[nPos]->GetBlockHash(), filter) && !filter.MatchAny(*pFilterElements))
+                    result.fFiltered = true;
+            }
+            if (!result.fFiltered)
+                result.fRead = ReadBlockFromDisk(result.block, vIndex[nPos], consensusParams);
+            if (result.fRead) {
+                result.vfMine.reserve(result.block.vtx.size());
+                BOOST_FOREACH(const CTransaction& tx, result.block.vtx) {
+                    bool fMine = false;
+                    BOOST_FOREACH(const CTxOut& txout, tx.vout) {
+                        if (::IsMine(keystore, txout.scriptPubKey) != ISMINE_NO) {
+                            fMine = true;
+                            break;
+                        }
+                    }
+                    result.vfMine.push_back(fMine);
+                }
+            }
+
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                mapResults[nPos] = std::move(result);
+            }
+            condReader.notify_one();
+        }
+    }
+
+public:
+    CRescanBlockReader(const std::vector<CBlockIndex*>& vIndexIn, const CKeyStore& keystoreIn, const CBlockFilter::ElementSet* pFilterElementsIn, const Consensus::Params& consensusParamsIn) :
+        vIndex(vIndexIn), keystore(keystoreIn), pFilterElements(pFilterElementsIn), consensusParams(consensusParamsIn),
+        nNextRead(0), nNextReturn(0), fQuit(false)
+    {
+        int nThreads = std::max(1, std::min(GetNumCores(), MAX_THREADS));
+        for (int i = 0; i < nThreads; i++)
+            threadGroup.create_thread(boost::bind(&CRescanBlockReader::ThreadRead, this));
+    }
+
+    ~CRescanBlockReader()
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            fQuit = true;
+        }
+        condWorker.notify_all();
+        threadGroup.join_all();
+    }
+
+    //! Wait for the next block in chain order
+    void GetNext(CBlockResult& result)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        assert(nNextReturn < vIndex.size());
+        std::map<size_t, CBlockResult>::iterator it;
+        while ((it = mapResults.find(nNextReturn)) == mapResults.end())
+            condReader.wait(lock);
+        result = std::move(it->second);
+        mapResults.erase(it);
+        nNextReturn++;
+        condWorker.notify_all();
+    }
+};
+
+void AddFilterElement(CBlockFilter::ElementSet& elements, const CScript& script)
+{
+    elements.insert(CBlockFilter::Element(script.begin(), script.end()));
+}
+
+} // anon namespace
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
  * exist in the wallet will be updated.
+ *
+ * Blocks are read and matched against a snapshot of the wallet's keys
+ * and scripts on worker threads; cs_main and cs_wallet are only taken
+ * per block to apply the matches, and the scan can be stopped with
+ * AbortRescan(). The caller must hold a CWalletRescanReserver.
  */
-int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
+int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, const CWalletRescanReserver& reserver, bool fUpdate)
 {
+    assert(reserver.IsReserved());
+
     int ret = 0;
     int64_t nNow = GetTime();
     const CChainParams& chainParams = Params();
 
-    CBlockIndex* pindex = pindexStart;
+    std::vector<CBlockIndex*> vIndex;
+    std::unique_ptr<CRescanKeyStore> keystore;
+    std::unique_ptr<CBlockFilter::ElementSet> pFilterElements;
+    double dProgressStart;
+    double dProgressTip;
     {
         LOCK2(cs_main, cs_wallet);
 
         // no need to read and scan block, if block was created before
         // our wallet birthday (as adjusted for block time variability)
+        CBlockIndex* pindex = pindexStart;
         while (pindex && nTimeFirstKey && (pindex->GetBlockTime() < (nTimeFirstKey - 7200)))
             pindex = chainActive.Next(pindex);
 
-        ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
-        double dProgressStart = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false);
-        double dProgressTip = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), chainActive.Tip(), false);
-        while (pindex)
+        for (; pindex; pindex = chainActive.Next(pindex))
+            vIndex.push_back(pindex);
+
+        dProgressStart = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), vIndex.empty() ? NULL : vIndex.front(), false);
+        dProgressTip = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), chainActive.Tip(), false);
+
+        LOCK(cs_KeyStore);
+        std::set<CKeyID> setKeys;
+        GetKeys(setKeys);
+        BOOST_FOREACH(const PAIRTYPE(CKeyID, CHDPubKey)& item, mapHdPubKeys)
+            setKeys.insert(item.first);
+        keystore.reset(new CRescanKeyStore(setKeys, mapScripts, setWatchOnly));
+
+        // every script the wallet can own; the scripts of spent outputs are in the
+        // block filters as well, so spends of our coins match through these too.
+        // Bare multisig scripts can not be listed, the filters hold their keys instead.
+        if (fBlockFilterIndex) {
+            pFilterElements.reset(new CBlockFilter::ElementSet());
+            BOOST_FOREACH(const CKeyID& keyid, setKeys) {
+                AddFilterElement(*pFilterElements, GetScriptForDestination(keyid));
+                CPubKey pubkey;
+                if (GetPubKey(keyid, pubkey)) {
+                    AddFilterElement(*pFilterElements, GetScriptForRawPubKey(pubkey));
+                    pFilterElements->insert(CBlockFilter::Element(pubkey.begin(), pubkey.end()));
+                }
+            }
+            BOOST_FOREACH(const PAIRTYPE(CScriptID, CScript)& item, mapScripts) {
+                AddFilterElement(*pFilterElements, item.second);
+                AddFilterElement(*pFilterElements, GetScriptForDestination(item.first));
+            }
+            BOOST_FOREACH(const CScript& script, setWatchOnly)
+                AddFilterElement(*pFilterElements, script);
+        }
+    }
+
+    ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
+    size_t nFiltered = 0;
+    {
+        CRescanBlockReader reader(vIndex, *keystore, pFilterElements.get(), chainParams.GetConsensus());
+        BOOST_FOREACH(CBlockIndex* pindex, vIndex)
         {
+            if (fAbortRescan || ShutdownRequested()) {
+                LogPrintf("Rescan aborted at block %d. Progress=%f\n", pindex->nHeight, Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex));
+                break;
+            }
             if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
                 ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
 
-            CBlock block;
-            ReadBlockFromDisk(block, pindex, Params().GetConsensus());
-            BOOST_FOREACH(CTransaction& tx, block.vtx)
+            CRescanBlockReader::CBlockResult result;
+            reader.GetNext(result);
+            if (result.fFiltered)
+                nFiltered++;
+            if (!result.fRead)
+                continue;
+
             {
-                if (AddToWalletIfInvolvingMe(tx, &block, fUpdate))
-                    ret++;
+                LOCK2(cs_main, cs_wallet);
+                if (!chainActive.Contains(pindex)) {
+                    // the chain was reorganized under us, the remaining blocks are no longer ours to scan
+                    LogPrintf("Rescan stopped at block %d, which is no longer in the active chain\n", pindex->nHeight);
+                    break;
+                }
+                for (size_t i = 0; i < result.block.vtx.size(); i++) {
+                    const CTransaction& tx = result.block.vtx[i];
+                    // only transactions that pay us, spend from us, are already known or touch an outpoint
+                    // we track can change the wallet, skip the rest without looking at them under the lock
+                    bool fRelevant = result.vfMine[i] || mapWallet.count(tx.GetHash());
+                    for (size_t j = 0; !fRelevant && j < tx.vin.size(); j++)
+                        fRelevant = mapWallet.count(tx.vin[j].prevout.hash) || mapTxSpends.count(tx.vin[j].prevout);
+                    if (fRelevant && AddToWalletIfInvolvingMe(tx, &result.block, fUpdate))
+                        ret++;
+                }
             }
-            pindex = chainActive.Next(pindex);
+
             if (GetTime() >= nNow + 60) {
                 nNow = GetTime();
                 LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex));
             }
         }
-        ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
     }
+    ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
+    if (pFilterElements)
+        LogPrintf("Rescan skipped %u of %u blocks using block filters\n", nFiltered, vIndex.size());
+
     return ret;
 }
 
@@ -2129,20 +2543,55 @@ void CWallet::ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman
  */
 
 
-CAmount CWallet::GetBalance() const
+CWalletBalances CWallet::GetBalances() const
 {
-    CAmount nTotal = 0;
+    LOCK2(cs_main, cs_wallet);
+
+    // Wallet changes reset fBalancesCached, trust and maturity of transactions
+    // can also change with the chain tip, the mempool and InstantSend locks
+    if (fBalancesCached &&
+        balancesCached.pindexTip == chainActive.Tip() &&
+        balancesCached.nMempoolUpdated == mempool.GetTransactionsUpdated() &&
+        balancesCached.nCompleteTXLocks == nCompleteTXLocks &&
+        balancesCached.nPrivateSendRounds == privateSendClient.nPrivateSendRounds)
+        return balancesCached;
+
+    CWalletBalances balances;
+    balances.pindexTip = chainActive.Tip();
+    balances.nMempoolUpdated = mempool.GetTransactionsUpdated();
+    balances.nCompleteTXLocks = nCompleteTXLocks;
+    balances.nPrivateSendRounds = privateSendClient.nPrivateSendRounds;
+
+    // transactions without unspent outputs have no credit in any category
+    std::vector<const CWalletTx*> vecTxes;
+    GetWalletUTXOTxes(vecTxes);
+    BOOST_FOREACH(const CWalletTx* pcoin, vecTxes)
     {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableCredit();
+        if (pcoin->IsTrusted()) {
+            balances.nBalance += pcoin->GetAvailableCredit();
+            balances.nWatchOnlyBalance += pcoin->GetAvailableWatchOnlyCredit();
+            if (!fLiteMode)
+                balances.nAnonymizedBalance += pcoin->GetAnonymizedCredit();
+        } else if (pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool()) {
+            balances.nUnconfirmedBalance += pcoin->GetAvailableCredit();
+            balances.nUnconfirmedWatchOnlyBalance += pcoin->GetAvailableWatchOnlyCredit();
+        }
+        balances.nImmatureBalance += pcoin->GetImmatureCredit();
+        balances.nImmatureWatchOnlyBalance += pcoin->GetImmatureWatchOnlyCredit();
+        if (!fLiteMode) {
+            balances.nDenominatedConfirmedBalance += pcoin->GetDenominatedCredit(false);
+            balances.nDenominatedUnconfirmedBalance += pcoin->GetDenominatedCredit(true);
         }
     }
 
-    return nTotal;
+    balancesCached = balances;
+    fBalancesCached = true;
+    return balances;
+}
+
+CAmount CWallet::GetBalance() const
+{
+    return GetBalances().nBalance;
 }
 
 CAmount CWallet::GetAnonymizableBalance(bool fSkipDenominated, bool fSkipUnconfirmed) const
@@ -2171,23 +2620,7 @@ CAmount CWallet::GetAnonymizedBalance() const
 {
     if(fLiteMode) return 0;
 
-    CAmount nTotal = 0;
-
-    LOCK2(cs_main, cs_wallet);
-
-    std::set<uint256> setWalletTxesCounted;
-    for (auto& outpoint : setWalletUTXO) {
-
-        if (setWalletTxesCounted.find(outpoint.hash) != setWalletTxesCounted.end()) continue;
-        setWalletTxesCounted.insert(outpoint.hash);
-
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash); it != mapWallet.end() && it->first == outpoint.hash; ++it) {
-            if (it->second.IsTrusted())
-                nTotal += it->second.GetAnonymizedCredit();
-        }
-    }
-
-    return nTotal;
+    return GetBalances().nAnonymizedBalance;
 }
 
 // Note: calculated including unconfirmed,
@@ -2200,11 +2633,11 @@ float CWallet::GetAverageAnonymizedRounds() const
     int nCount = 0;
 
     LOCK2(cs_main, cs_wallet);
-    for (auto& outpoint : setWalletUTXO) {
-        if(!IsDenominated(outpoint)) continue;
-
-        nTotal += GetOutpointPrivateSendRounds(outpoint);
-        nCount++;
+    BOOST_FOREACH(const PAIRTYPE(CAmount, denom_rounds_m_t)& pairDenom, mapDenominatedUTXO) {
+        BOOST_FOREACH(const PAIRTYPE(int, std::set<COutPoint>)& pair, pairDenom.second) {
+            nTotal += std::min(pair.first, privateSendClient.nPrivateSendRounds) * (int)pair.second.size();
+            nCount += pair.second.size();
+        }
     }
 
     if(nCount == 0) return 0;
@@ -2221,14 +2654,17 @@ CAmount CWallet::GetNormalizedAnonymizedBalance() const
     CAmount nTotal = 0;
 
     LOCK2(cs_main, cs_wallet);
-    for (auto& outpoint : setWalletUTXO) {
-        map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
-        if (it == mapWallet.end()) continue;
-        if (!IsDenominated(outpoint)) continue;
-        if (it->second.GetDepthInMainChain() < 0) continue;
-
-        int nRounds = GetOutpointPrivateSendRounds(outpoint);
-        nTotal += it->second.vout[outpoint.n].nValue * nRounds / privateSendClient.nPrivateSendRounds;
+    BOOST_FOREACH(const PAIRTYPE(CAmount, denom_rounds_m_t)& pairDenom, mapDenominatedUTXO) {
+        BOOST_FOREACH(const PAIRTYPE(int, std::set<COutPoint>)& pair, pairDenom.second) {
+            int nRounds = std::min(pair.first, privateSendClient.nPrivateSendRounds);
+            BOOST_FOREACH(const COutPoint& outpoint, pair.second) {
+                map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
+                if (it == mapWallet.end()) continue;
+                if (it->second.GetDepthInMainChain() < 0) continue;
+
+                nTotal += pairDenom.first * nRounds / privateSendClient.nPrivateSendRounds;
+            }
+        }
     }
 
     return nTotal;
@@ -2262,92 +2698,33 @@ CAmount CWallet::GetDenominatedBalance(bool unconfirmed) const
 {
     if(fLiteMode) return 0;
 
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-
-            nTotal += pcoin->GetDenominatedCredit(unconfirmed);
-        }
-    }
-
-    return nTotal;
+    CWalletBalances balances = GetBalances();
+    return unconfirmed ? balances.nDenominatedUnconfirmedBalance : balances.nDenominatedConfirmedBalance;
 }
 
 CAmount CWallet::GetUnconfirmedBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nUnconfirmedBalance;
 }
 
 CAmount CWallet::GetImmatureBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nImmatureBalance;
 }
 
 CAmount CWallet::GetWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-
-    return nTotal;
+    return GetBalances().nWatchOnlyBalance;
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nUnconfirmedWatchOnlyBalance;
 }
 
 CAmount CWallet::GetImmatureWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nImmatureWatchOnlyBalance;
 }
 
 void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const CCoinControl *coinControl, bool fIncludeZeroValue, AvailableCoinsType nCoinType, bool fUseInstantSend) const
@@ -2356,9 +2733,18 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+        // only look at transactions with unspent outputs, one transaction at a time
+        std::set<COutPoint>::const_iterator itUTXO = setWalletUTXO.begin();
+        while (itUTXO != setWalletUTXO.end())
         {
-            const uint256& wtxid = it->first;
+            const uint256 wtxid = itUTXO->hash;
+            std::set<COutPoint>::const_iterator itTxBegin = itUTXO;
+            std::set<COutPoint>::const_iterator itTxEnd = setWalletUTXO.upper_bound(COutPoint(wtxid, std::numeric_limits<uint32_t>::max()));
+            itUTXO = itTxEnd;
+
+            map<uint256, CWalletTx>::const_iterator it = mapWallet.find(wtxid);
+            if (it == mapWallet.end())
+                continue;
             const CWalletTx* pcoin = &(*it).second;
 
             if (!CheckFinalTx(*pcoin))
@@ -2380,7 +2766,8 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const
             if (nDepth == 0 && !pcoin->InMempool())
                 continue;
 
-            for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
+            for (std::set<COutPoint>::const_iterator itOut = itTxBegin; itOut != itTxEnd; ++itOut) {
+                unsigned int i = itOut->n;
                 bool found = false;
                 if(nCoinType == ONLY_DENOMINATED) {
                     found = CPrivateSend::IsDenominatedAmount(pcoin->vout[i].nValue);
@@ -2410,6 +2797,56 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const
     }
 }
 
+void CWallet::AvailableDenominatedCoins(vector<COutput>& vCoins, const std::vector<CAmount>& vecAmounts, int nPrivateSendRoundsMin, int nPrivateSendRoundsMax) const
+{
+    vCoins.clear();
+
+    LOCK2(cs_main, cs_wallet);
+
+    // depth of the transactions checked so far, -1 if its outputs can't be used
+    std::map<uint256, int> mapTxDepth;
+
+    BOOST_FOREACH(CAmount nAmount, vecAmounts) {
+        std::map<CAmount, denom_rounds_m_t>::const_iterator itDenom = mapDenominatedUTXO.find(nAmount);
+        if (itDenom == mapDenominatedUTXO.end())
+            continue;
+
+        BOOST_FOREACH(const PAIRTYPE(int, std::set<COutPoint>)& pair, itDenom->second) {
+            // respect current settings, same as GetOutpointPrivateSendRounds()
+            int nRounds = std::min(pair.first, privateSendClient.nPrivateSendRounds);
+            if (nRounds < nPrivateSendRoundsMin || nRounds >= nPrivateSendRoundsMax)
+                continue;
+
+            BOOST_FOREACH(const COutPoint& outpoint, pair.second) {
+                map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
+                if (it == mapWallet.end())
+                    continue;
+                const CWalletTx* pcoin = &(*it).second;
+
+                std::map<uint256, int>::iterator itDepth = mapTxDepth.find(outpoint.hash);
+                if (itDepth == mapTxDepth.end()) {
+                    int nDepth = pcoin->GetDepthInMainChain(false);
+                    if (!CheckFinalTx(*pcoin) || !pcoin->IsTrusted() ||
+                        (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0) ||
+                        (nDepth == 0 && !pcoin->InMempool()))
+                        nDepth = -1;
+                    itDepth = mapTxDepth.insert(std::make_pair(outpoint.hash, nDepth)).first;
+                }
+                if (itDepth->second < 0)
+                    continue;
+
+                isminetype mine = IsMine(pcoin->vout[outpoint.n]);
+                if (mine == ISMINE_NO || IsSpent(outpoint.hash, outpoint.n) || IsLockedCoin(outpoint.hash, outpoint.n))
+                    continue;
+
+                vCoins.push_back(COutput(pcoin, outpoint.n, itDepth->second,
+                                         (mine & ISMINE_SPENDABLE) != ISMINE_NO,
+                                         (mine & (ISMINE_SPENDABLE | ISMINE_WATCH_SOLVABLE)) != ISMINE_NO));
+            }
+        }
+    }
+}
+
 static void ApproximateBestSubset(vector<pair<CAmount, pair<const CWalletTx*,unsigned int> > >vValue, const CAmount& nTotalLower, const CAmount& nTargetValue,
                                   vector<char>& vfBest, CAmount& nBest, bool fUseInstantSend = false, int iterations = 1000)
 {
@@ -2755,11 +3192,6 @@ bool CWallet::SelectCoinsByDenominations(int nDenom, CAmount nValueMin, CAmount
     vCoinsRet.clear();
     nValueRet = 0;
 
-    vector<COutput> vCoins;
-    AvailableCoins(vCoins, true, NULL, false, ONLY_DENOMINATED);
-
-    std::random_shuffle(vCoins.rbegin(), vCoins.rend(), GetRandInt);
-
     // ( bit on if present )
     // bit 0 - 100ZIXX+1
     // bit 1 - 10ZIXX+1
@@ -2774,6 +3206,16 @@ bool CWallet::SelectCoinsByDenominations(int nDenom, CAmount nValueMin, CAmount
     int nDenomResult = 0;
 
     std::vector<CAmount> vecPrivateSendDenominations = CPrivateSend::GetStandardDenominations();
+    std::vector<CAmount> vecAmounts;
+    BOOST_FOREACH(int nBit, vecBits)
+        vecAmounts.push_back(vecPrivateSendDenominations[nBit]);
+
+    // only coins of the requested denominations with the right amount of rounds
+    vector<COutput> vCoins;
+    AvailableDenominatedCoins(vCoins, vecAmounts, nPrivateSendRoundsMin, nPrivateSendRoundsMax);
+
+    std::random_shuffle(vCoins.rbegin(), vCoins.rend(), GetRandInt);
+
     InsecureRand insecureRand;
     BOOST_FOREACH(const COutput& out, vCoins)
     {
@@ -2783,10 +3225,6 @@ bool CWallet::SelectCoinsByDenominations(int nDenom, CAmount nValueMin, CAmount
 
             CTxIn txin = CTxIn(out.tx->GetHash(), out.i);
 
-            int nRounds = GetOutpointPrivateSendRounds(txin.prevout);
-            if(nRounds >= nPrivateSendRoundsMax) continue;
-            if(nRounds < nPrivateSendRoundsMin) continue;
-
             BOOST_FOREACH(int nBit, vecBits) {
                 if(out.tx->vout[out.i].nValue == vecPrivateSendDenominations[nBit]) {
                     if(nValueRet >= nValueMin) {
@@ -2924,7 +3362,11 @@ bool CWallet::SelectCoinsDark(CAmount nValueMin, CAmount nValueMax, std::vector<
     nValueRet = 0;
 
     vector<COutput> vCoins;
-    AvailableCoins(vCoins, true, coinControl, false, nPrivateSendRoundsMin < 0 ? ONLY_NONDENOMINATED : ONLY_DENOMINATED);
+    if(nPrivateSendRoundsMin < 0) {
+        AvailableCoins(vCoins, true, coinControl, false, ONLY_NONDENOMINATED);
+    } else {
+        AvailableDenominatedCoins(vCoins, CPrivateSend::GetStandardDenominations(), nPrivateSendRoundsMin, nPrivateSendRoundsMax);
+    }
 
     //order the array so largest nondenom are first, then denominations, then very small inputs.
     sort(vCoins.rbegin(), vCoins.rend(), CompareByPriority());
@@ -3030,25 +3472,20 @@ bool CWallet::GetOutpointAndKeysFromOutput(const COutput& out, COutPoint& outpoi
 
 int CWallet::CountInputsWithAmount(CAmount nInputAmount)
 {
-    CAmount nTotal = 0;
+    int nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted()){
-                int nDepth = pcoin->GetDepthInMainChain(false);
-
-                for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
-                    COutput out = COutput(pcoin, i, nDepth, true, true);
-                    COutPoint outpoint = COutPoint(out.tx->GetHash(), out.i);
+        std::map<CAmount, denom_rounds_m_t>::const_iterator itDenom = mapDenominatedUTXO.find(nInputAmount);
+        if (itDenom == mapDenominatedUTXO.end())
+            return 0;
 
-                    if(out.tx->vout[out.i].nValue != nInputAmount) continue;
-                    if(!CPrivateSend::IsDenominatedAmount(pcoin->vout[i].nValue)) continue;
-                    if(IsSpent(out.tx->GetHash(), i) || IsMine(pcoin->vout[i]) != ISMINE_SPENDABLE || !IsDenominated(outpoint)) continue;
+        BOOST_FOREACH(const PAIRTYPE(int, std::set<COutPoint>)& pair, itDenom->second) {
+            BOOST_FOREACH(const COutPoint& outpoint, pair.second) {
+                map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
+                if (it == mapWallet.end() || !it->second.IsTrusted()) continue;
+                if (IsSpent(outpoint.hash, outpoint.n) || IsMine(it->second.vout[outpoint.n]) != ISMINE_SPENDABLE) continue;
 
-                    nTotal++;
-                }
+                nTotal++;
             }
         }
     }
@@ -3618,7 +4055,7 @@ DBErrors CWallet::LoadWallet(bool& fFirstRunRet)
         for (auto& pair : mapWallet) {
             for(size_t i = 0; i < pair.second.vout.size(); ++i) {
                 if (IsMine(pair.second.vout[i]) && !IsSpent(pair.first, i)) {
-                    setWalletUTXO.insert(COutPoint(pair.first, i));
+                    AddToWalletUTXO(COutPoint(pair.first, i));
                 }
             }
         }
@@ -3785,8 +4222,88 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
         } else {
             nTargetSize *= 2;
         }
-        bool fInternal = false;
+        if (missingInternal + missingExternal == 0)
+            return true;
+
         CWalletDB walletdb(strWalletFile);
+        if (IsHDEnabled()) {
+            // derive the missing keys of each chain in one go and write them in one database transaction,
+            // the key pools and the in-memory HD state only change once it is committed
+            CHDChain hdChainPrev;
+            GetHDChain(hdChainPrev);
+            int64_t nTimeFirstKeyPrev = nTimeFirstKey;
+            std::set<CScript> setWatchOnlyPrev;
+            {
+                LOCK(cs_KeyStore);
+                setWatchOnlyPrev = setWatchOnly;
+            }
+
+            std::vector<CPubKey> vExternalKeys, vInternalKeys;
+            std::vector<int64_t> vExternalIndexes, vInternalIndexes;
+            if (!walletdb.TxnBegin())
+                throw runtime_error("TopUpKeyPool(): TxnBegin failed");
+            try {
+                CKeyMetadata metadata(GetTime());
+                // TODO: implement keypools for all accounts?
+                DeriveNewChildKeys(metadata, 0, false, missingExternal, vExternalKeys, &walletdb);
+                DeriveNewChildKeys(metadata, 0, true, missingInternal, vInternalKeys, &walletdb);
+
+                int64_t nEnd = 1;
+                if (!setInternalKeyPool.empty()) {
+                    nEnd = *(--setInternalKeyPool.end()) + 1;
+                }
+                if (!setExternalKeyPool.empty()) {
+                    nEnd = std::max(nEnd, *(--setExternalKeyPool.end()) + 1);
+                }
+                for (int i = 0; i < 2; i++) {
+                    bool fInternal = i == 1;
+                    std::vector<int64_t>& vIndexes = fInternal ? vInternalIndexes : vExternalIndexes;
+                    BOOST_FOREACH(const CPubKey& pubkey, fInternal ? vInternalKeys : vExternalKeys) {
+                        if (!walletdb.WritePool(nEnd, CKeyPool(pubkey, fInternal)))
+                            throw runtime_error("TopUpKeyPool(): writing generated key failed");
+                        vIndexes.push_back(nEnd);
+
+                        double dProgress = 100.f * nEnd / (nTargetSize + 1);
+                        std::string strMsg = strprintf(_("Loading wallet... (%3.2f %%)"), dProgress);
+                        uiInterface.InitMessage(strMsg);
+                        nEnd++;
+                    }
+                }
+                if (!walletdb.TxnCommit())
+                    throw runtime_error("TopUpKeyPool(): TxnCommit failed");
+            } catch (...) {
+                walletdb.TxnAbort();
+
+                // nothing was written, forget the keys derived for this batch
+                for (int i = 0; i < 2; i++) {
+                    BOOST_FOREACH(const CPubKey& pubkey, i == 1 ? vInternalKeys : vExternalKeys) {
+                        mapHdPubKeys.erase(pubkey.GetID());
+                        mapKeyMetadata.erase(pubkey.GetID());
+                    }
+                }
+                if (IsCrypted())
+                    SetCryptedHDChain(hdChainPrev, true);
+                else
+                    SetHDChain(hdChainPrev, true);
+                nTimeFirstKey = nTimeFirstKeyPrev;
+                // AddHDPubKey drops watch-only scripts of the new keys
+                bool fWatchOnlyRestored = false;
+                BOOST_FOREACH(const CScript& script, setWatchOnlyPrev) {
+                    if (!HaveWatchOnly(script))
+                        fWatchOnlyRestored |= LoadWatchOnly(script);
+                }
+                if (fWatchOnlyRestored)
+                    NotifyWatchonlyChanged(true);
+                throw;
+            }
+
+            setExternalKeyPool.insert(vExternalIndexes.begin(), vExternalIndexes.end());
+            setInternalKeyPool.insert(vInternalIndexes.begin(), vInternalIndexes.end());
+            LogPrintf("keypool added %d keys (%d internal), size=%u\n", missingInternal + missingExternal, missingInternal, setInternalKeyPool.size() + setExternalKeyPool.size());
+            return true;
+        }
+
+        bool fInternal = false;
         for (int64_t i = missingInternal + missingExternal; i--;)
         {
             int64_t nEnd = 1;
@@ -4179,6 +4696,7 @@ void CWallet::LockCoin(COutPoint& output)
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    fBalancesCached = false;
 }
 
 void CWallet::UnlockCoin(COutPoint& output)
@@ -4190,6 +4708,7 @@ void CWallet::UnlockCoin(COutPoint& output)
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
+    fBalancesCached = false;
 }
 
 void CWallet::UnlockAllCoins()
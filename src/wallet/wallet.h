@@ -23,6 +23,7 @@
 #include "privatesend.h"
 
 #include <algorithm>
+#include <atomic>
 #include <map>
 #include <set>
 #include <stdexcept>
@@ -77,6 +78,7 @@ class CReserveKey;
 class CScript;
 class CTxMemPool;
 class CWalletTx;
+class CWalletRescanReserver;
 
 /** (client) version numbers for particular wallet features */
 enum WalletFeature
@@ -111,6 +113,37 @@ struct CompactTallyItem
     }
 };
 
+/** All wallet balances, computed in one pass and cached until the wallet, chain or mempool changes */
+struct CWalletBalances
+{
+    CAmount nBalance;
+    CAmount nUnconfirmedBalance;
+    CAmount nImmatureBalance;
+    CAmount nWatchOnlyBalance;
+    CAmount nUnconfirmedWatchOnlyBalance;
+    CAmount nImmatureWatchOnlyBalance;
+    CAmount nAnonymizedBalance;
+    CAmount nDenominatedConfirmedBalance;
+    CAmount nDenominatedUnconfirmedBalance;
+
+    // state the balances were computed for
+    const CBlockIndex* pindexTip;
+    unsigned int nMempoolUpdated;
+    int nCompleteTXLocks;
+    int nPrivateSendRounds;
+
+    CWalletBalances()
+    {
+        nBalance = nUnconfirmedBalance = nImmatureBalance = 0;
+        nWatchOnlyBalance = nUnconfirmedWatchOnlyBalance = nImmatureWatchOnlyBalance = 0;
+        nAnonymizedBalance = nDenominatedConfirmedBalance = nDenominatedUnconfirmedBalance = 0;
+        pindexTip = NULL;
+        nMempoolUpdated = 0;
+        nCompleteTXLocks = 0;
+        nPrivateSendRounds = 0;
+    }
+};
+
 /** A key pool entry */
 class CKeyPool
 {
@@ -633,6 +666,18 @@ private:
     mutable bool fAnonymizableTallyCachedNonDenom;
     mutable std::vector<CompactTallyItem> vecAnonymizableTallyCachedNonDenom;
 
+    mutable bool fBalancesCached;
+    mutable CWalletBalances balancesCached;
+
+    std::atomic<bool> fAbortRescan;
+    std::atomic<bool> fScanningWallet;
+    friend class CWalletRescanReserver;
+
+    //! Extended public keys of the HD chain's (account, internal) chains, their children need no seed
+    std::map<std::pair<uint32_t, bool>, CExtPubKey> mapHdChainExtPubKeys;
+    //! ID of the HD chain mapHdChainExtPubKeys was derived from
+    uint256 hdChainExtPubKeysID;
+
     /**
      * Used to keep track of spent outpoints, and
      * detect and report conflicts (double-spends or
@@ -643,15 +688,38 @@ private:
     void AddToSpends(const COutPoint& outpoint, const uint256& wtxid);
     void AddToSpends(const uint256& wtxid);
 
+    /**
+     * Outputs we own which are not spent. Outputs are removed once spent and put back
+     * when the spending transaction gets abandoned or conflicted, but a conflicted spend
+     * can get confirmed again on reorg, so users still have to check IsSpent().
+     */
     std::set<COutPoint> setWalletUTXO;
 
+    /** Denominated outputs of setWalletUTXO by denomination and real PrivateSend rounds */
+    typedef std::map<int, std::set<COutPoint> > denom_rounds_m_t;
+    std::map<CAmount, denom_rounds_m_t> mapDenominatedUTXO;
+    /** Memoized GetRealOutpointPrivateSendRounds() results */
+    mutable std::map<COutPoint, int> mapOutpointRoundsCache;
+
+    void AddToWalletUTXO(const COutPoint& outpoint);
+    void RemoveFromWalletUTXO(const COutPoint& outpoint);
+    /** Put an outpoint back into setWalletUTXO if it is ours and not spent anymore */
+    void UpdateWalletUTXO(const COutPoint& outpoint);
+    /** Wallet transactions which have outputs in setWalletUTXO */
+    void GetWalletUTXOTxes(std::vector<const CWalletTx*>& vecTxesRet) const;
+
     /* Mark a transaction (and its in-wallet descendants) as conflicting with a particular block. */
     void MarkConflicted(const uint256& hashBlock, const uint256& hashTx);
 
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>);
 
-    /* HD derive new child key (on internal or external chain) */
-    void DeriveNewChildKey(const CKeyMetadata& metadata, CKey& secretRet, uint32_t nAccountIndex, bool fInternal /*= false*/);
+    /* HD derive nCount new child keys (on internal or external chain), writing them through pwalletdb if given.
+     * The new keys are appended to vPubKeysRet before the wallet is changed, so a caller can undo a failed batch. */
+    void DeriveNewChildKeys(const CKeyMetadata& metadata, uint32_t nAccountIndex, bool fInternal, unsigned int nCount, std::vector<CPubKey>& vPubKeysRet, CWalletDB* pwalletdb);
+    /* Extended public key of an account's internal or external chain, derived from the seed on first use */
+    CExtPubKey GetHDChainExtPubKey(const CHDChain& hdChain, uint32_t nAccountIndex, bool fInternal);
+
+    bool RemoveWatchOnly(const CScript &dest, CWalletDB* pwalletdb);
 
 public:
     /*
@@ -723,6 +791,9 @@ public:
         fBroadcastTransactions = false;
         fAnonymizableTallyCached = false;
         fAnonymizableTallyCachedNonDenom = false;
+        fBalancesCached = false;
+        fAbortRescan = false;
+        fScanningWallet = false;
         vecAnonymizableTallyCached.clear();
         vecAnonymizableTallyCachedNonDenom.clear();
     }
@@ -758,6 +829,13 @@ public:
      */
     void AvailableCoins(std::vector<COutput>& vCoins, bool fOnlyConfirmed=true, const CCoinControl *coinControl = NULL, bool fIncludeZeroValue=false, AvailableCoinsType nCoinType=ALL_COINS, bool fUseInstantSend = false) const;
 
+    /**
+     * populate vCoins with confirmed denominated COutputs of the given amounts
+     * which have PrivateSend rounds in [nPrivateSendRoundsMin, nPrivateSendRoundsMax).
+     * Same as AvailableCoins(ONLY_DENOMINATED) but only looks at the denominated outputs index.
+     */
+    void AvailableDenominatedCoins(std::vector<COutput>& vCoins, const std::vector<CAmount>& vecAmounts, int nPrivateSendRoundsMin, int nPrivateSendRoundsMax) const;
+
     /**
      * Shuffle and select coins until nTargetValue is reached while avoiding
      * small change; This method is stochastic for some inputs and upon
@@ -808,7 +886,7 @@ public:
     //! GetKey implementation that can derive a HD private key on the fly
     bool GetKey(const CKeyID &address, CKey& keyOut) const;
     //! Adds a HDPubKey into the wallet(database)
-    bool AddHDPubKey(const CExtPubKey &extPubKey, bool fInternal);
+    bool AddHDPubKey(const CExtPubKey &extPubKey, bool fInternal, CWalletDB* pwalletdb = NULL);
     //! loads a HDPubKey into the wallets memory
     bool LoadHDPubKey(const CHDPubKey &hdPubKey);
     //! Adds a key to the store, and saves it to disk.
@@ -855,13 +933,24 @@ public:
     int64_t IncOrderPosNext(CWalletDB *pwalletdb = NULL);
 
     void MarkDirty();
+    /**
+     * Add outputs of wallet transactions that became ours after they were added to the
+     * wallet, e.g. by importing a key or script, to setWalletUTXO.
+     */
+    void AddMissingWalletUTXOs();
     bool AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletDB* pwalletdb);
     void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
     bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate);
-    int ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
+    int ScanForWalletTransactions(CBlockIndex* pindexStart, const CWalletRescanReserver& reserver, bool fUpdate = false);
+    //! Ask a running ScanForWalletTransactions to stop at the next block
+    void AbortRescan() { fAbortRescan = true; }
+    bool IsAbortingRescan() const { return fAbortRescan; }
+    bool IsScanning() const { return fScanningWallet; }
     void ReacceptWalletTransactions();
     void ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman);
     std::vector<uint256> ResendWalletTransactionsBefore(int64_t nTime, CConnman* connman);
+    /** All balances at once, recomputed only after the wallet, the chain tip, the mempool or InstantSend locks changed */
+    CWalletBalances GetBalances() const;
     CAmount GetBalance() const;
     CAmount GetUnconfirmedBalance() const;
     CAmount GetImmatureBalance() const;
@@ -1037,6 +1126,39 @@ public:
     bool GetDecryptedHDChain(CHDChain& hdChainRet);
 };
 
+/** Reserves the wallet for a rescan, only one ScanForWalletTransactions may run at a time. */
+class CWalletRescanReserver
+{
+private:
+    CWallet* pwallet;
+    bool fReserved;
+
+public:
+    explicit CWalletRescanReserver(CWallet* pwalletIn) : pwallet(pwalletIn), fReserved(false) {}
+
+    //! Returns false if another rescan is already running
+    bool Reserve()
+    {
+        assert(!fReserved);
+        bool fExpected = false;
+        if (!pwallet->fScanningWallet.compare_exchange_strong(fExpected, true))
+            return false;
+        fReserved = true;
+        return true;
+    }
+
+    bool IsReserved() const { return fReserved; }
+
+    ~CWalletRescanReserver()
+    {
+        if (fReserved) {
+            // an abort requested for this scan must not stop the next one
+            pwallet->fAbortRescan = false;
+            pwallet->fScanningWallet = false;
+        }
+    }
+};
+
 /** A key allocated from the key pool. */
 class CReserveKey : public CReserveScript
 {
@@ -25,3 +25,8 @@ bool CZMQAbstractNotifier::NotifyTransactionLock(const CTransaction &/*transacti
 {
     return true;
 }
+
+bool CZMQAbstractNotifier::NotifyTransactionLockTrace(const CTxLockTrace &/*trace*/)
+{
+    return true;
+}
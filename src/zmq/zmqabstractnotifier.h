@@ -8,6 +8,7 @@
 #include "zmqconfig.h"
 
 class CBlockIndex;
+class CTxLockTrace;
 class CZMQAbstractNotifier;
 
 typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
@@ -35,6 +36,7 @@ public:
     virtual bool NotifyBlock(const CBlockIndex *pindex);
     virtual bool NotifyTransaction(const CTransaction &transaction);
     virtual bool NotifyTransactionLock(const CTransaction &transaction);
+    virtual bool NotifyTransactionLockTrace(const CTxLockTrace &trace);
 
 protected:
     void *psocket;
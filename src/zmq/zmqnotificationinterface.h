@@ -10,6 +10,7 @@
 #include <map>
 
 class CBlockIndex;
+class CTxLockTrace;
 class CZMQAbstractNotifier;
 
 class CZMQNotificationInterface : public CValidationInterface
@@ -27,6 +28,7 @@ protected:
     void SyncTransaction(const CTransaction &tx, const CBlock *pblock);
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload);
     void NotifyTransactionLock(const CTransaction &tx);
+    void NotifyTransactionLockTrace(const CTxLockTrace &trace);
 
 private:
     CZMQNotificationInterface();
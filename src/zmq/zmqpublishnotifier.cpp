@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "chainparams.h"
+#include "instantx.h"
 #include "streams.h"
 #include "zmqpublishnotifier.h"
 #include "validation.h"
@@ -16,6 +17,7 @@ static const char *MSG_HASHTXLOCK = "hashtxlock";
 static const char *MSG_RAWBLOCK   = "rawblock";
 static const char *MSG_RAWTX      = "rawtx";
 static const char *MSG_RAWTXLOCK = "rawtxlock";
+static const char *MSG_TXLOCKTRACE = "txlocktrace";
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -211,3 +213,11 @@ bool CZMQPublishRawTransactionLockNotifier::NotifyTransactionLock(const CTransac
     ss << transaction;
     return SendMessage(MSG_RAWTXLOCK, &(*ss.begin()), ss.size());
 }
+
+bool CZMQPublishTransactionLockTraceNotifier::NotifyTransactionLockTrace(const CTxLockTrace &trace)
+{
+    LogPrint("zmq", "zmq: Publish txlocktrace %s\n", trace.txHash.GetHex());
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << trace;
+    return SendMessage(MSG_TXLOCKTRACE, &(*ss.begin()), ss.size());
+}
@@ -64,4 +64,10 @@ public:
     bool NotifyTransactionLock(const CTransaction &transaction);
 };
 
+class CZMQPublishTransactionLockTraceNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyTransactionLockTrace(const CTxLockTrace &trace);
+};
+
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H